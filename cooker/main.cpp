@@ -0,0 +1,68 @@
+/**********************************************************************************************
+*
+*   RayTileMap Cooker
+*
+*   LICENSE: MIT
+*
+*   Copyright (c) 2024 Jeffery Myers
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+#include "raylib.h"
+#include "ray_tilemap.h"
+
+#include <cstdio>
+
+using namespace RayTiled;
+
+// converts a Tiled map and its tilesets into a cooked map that loads without parsing
+// usage: cooker input.tmx output.rtm
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		printf("usage: cooker <input.tmx> <output>\n");
+		return 1;
+	}
+
+	SetTraceLogLevel(LOG_WARNING);
+
+	// the cooker has no window, so don't load textures, only their paths are stored
+	TileMapLoadContext context;
+	context.DeferTextures = true;
+
+	TileMap map;
+	if (!LoadTileMap(argv[1], map, context))
+	{
+		printf("unable to load %s\n", argv[1]);
+		return 1;
+	}
+
+	if (!SaveCookedTileMap(map, argv[2]))
+	{
+		printf("unable to write %s\n", argv[2]);
+		return 1;
+	}
+
+	printf("cooked %s to %s\n", argv[1], argv[2]);
+	UnloadTileMap(map, false);
+	return 0;
+}
@@ -0,0 +1,121 @@
+/**********************************************************************************************
+*
+*   RayTileMap Example Benchmarks
+*
+*   LICENSE: MIT
+*
+*   Copyright (c) 2024 Jeffery Myers
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+#include "raylib.h"
+
+#include "ray_tilemap.h"
+
+#include <string>
+#include <random>
+
+using namespace RayTiled;
+
+// compares the object layer grid against testing every object, on a large random layer
+std::string RunObjectQueryBenchmark()
+{
+	constexpr int ObjectCount = 5000;
+	constexpr int QueryCount = 2000;
+	constexpr float WorldSize = 8000;
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(0, WorldSize);
+	std::uniform_real_distribution<float> size(8, 96);
+
+	ObjectLayer layer;
+	for (int i = 0; i < ObjectCount; i++)
+	{
+		auto object = std::make_unique<ObjectLayer::Object>();
+		object->Id = i + 1;
+		object->Bounds = Rectangle{ position(random), position(random), size(random), size(random) };
+		layer.AddObject(std::move(object));
+	}
+
+	std::vector<Rectangle> queries;
+	for (int i = 0; i < QueryCount; i++)
+		queries.push_back(Rectangle{ position(random), position(random), 32, 32 });
+
+	size_t linearHits = 0;
+	double start = GetTime();
+	for (const auto& query : queries)
+	{
+		for (const auto& object : layer.Objets)
+		{
+			if (CheckCollisionRecs(query, object->Bounds))
+				linearHits++;
+		}
+	}
+	double linearTime = GetTime() - start;
+
+	size_t gridHits = 0;
+	start = GetTime();
+	for (const auto& query : queries)
+		layer.ForEachObjectInRect(query, [&gridHits](const ObjectLayer::Object&) { gridHits++; });
+	double gridTime = GetTime() - start;
+
+	return TextFormat("Object queries: linear %.2fms, grid %.2fms (%d/%d hits)", linearTime * 1000, gridTime * 1000, int(linearHits), int(gridHits));
+}
+
+// loads a large generated CSV map from memory, to time the layer decoder
+std::string RunMapLoadBenchmark()
+{
+	constexpr int MapSize = 1024;
+	constexpr int TileCount = 1767;
+
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<int> tile(0, TileCount);
+
+	std::string mapText = TextFormat("<map version=\"1.10\" orientation=\"orthogonal\" renderorder=\"right-down\" width=\"%d\" height=\"%d\" tilewidth=\"16\" tileheight=\"16\">", MapSize, MapSize);
+	mapText += "<tileset firstgid=\"1\" name=\"Roguelike\" tilewidth=\"16\" tileheight=\"16\" spacing=\"1\" tilecount=\"1767\" columns=\"57\">";
+	mapText += "<image source=\"resources/Spritesheet/roguelikeSheet_transparent.png\" width=\"968\" height=\"526\"/></tileset>";
+	mapText += TextFormat("<layer id=\"1\" name=\"Ground\" width=\"%d\" height=\"%d\"><data encoding=\"csv\">\n", MapSize, MapSize);
+
+	mapText.reserve(mapText.size() + MapSize * MapSize * 6);
+	for (int y = 0; y < MapSize; y++)
+	{
+		for (int x = 0; x < MapSize; x++)
+		{
+			mapText += std::to_string(tile(random));
+			if (x < MapSize - 1 || y < MapSize - 1)
+				mapText += ',';
+		}
+		mapText += '\n';
+	}
+	mapText += "</data></layer></map>";
+
+	TileMap map;
+	double start = GetTime();
+	bool loaded = LoadTileMapFromMemory(mapText.c_str(), map);
+	double loadTime = GetTime() - start;
+
+	UnloadTileMap(map);
+
+	if (!loaded)
+		return "Map load: failed";
+
+	return TextFormat("Map load: %dx%d CSV (%.1fMB) in %.2fms", MapSize, MapSize, mapText.size() / (1024.0 * 1024.0), loadTime * 1000);
+}
@@ -31,9 +31,19 @@
 
 #include "ray_tilemap.h"
 
+#include <algorithm>
+
 using namespace RayTiled;
 
+std::string RunObjectQueryBenchmark();
+std::string RunMapLoadBenchmark();
+
+std::string BenchmarkResult;
+
+bool ShowFlipCheck = false;
+
 TileMap Map;
+TileDrawContext MapDrawContext;
 
 Camera2D ViewCamera = { 0 };
 
@@ -86,12 +96,86 @@ void DrawCollisionLayer(ObjectLayer& layer, Camera2D* camera, Vector2 bounds)
 	}
 }
 
+// Draws one tile with every flip combination, the top row through the tile quad path used by the map
+// and the bottom row with DrawTexturePro, so the two can be compared by eye.
+// Plain horizontal and vertical flips use the same negative source size call that tiles were drawn with before quads.
+// Tiled applies the diagonal flip as an x/y swap, which is a 90 degree turn around the tile center with the source flipped,
+// the old call turned the tile around its corner instead, which moved it out of its cell.
+void DrawFlipCheck()
+{
+	if (Map.TileSheets.empty())
+		return;
+
+	const TileSheet& sheet = Map.TileSheets.begin()->second;
+	if (sheet.Tiles.empty())
+		return;
+
+	// pick a tile that is not symmetric, so every flip looks different
+	uint16_t tileId = uint16_t(sheet.StartingTileId + std::min<size_t>(sheet.Tiles.size() - 1, 57 * 7 + 10));
+
+	constexpr float TileDrawSize = 64;
+	constexpr float Spacing = 80;
+	Vector2 origin = { 20, 100 };
+
+	DrawRectangle(int(origin.x - 10), int(origin.y - 30), int(Spacing * 8 + 10), int(Spacing * 2 + 40), ColorAlpha(BLACK, 0.75f));
+	DrawText("Flip check: quads (top), DrawTexturePro (bottom)", int(origin.x), int(origin.y - 25), 20, WHITE);
+
+	for (uint8_t flipIndex = 0; flipIndex < 8; flipIndex++)
+	{
+		uint8_t flags = 0;
+		if (flipIndex & 1)
+			flags |= TileFlagsFlipHorizontal;
+		if (flipIndex & 2)
+			flags |= TileFlagsFlipVertical;
+		if (flipIndex & 4)
+			flags |= TileFlagsFlipDiagonal;
+
+		Rectangle quadRect = { origin.x + flipIndex * Spacing, origin.y, TileDrawSize, TileDrawSize };
+		sheet.DrawTile(tileId, quadRect, flags);
+
+		Rectangle source = sheet.Tiles[tileId - sheet.StartingTileId];
+		Rectangle referenceRect = { quadRect.x, quadRect.y + Spacing, TileDrawSize, TileDrawSize };
+		float rotation = 0;
+
+		if (flags & TileFlagsFlipDiagonal)
+		{
+			// swap x and y: turn a quarter around the center, the vertical flip becomes horizontal and the horizontal flip is undone
+			rotation = 90;
+			if (flags & TileFlagsFlipVertical)
+				source.width *= -1;
+			if (!(flags & TileFlagsFlipHorizontal))
+				source.height *= -1;
+
+			referenceRect.x += TileDrawSize * 0.5f;
+			referenceRect.y += TileDrawSize * 0.5f;
+			DrawTexturePro(sheet.Texture, source, referenceRect, Vector2{ TileDrawSize * 0.5f, TileDrawSize * 0.5f }, rotation, WHITE);
+		}
+		else
+		{
+			if (flags & TileFlagsFlipHorizontal)
+				source.width *= -1;
+			if (flags & TileFlagsFlipVertical)
+				source.height *= -1;
+
+			DrawTexturePro(sheet.Texture, source, referenceRect, Vector2Zero(), rotation, WHITE);
+		}
+
+		DrawText(TextFormat("%s%s%s", (flags & TileFlagsFlipHorizontal) ? "H" : "-", (flags & TileFlagsFlipVertical) ? "V" : "-", (flags & TileFlagsFlipDiagonal) ? "D" : "-"),
+			int(quadRect.x), int(origin.y + Spacing * 2 - 10), 10, WHITE);
+	}
+}
+
 void GameInit()
 {
 	ViewCamera.zoom = 1;
 
 	LoadTileMap("resources/sample_map.tmx", Map);
 
+	// the ground never changes, so draw it from pre-rendered chunks
+	auto groundLayer = FindLayer(Map, "Ground/terrain");
+	if (groundLayer && groundLayer->Type == TileLayerType::Tile)
+		EnableTileLayerCache(*static_cast<TileLayer*>(groundLayer));
+
 	TestUserLayer = InsertTileMapLayer<UserLayer>(Map, Map.Layers.back()->LayerId);
 	TestUserLayer->DrawFunction = DrawUserLayer;
 
@@ -114,6 +198,15 @@ void GameInit()
 
 bool GameUpdate()
 {
+	if (IsKeyPressed(KEY_F1))
+		BenchmarkResult = RunObjectQueryBenchmark();
+
+	if (IsKeyPressed(KEY_F2))
+		BenchmarkResult = RunMapLoadBenchmark();
+
+	if (IsKeyPressed(KEY_F3))
+		ShowFlipCheck = !ShowFlipCheck;
+
 	if (IsMouseButtonDown(MOUSE_BUTTON_RIGHT))
 	{
 		ViewCamera.target = Vector2Subtract(ViewCamera.target, GetMouseDelta());
@@ -137,8 +230,7 @@ bool GameUpdate()
 
 	Rectangle newRect = { newPos.x - Player.Radius, newPos.y - Player.Radius, Player.Radius * 2, Player.Radius * 2 };
 
-	std::vector<CollisionRecord> collisions;
-	if (GetCollisions(Map, newRect, collisions) == 0)
+	if (!HasCollision(Map, newRect))
 	{
 		Player.Position = newPos;
 	}
@@ -148,11 +240,14 @@ bool GameUpdate()
 
 void GameDraw()
 {
+	UpdateTileAnimations(Map, GetTime());
+	UpdateTileMapCaches(Map, &ViewCamera);
+
 	BeginDrawing();
 	ClearBackground(DARKGRAY);
 
 	BeginMode2D(ViewCamera);
-	DrawTileMap(Map, &ViewCamera);
+	DrawTileMap(Map, MapDrawContext, &ViewCamera);
 
 	DrawLine(0, 0, 100, 0, RED);
     DrawLine(0, 0, 0, 100, BLUE);
@@ -160,7 +255,15 @@ void GameDraw()
 	EndMode2D();
 
 	DrawFPS(5, 5);
-	DrawText(TextFormat("Tiles Drawn: %d", (int)GetTileDrawStats()), 5, 25, 20, WHITE);
+	DrawText(TextFormat("Tiles Drawn: %d", (int)GetTileDrawStats(MapDrawContext)), 5, 25, 20, WHITE);
+
+	if (BenchmarkResult.empty())
+		DrawText("F1: object query benchmark, F2: map load benchmark, F3: flip check", 5, 45, 20, WHITE);
+	else
+		DrawText(BenchmarkResult.c_str(), 5, 45, 20, WHITE);
+
+	if (ShowFlipCheck)
+		DrawFlipCheck();
 
 	EndDrawing();
 }
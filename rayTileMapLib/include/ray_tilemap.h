@@ -36,6 +36,12 @@
 #include <map>
 #include <functional>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <shared_mutex>
+#include <cmath>
+#include <type_traits>
 
 namespace RayTiled
 {
@@ -48,12 +54,45 @@ namespace RayTiled
         Oblique,
     };
 
+    // one frame of an animated tile
+    struct TileAnimationFrame
+    {
+        uint16_t TileIndex = 0;     // the index of the tile to show in the sheet
+        float Duration = 0;         // how long the frame is shown, in seconds
+    };
+
+    // the frames of an animated tile, played in a loop
+    struct TileAnimation
+    {
+        std::vector<TileAnimationFrame> Frames;
+        float Length = 0;           // the total of the frame durations, in seconds
+    };
+
+    // the kinds of collision shape a tile can have
+    enum class TileShapeType : uint8_t
+    {
+        Rectangle,
+        Ellipse,
+        Polygon,
+    };
+
+    // a collision shape drawn on a tileset tile in Tiled, relative to the top left of the tile
+    struct TileCollisionShape
+    {
+        TileShapeType Type = TileShapeType::Rectangle;
+        Rectangle Bounds = { 0 };       // the shape bounds, ellipses fill their bounds
+        std::vector<Vector2> Points;    // polygon points, relative to the top left of the bounds
+    };
+
     // defines a texture and it's associated tile rects that are used by a tilemap
     struct TileSheet
     {
         Texture2D Texture = { 0 };		// the texture record
+        std::string TexturePath;        // the texture file, relative to the map file
         uint16_t StartingTileId = 0;	// the tile id that this sheet starts at
         std::vector<Rectangle> Tiles;	// the list of source rectangles for each tile
+        std::map<uint16_t, TileAnimation> Animations;   // the animated tiles, keyed by the index of the tile in the sheet
+        std::map<uint16_t, std::vector<TileCollisionShape>> CollisionShapes;    // tiles that only collide with part of the cell, keyed by the index of the tile in the sheet
 
         inline bool HasId(uint16_t id) const
         {
@@ -97,23 +136,157 @@ namespace RayTiled
         uint8_t Padding = 0;		// pad to make the structure align with 4 bytes
     };
 
+    // a prebuilt tile quad with the flip flags baked into the texture coordinates
+    struct TileQuad
+    {
+        Vector2 Positions[4] = { 0 };   // corners in world space (top left, bottom left, bottom right, top right)
+        Vector2 TexCoords[4] = { 0 };   // normalized texture coordinates for each corner
+        int X = 0;                      // the grid column the quad belongs to
+    };
+
+    // the quads of a layer mesh that use one tile sheet
+    struct TileLayerMeshSheet
+    {
+        const TileSheet* Sheet = nullptr;
+        std::vector<std::vector<TileQuad>> Rows;    // the quads for each grid row, sorted by column
+    };
+    // prebuilt geometry for a tile layer, one quad list per sheet so runs of tiles from the same texture are drawn in one batch
+    // prebuilt geometry for a tile layer, one quad list per sheet so each texture is drawn in one batch
+    struct TileLayerMesh
+    {
+        std::vector<TileLayerMeshSheet> Sheets;
+        std::unordered_set<uint64_t> AnimatedCells;    // the cells with animated tiles, packed as x << 32 | y, their texture coordinates are patched by UpdateTileAnimations
+    };
+
+    // a run of visible cells in one grid row
+    struct TileRowSpan
+    {
+        int Y = 0;          // the grid row
+        int StartX = 0;     // the first visible column
+        int EndX = 0;       // one past the last visible column
+        int Step = 1;       // the column step, 2 when only every other column of a staggered row is visible
+    };
+
+    // one pre-rendered block of tiles in a layer cache
+    struct TileLayerCacheChunk
+    {
+        RenderTexture2D Target = { 0 };     // the rendered tiles, id is 0 when the chunk is not resident
+        bool Dirty = true;                  // the tiles changed since the chunk was rendered
+        bool Uncacheable = false;           // did not fit in the memory budget, it is drawn tile by tile until the budget or the visible chunks change
+        uint64_t LastUsedFrame = 0;         // the last cache update the chunk was visible in
+        std::vector<uint16_t> AnimatedTiles;    // the animated tile ids drawn in the chunk, it is rendered again when one of them changes frame
+    };
+
+    // renders fixed size blocks of a static layer into render textures so each block can be drawn with a single quad
+    struct TileLayerCache
+    {
+        int ChunkSize = 32;                         // the number of tiles on each side of a chunk
+        size_t MemoryBudget = 0;                    // the most render texture memory the cache may use, in bytes
+        size_t MemoryUsed = 0;                      // the render texture memory currently in use, in bytes
+        int ChunksX = 0;                            // the number of chunk columns
+        int ChunksY = 0;                            // the number of chunk rows
+        std::vector<TileLayerCacheChunk> Chunks;    // the chunks in row major order
+        uint64_t Frame = 0;                         // incremented on every cache update
+        std::vector<size_t> UncacheableChunks;      // the indexes of the chunks marked as uncacheable
+        size_t UncacheableBudget = 0;               // the memory budget when the chunks were marked
+        int ViewChunks[4] = { 0, 0, 0, 0 };         // the visible chunk range of the last update, start x, start y, end x, end y
+    };
+
+    // a fixed size block of cells in a sparse tile layer
+    struct TileLayerChunk
+    {
+        std::vector<TileInfo> TileData;     // ChunkWidth * ChunkHeight cells, row major
+        std::vector<uint64_t> SolidRows;    // one word per row with a bit for each solid cell, built by SetLayerCollisions
+    };
+
+    // a tile collision shape placed in a layer
+    struct TileShapeInstance
+    {
+        TileShapeType Type = TileShapeType::Rectangle;
+        Rectangle Bounds = { 0 };   // the world space bounds, with the tile flips applied
+        uint32_t FirstPoint = 0;    // the world space polygon points in TileShapeIndex::Points
+        uint32_t PointCount = 0;
+        uint16_t TileId = 0;        // the tile the shape came from
+        int CellX = 0;              // the cell the tile is in
+        int CellY = 0;
+    };
+
+    // every tile collision shape in a layer, bucketed on a coarse grid so queries only test the shapes near them
+    // editing a cell only changes the shapes of that cell and the buckets they touch
+    struct TileShapeIndex
+    {
+        int BucketSize = 8;                     // the number of cells on each side of a bucket
+        int BucketsX = 0;
+        int BucketsY = 0;
+        std::vector<TileShapeInstance> Shapes;  // removed shapes leave free slots that are reused by the next shapes added
+        std::vector<Vector2> Points;            // polygon points for all the shapes
+        std::vector<std::vector<uint32_t>> Buckets;     // the shape indexes in each bucket, row major, a shape is in every bucket its bounds touch
+        std::unordered_map<uint64_t, std::vector<uint32_t>> CellShapes;  // the shape indexes of each cell that has shapes, keyed by packed cell coordinates
+        std::vector<uint32_t> FreeShapes;       // the free slots in Shapes
+        size_t UnusedPoints = 0;                // points left behind by removed polygons, Points is compacted when they are over half of it
+    };
+
+    // a block of solid cells found by merging
+    struct TileCollisionRect
+    {
+        int X = 0;          // the top left cell
+        int Y = 0;
+        int Width = 0;      // the size in cells
+        int Height = 0;
+    };
+
+    // the solid cells of a layer merged into rectangles, each region is merged on its own so an edit only merges one region again
+    struct TileLayerMergedCollisions
+    {
+        int RegionSize = 32;                                // the number of cells on each side of a region, at most 64
+        int RegionsX = 0;
+        int RegionsY = 0;
+        std::vector<std::vector<TileCollisionRect>> Regions;    // the rectangles in each region, row major
+    };
+
     // A layer made up of tile elements
     struct TileLayer : public LayerInfo
     {
         Vector2 Bounds = { 0 };						                        // the grid size of the layer
         Vector2 TileSize = { 0 };					                        // the size of one tile element in the grid
-        std::vector<TileInfo> TileData;				                        // the actual tile instances
+        std::vector<TileInfo> TileData;				                        // the actual tile instances, empty for sparse layers
+        const TileInfo* ExternalTileData = nullptr;                         // tiles owned by something else, such as a memory mapped cooked map, used instead of TileData until the first edit
         TileMapOrientation Orientation = TileMapOrientation::Orthogonal;	// the map orientation, used to determine how to draw the tiles
 
+        bool Sparse = false;                                    // the tiles are stored in chunks instead of TileData, so empty areas use no memory
+        int ChunkWidth = 16;                                    // the size of each chunk in cells, for sparse layers
+        int ChunkHeight = 16;
+        std::unordered_map<uint64_t, TileLayerChunk> Chunks;    // the chunks that have tiles, keyed by GetChunkKey
+
+        static uint64_t GetChunkKey(int chunkX, int chunkY) { return (uint64_t(uint32_t(chunkX)) << 32) | uint64_t(uint32_t(chunkY)); }
+
+        // finds a chunk by its chunk coordinate, nullptr if it has never been painted
+        const TileLayerChunk* FindChunk(int chunkX, int chunkY) const;
+
+        // the dense tiles, row major, from TileData or ExternalTileData
+        const TileInfo* GetTileData() const { return ExternalTileData ? ExternalTileData : TileData.data(); }
+
+        // the tile in a cell for both storage modes, nullptr if the cell is outside the layer or in an empty chunk
+        const TileInfo* GetTileInfo(int x, int y) const;
+        TileInfo* GetTileInfo(int x, int y);
+
         void* UserData = nullptr;
 
         TileLayer() { Type = TileLayerType::Tile; }
 
         const TileInfo* GetTile(int x, int y, Rectangle& screenRect) const;
 
+        // finds the cells that overlap a world space rectangle, using the inverse of the projection in GetTile
+        void GetVisibleSpans(Rectangle view, std::vector<TileRowSpan>& spans) const;
+
         // TODO Collisions
 
-        bool CellHasTile(int x, int y, uint16_t* result = nullptr);
+        bool CellHasTile(int x, int y, uint16_t* result = nullptr) const;
+
+        std::vector<uint64_t> CollisionMask;    // one bit per cell that has a tile, row by row, built by SetLayerCollisions
+        int CollisionMaskStride = 0;            // the number of 64 bit words in each row of the mask
+        TileShapeIndex CollisionShapes;         // the shapes of tiles that have collision shapes, built by SetLayerCollisions
+        std::unique_ptr<TileLayerMergedCollisions> MergedCollisions;    // optional merged solid cells, see EnableMergedCollisions
 // 
 //         bool CheckCollisionRectangle(const Rectangle& rect);
 //         bool CheckCollisionCircle(const Vector2& position, float radius);
@@ -135,6 +308,9 @@ namespace RayTiled
 
         void AddDrawable(Drawable* item);
         void RemoveDrawable(Drawable* item);
+
+        std::unique_ptr<TileLayerMesh> Mesh;        // optional prebuilt geometry, see BuildTileLayerMesh
+        std::unique_ptr<TileLayerCache> Cache;      // optional render texture cache, see EnableTileLayerCache
     };
 
     // callback used for custom layer drawing
@@ -170,11 +346,13 @@ namespace RayTiled
             std::string Name;
             std::string ClassName;
             std::string TemplateName;
+
+            virtual ~Object() = default;
         };
 
         struct PolygonObject : public Object
         {
-            std::vector<Vector2> Points;
+            std::vector<Vector2> Points;      // relative to the top left of the bounds
             PolygonObject() { Type = ObjectType::Polygon; }
         };
 
@@ -187,7 +365,75 @@ namespace RayTiled
 
         std::vector<std::unique_ptr<Object>> Objets;
 
-        // Collision functions TBD
+        // uniform grid over the object bounds, so queries only test the objects near them
+        struct SpatialGrid
+        {
+            float CellSize = 128;                                       // the world size of each grid cell
+            std::unordered_map<uint64_t, std::vector<Object*>> Cells;   // the objects overlapping each cell, keyed by packed cell coordinates
+        };
+
+        SpatialGrid Grid;
+
+        std::unordered_map<int32_t, size_t> ObjectIndexes;     // the position of each object in Objets, keyed by object id
+
+        // add, remove and move objects while keeping the grid and the id index up to date, object ids must be unique in the layer
+        // removing an object moves the last object into its place
+        Object* AddObject(std::unique_ptr<Object> object);
+        bool RemoveObject(int32_t id);
+        bool MoveObject(int32_t id, Rectangle bounds);
+        Object* FindObject(int32_t id) const;
+
+        // rebuilds the grid and the id index from scratch, with a new cell size, call it after changing Objets directly
+        void RebuildIndex(float cellSize);
+
+        // calls func once for every object whose bounds overlap the rectangle, if func returns a bool then false stops the search
+        // returns false if the search was stopped
+        template<class Func>
+        bool ForEachObjectInRect(Rectangle rect, Func&& func) const
+        {
+            int startX, startY, endX, endY;
+            GetCellRange(rect, startX, startY, endX, endY);
+
+            for (int y = startY; y <= endY; y++)
+            {
+                for (int x = startX; x <= endX; x++)
+                {
+                    auto itr = Grid.Cells.find(GetCellKey(x, y));
+                    if (itr == Grid.Cells.end())
+                        continue;
+
+                    for (Object* object : itr->second)
+                    {
+                        if (!CheckCollisionRecs(rect, object->Bounds))
+                            continue;
+
+                        // objects can be in many cells, only report them from the cell that has the corner of the overlap
+                        int cellX = GetCellCoordinate(std::max(rect.x, object->Bounds.x));
+                        int cellY = GetCellCoordinate(std::max(rect.y, object->Bounds.y));
+                        if (cellX != x || cellY != y)
+                            continue;
+
+                        if constexpr (std::is_same_v<std::invoke_result_t<Func, Object&>, bool>)
+                        {
+                            if (!func(*object))
+                                return false;
+                        }
+                        else
+                        {
+                            func(*object);
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+
+    private:
+        int GetCellCoordinate(float value) const { return int(std::floor(value / Grid.CellSize)); }
+        static uint64_t GetCellKey(int x, int y) { return (uint64_t(uint32_t(x)) << 32) | uint64_t(uint32_t(y)); }
+        void GetCellRange(const Rectangle& rect, int& startX, int& startY, int& endX, int& endY) const;
+        void InsertIntoGrid(Object* object);
+        void RemoveFromGrid(Object* object);
     };
 
     // a layer provided by the game
@@ -201,6 +447,113 @@ namespace RayTiled
         UserLayerDrawFunction DrawFunction;
     };
 
+    // everything needed to draw one tile id
+    struct TileLookupEntry
+    {
+        const TileSheet* Sheet = nullptr;   // the sheet that has the tile, nullptr if the id is not in any sheet
+        uint16_t LocalIndex = 0;            // the index of the tile in the sheet
+        Rectangle Source = { 0 };           // the source rectangle in the sheet texture, the current frame for animated tiles
+        int Animation = -1;                 // the index in TileMap::Animations, -1 if the tile is not animated
+        const std::vector<TileCollisionShape>* CollisionShapes = nullptr;  // the collision shapes of the tile, nullptr if the whole cell is solid
+    };
+
+    // the playback of one animated tile id in a map
+    struct TileAnimationState
+    {
+        uint16_t TileId = 0;                        // the animated tile id
+        const TileAnimation* Animation = nullptr;   // the frames, owned by the sheet
+        size_t Frame = 0;                           // the frame that is in the lookup table
+        bool Changed = false;                       // the frame changed in the last UpdateTileAnimations
+    };
+
+    // the value types of a custom property
+    enum class PropertyType : uint8_t
+    {
+        None,       // not a known type, the value is empty
+        String,
+        Int,
+        Float,
+        Bool,
+        Color,
+        File,       // a path, relative to the file the property was read from
+        Object,     // the id of an object in the map
+    };
+
+    // an interned property name, the same name always gives the same key for the life of the program. 0 is never a valid key
+    using PropertyKey = uint32_t;
+
+    // the things that can have properties
+    enum class PropertyOwnerType : uint8_t
+    {
+        Map,
+        Layer,      // by layer id
+        Object,     // by object id
+        Tile,       // by tile id
+    };
+
+    // packs an owner type and id into the owner value used by property lookups
+    inline uint64_t GetPropertyOwner(PropertyOwnerType type, int32_t id = 0)
+    {
+        return (uint64_t(type) << 32) | uint64_t(uint32_t(id));
+    }
+
+    // one typed property value
+    struct Property
+    {
+        uint64_t Owner = 0;                         // the packed owner, see GetPropertyOwner
+        PropertyKey Key = 0;                        // the interned name
+        PropertyType Type = PropertyType::None;     // which of the values is used
+        int32_t IntValue = 0;                       // int, bool and object values
+        float FloatValue = 0;                       // float values
+        Color ColorValue = { 0 };                   // color values
+        uint32_t TextOffset = 0;                    // string and file values, the offset of the null terminated text in the store
+    };
+
+    // every property of a map in flat arrays, with a hash table of owner and key so a lookup is a few probes and no string compares
+    struct PropertyStore
+    {
+        std::vector<Property> Properties;   // the properties in the order they were added
+        std::vector<char> Text;             // the text of string and file values, each null terminated
+        std::vector<uint32_t> Slots;        // open addressing table of property index + 1, 0 is an empty slot, the size is a power of two
+
+        // finds a property, nullptr if the owner does not have it
+        const Property* Find(uint64_t owner, PropertyKey key) const;
+
+        // adds a property with no value, or clears the value of the one that is already there
+        Property& Add(uint64_t owner, PropertyKey key);
+
+        // sets the text of a string or file property, replaced text stays in the arena until the store is cleared
+        void SetText(Property& property, const char* text);
+
+        const char* GetText(const Property& property) const { return property.TextOffset < Text.size() ? Text.data() + property.TextOffset : ""; }
+
+        // rebuilds the hash table from the properties
+        void Rehash();
+
+        void Clear();
+    };
+
+    struct TileDrawBackend;
+
+    // the drawables of a layer bucketed by the row they are drawn after, rebuilt every time the layer is drawn
+    struct TileDrawableIndex
+    {
+        int StartRow = 0;
+        std::vector<int> Rows;                          // the row of each drawable, in layer order
+        std::vector<size_t> BucketStarts;               // the first sorted drawable for each row, plus an end marker
+        std::vector<TileLayer::Drawable*> Sorted;       // the drawables in row order
+    };
+
+    // the backend, stats and scratch memory used while drawing, owned by the caller so the map is only read.
+    // one map can be drawn from several views or threads at once as long as each uses its own context
+    struct TileDrawContext
+    {
+        TileDrawBackend* Backend = nullptr;         // where tiles are emitted, nullptr uses the default raylib backend
+        size_t TilesDrawn = 0;                      // the tiles emitted by the last DrawTileMap with this context
+        std::vector<TileRowSpan> VisibleSpans;      // reused between frames so that culling does not allocate
+        TileDrawableIndex Drawables;                // reused between frames so that sorting does not allocate
+    };
+
     // the full tilemap
     struct TileMap
     {
@@ -211,10 +564,88 @@ namespace RayTiled
 
         Vector2 TileRenderOrder = { 1,1 };
 
-        // used as a cache
-        const TileSheet* LastTileSheet = nullptr;
+        std::vector<TileLookupEntry> TileLookup;        // indexed by tile id, built from the sheets by BuildTileLookup
+        std::vector<TileAnimationState> Animations;     // every animated tile id, built by BuildTileLookup and advanced by UpdateTileAnimations
+
+        bool Infinite = false;                          // the map was saved as an infinite map, its tile layers are sparse
+        Vector2 Origin = { 0, 0 };                      // the editor cell that is at cell 0,0, infinite maps are moved so the top left chunk starts at 0,0
+
+        std::shared_ptr<const void> CookedData;         // keeps the file of a cooked map alive while layers point into it
+
+        PropertyStore Properties;                       // the custom properties of the map, its layers, objects and tiles
     };
 
+    /// <summary>
+    /// Rebuilds the tile id lookup table of a map, this is done on load and must be called again if the sheets are changed
+    /// </summary>
+    /// <param name="map">The map to build</param>
+    void BuildTileLookup(TileMap& map);
+
+    /// <summary>
+    /// Finds the sheet and source rectangle for a tile id
+    /// </summary>
+    /// <param name="map">The map to search</param>
+    /// <param name="id">The tile id</param>
+    /// <returns>The lookup entry for the tile, or nullptr if the id is not in any sheet</returns>
+    inline const TileLookupEntry* GetTileLookup(const TileMap& map, uint16_t id)
+    {
+        if (id >= map.TileLookup.size() || map.TileLookup[id].Sheet == nullptr)
+            return nullptr;
+
+        return &map.TileLookup[id];
+    }
+
+    /// <summary>
+    /// Gets the key for a property name, look keys up once and keep them so property queries don't need to hash strings. Safe to call from any thread
+    /// </summary>
+    /// <param name="name">The property name</param>
+    /// <returns>The interned key, the same for every map</returns>
+    PropertyKey GetPropertyKey(const std::string& name);
+
+    /// <summary>
+    /// Gets the name of an interned property key
+    /// </summary>
+    /// <returns>The name, or an empty string if the key is not valid</returns>
+    const std::string& GetPropertyName(PropertyKey key);
+
+    /// <summary>
+    /// Finds a property of the map, a layer, an object or a tile
+    /// </summary>
+    /// <param name="map">The map to search</param>
+    /// <param name="owner">The owner from GetPropertyOwner</param>
+    /// <param name="key">The key from GetPropertyKey</param>
+    /// <returns>The property, or nullptr if the owner does not have it</returns>
+    inline const Property* FindProperty(const TileMap& map, uint64_t owner, PropertyKey key)
+    {
+        return map.Properties.Find(owner, key);
+    }
+
+    /// <summary>
+    /// Gets a property as a number, int, object, bool and float properties are converted, anything else gives the default
+    /// </summary>
+    int GetPropertyInt(const TileMap& map, uint64_t owner, PropertyKey key, int defaultValue = 0);
+
+    /// <summary>
+    /// Gets a property as a float, float and int properties are converted, anything else gives the default
+    /// </summary>
+    float GetPropertyFloat(const TileMap& map, uint64_t owner, PropertyKey key, float defaultValue = 0);
+
+    /// <summary>
+    /// Gets a property as a bool, bool and int properties are converted, anything else gives the default
+    /// </summary>
+    bool GetPropertyBool(const TileMap& map, uint64_t owner, PropertyKey key, bool defaultValue = false);
+
+    /// <summary>
+    /// Gets a color property, anything else gives the default
+    /// </summary>
+    Color GetPropertyColor(const TileMap& map, uint64_t owner, PropertyKey key, Color defaultValue = BLANK);
+
+    /// <summary>
+    /// Gets the text of a string or file property, anything else gives the default
+    /// </summary>
+    /// <returns>The text, owned by the map</returns>
+    const char* GetPropertyString(const TileMap& map, uint64_t owner, PropertyKey key, const char* defaultValue = "");
+
     /// <summary>
     /// Load a tile map from a file on disk
     /// </summary>
@@ -225,13 +656,91 @@ namespace RayTiled
 
     bool LoadTileMapFromMemory(const char* fileData, TileMap& map);
 
+    /// <summary>
+    /// Saves a loaded map in the cooked binary format. LoadTileMap detects cooked files and maps them into memory instead of parsing them
+    /// </summary>
+    /// <param name="map">The map to save, user layers are not saved</param>
+    /// <param name="filepath">The file to write, texture paths are stored relative to the original map so the file should be saved next to it</param>
+    /// <returns>True if the file was written</returns>
+    bool SaveCookedTileMap(const TileMap& map, const std::string& filepath);
+
+    // the stages of a background map load
+    enum class TileMapLoadState
+    {
+        Loading,        // the file is being read and parsed on the loader thread
+        Uploading,      // the map is parsed, textures are waiting for UpdateTileMapLoads
+        Done,           // the map is ready for TakeLoadedTileMap
+        Failed,         // the map could not be loaded
+        Cancelled,      // CancelTileMapLoad was called before the map was taken
+    };
+
+    // a background map load, defined in ray_tilemap_async.cpp
+    struct TileMapLoad;
+    using TileMapLoadHandle = std::shared_ptr<TileMapLoad>;
+
+    /// <summary>
+    /// Starts loading a map on the loader thread. File IO, parsing, decompression and image decoding happen in the background,
+    /// textures are uploaded by UpdateTileMapLoads. Custom file callbacks must be safe to call from the loader thread, custom texture callbacks are called from UpdateTileMapLoads
+    /// </summary>
+    /// <param name="filepath">The tmx or cooked map to load</param>
+    /// <returns>A handle to poll, wait on or cancel</returns>
+    TileMapLoadHandle LoadTileMapAsync(const std::string& filepath);
+
+    /// <summary>
+    /// Uploads the textures of background loads, call once a frame from the main thread
+    /// </summary>
+    /// <param name="budgetSeconds">How long to spend uploading, at least one texture is uploaded each call while any are waiting</param>
+    void UpdateTileMapLoads(float budgetSeconds = 0.002f);
+
+    /// <summary>
+    /// Gets the current stage of a background load
+    /// </summary>
+    TileMapLoadState GetTileMapLoadState(const TileMapLoadHandle& handle);
+
+    /// <summary>
+    /// Blocks until a background load has been parsed, then uploads all of its textures. Must be called from the main thread
+    /// </summary>
+    /// <returns>True if the map is ready</returns>
+    bool WaitForTileMapLoad(const TileMapLoadHandle& handle);
+
+    /// <summary>
+    /// Stops a background load, anything it already loaded is released. A finished map that has not been taken is unloaded. Must be called from the main thread
+    /// </summary>
+    void CancelTileMapLoad(const TileMapLoadHandle& handle);
+
+    /// <summary>
+    /// Moves a finished map out of a background load
+    /// </summary>
+    /// <param name="handle">The load, it must be in the Done state</param>
+    /// <param name="map">The map to fill out</param>
+    /// <returns>True if the map was finished and moved</returns>
+    bool TakeLoadedTileMap(const TileMapLoadHandle& handle, TileMap& map);
+
     /// <summary>
     /// Deallocates and clears a tilemap
     /// </summary>
     /// <param name="map">the map to clear</param>
-    /// <param name="releaseTextures">When true, textures from all sheets will be unloaded from the GPU</param>
+    /// <param name="releaseTextures">When true, sheet textures that no other map uses are unloaded from the GPU (or kept within the texture budget).
+    /// When false they stay loaded until the texture cache is trimmed or purged</param>
     void UnloadTileMap(TileMap& map, bool releaseTextures = true);
 
+    /// <summary>
+    /// Sets how much memory textures that no map uses can keep, so the next map can reuse them. The oldest are unloaded first, the default is 0
+    /// </summary>
+    /// <param name="bytes">The budget in bytes of texture memory</param>
+    void SetTileMapTextureBudget(size_t bytes);
+
+    /// <summary>
+    /// Unloads every cached texture that no map uses
+    /// </summary>
+    void PurgeTileMapTextures();
+
+    /// <summary>
+    /// Gets the memory used by all textures in the texture cache, including ones that no map uses
+    /// </summary>
+    /// <returns>The size in bytes</returns>
+    size_t GetTileMapTextureMemory();
+
     // callback function that loads a texture, if not set default raylib functions will be used
     using LoadTextureFunction = std::function<Texture2D(const char* filePath)>;
 
@@ -250,6 +759,43 @@ namespace RayTiled
     /// <param name="func">The callback function that will be used when a text file is needed</param>
     void SetLoadTextFileFunction(LoadTextFileFunction func);
 
+    /// <summary>
+    /// Forgets all parsed external tilesets. Tilesets are cached by path and parsed again when their file time changes, use this when they change some other way
+    /// </summary>
+    void ClearTileSetCache();
+
+    // everything a load needs, so maps can be parsed on several threads at once
+    struct TileMapLoadContext
+    {
+        std::string BasePath;                           // the folder that files used by the map are loaded from, LoadTileMap sets this to the folder of the map file
+        LoadTextFileFunction TextFileLoader = nullptr;  // used instead of the SetLoadTextFileFunction callback for this load
+        LoadTextureFunction TextureLoader = nullptr;    // used instead of the SetLoadTextureFunction callback for this load
+        bool UseTileSetCache = true;                    // share parsed external tilesets with other loads, ignored when files come from a text file callback
+        bool UseTextureCache = true;                    // share textures with other maps, see SetTileMapTextureBudget
+        bool DeferTextures = false;                     // leave sheet textures empty, the caller loads them from TileSheet::TexturePath. Required for loads off the main thread
+    };
+
+    /// <summary>
+    /// Load a tile map from a file on disk with its own loader settings.
+    /// Loads with DeferTextures set can run on different threads at the same time, other loads upload textures and must be called from the main thread
+    /// </summary>
+    /// <param name="filepath">The file path to load</param>
+    /// <param name="map">The tile map to fill out</param>
+    /// <param name="context">The loader settings, the base path is replaced with the folder of the file</param>
+    /// <returns>True if the file was loaded</returns>
+    bool LoadTileMap(const std::string& filepath, TileMap& map, const TileMapLoadContext& context);
+
+    /// <summary>
+    /// Load a tile map from tmx data in memory, with files used by the map loaded from the context base path.
+    /// Only loads with DeferTextures set can run off the main thread
+    /// </summary>
+    bool LoadTileMapFromMemory(const char* fileData, TileMap& map, const TileMapLoadContext& context);
+
+    /// <summary>
+    /// Starts a background load with its own loader settings, see LoadTileMapAsync
+    /// </summary>
+    TileMapLoadHandle LoadTileMapAsync(const std::string& filepath, const TileMapLoadContext& context);
+
     /// <summary>
     /// Insert a virtual layer into a tilemap
     /// </summary>
@@ -280,23 +826,602 @@ namespace RayTiled
     /// Draws all visible layers
     /// </summary>
     /// <param name="map">The Map to draw</param>
+    /// <param name="context">The backend and scratch memory to draw with, the map itself is not changed</param>
     /// <param name="camera">An optional camera, if provided only tiles in the visible range will be used</param>
     /// <param name="bounds">An optional size boundary, 
     /// if provided will be used with the camera to limit what is drawn, if not provided the screen size will be used
     /// </param>
-    void DrawTileMap(TileMap& map, Camera2D* camera = nullptr, Vector2 bounds = { 0,0 });
+    void DrawTileMap(const TileMap& map, TileDrawContext& context, Camera2D* camera = nullptr, Vector2 bounds = { 0,0 });
+
+    /// <summary>
+    /// Draws all visible layers with the default draw context of the calling thread, see GetDefaultTileDrawContext
+    /// </summary>
+    void DrawTileMap(const TileMap& map, Camera2D* camera = nullptr, Vector2 bounds = { 0,0 });
+
+    /// <summary>
+    /// Gets the draw context used by the DrawTileMap and DrawTileWorld calls that do not take one. Each thread has its own
+    /// </summary>
+    /// <returns>The context of the calling thread</returns>
+    TileDrawContext& GetDefaultTileDrawContext();
+
+    /// <summary>
+    /// Builds the quad mesh for a tile layer, once built the layer is drawn from the mesh instead of the tile data
+    /// </summary>
+    /// <param name="map">The map that owns the layer, used to find the tile sheets</param>
+    /// <param name="layer">The layer to build</param>
+    void BuildTileLayerMesh(const TileMap& map, TileLayer& layer);
+
+    /// <summary>
+    /// Builds the quad mesh for every tile layer in a map
+    /// </summary>
+    /// <param name="map">The map to build</param>
+    void BuildTileMapMeshes(TileMap& map);
+
+    /// <summary>
+    /// Frees the mesh of a layer, the layer will be drawn tile by tile again
+    /// </summary>
+    /// <param name="layer">The layer to release</param>
+    void ReleaseTileLayerMesh(TileLayer& layer);
+
+    /// <summary>
+    /// Changes a tile in a layer, keeping any prebuilt data for the layer up to date
+    /// </summary>
+    /// <param name="map">The map that owns the layer</param>
+    /// <param name="layer">The layer to modify</param>
+    /// <param name="x">The grid column</param>
+    /// <param name="y">The grid row</param>
+    /// <param name="tileIndex">The new tile id, 0 for no tile</param>
+    /// <param name="flags">The flip flags for the new tile</param>
+    /// <returns>True if the cell is in the layer</returns>
+    bool SetLayerTile(const TileMap& map, TileLayer& layer, int x, int y, uint16_t tileIndex, uint8_t flags = TileFlagsNone);
+
+    /// <summary>
+    /// Turns on the render texture cache for a static orthogonal layer.
+    /// Cached layers are drawn from pre-rendered chunks, chunks are rendered by UpdateTileMapCaches
+    /// </summary>
+    /// <param name="layer">The layer to cache</param>
+    /// <param name="chunkSize">The number of tiles on each side of a chunk</param>
+    /// <param name="memoryBudget">The most render texture memory the layer may use, in bytes. Least recently seen chunks are released first</param>
+    void EnableTileLayerCache(TileLayer& layer, int chunkSize = 32, size_t memoryBudget = 64 * 1024 * 1024);
+
+    /// <summary>
+    /// Turns off the render texture cache for a layer and unloads all of its render textures
+    /// </summary>
+    /// <param name="layer">The layer to release</param>
+    void ReleaseTileLayerCache(TileLayer& layer);
+
+    /// <summary>
+    /// Renders any visible cache chunks that are missing or out of date, and releases old chunks that are over budget.
+    /// Must be called once per frame, before BeginMode2D, since it uses texture mode
+    /// </summary>
+    /// <param name="map">The map to update</param>
+    /// <param name="camera">An optional camera, if provided only chunks in the visible range will be rendered</param>
+    /// <param name="bounds">An optional size boundary, if not provided the screen size will be used</param>
+    void UpdateTileMapCaches(TileMap& map, Camera2D* camera = nullptr, Vector2 bounds = { 0,0 });
+
+    /// <summary>
+    /// Advances the animated tiles of a map to a point in time. The current frame of each animated tile is written into the tile lookup table,
+    /// so drawing needs no timing math, and the meshes and cache chunks that show a tile that changed frame are updated.
+    /// Call once per frame, before UpdateTileMapCaches
+    /// </summary>
+    /// <param name="map">The map to update</param>
+    /// <param name="time">The animation clock in seconds, such as GetTime(), so every map using the same clock stays in step</param>
+    void UpdateTileAnimations(TileMap& map, double time);
+
+    // draw stats, the number of tiles emitted by the last DrawTileMap with the context
+    size_t GetTileDrawStats(const TileDrawContext& context);
+
+    // a single tile draw emitted by DrawTileMap
+    struct TileDrawCommand
+    {
+        Rectangle Source = { 0 };       // the source rectangle in the sheet texture
+        Rectangle Destination = { 0 };  // the destination rectangle in world space
+        uint8_t Flags = 0;              // flip flags
+    };
+
+    // interface that receives all tile draws from DrawTileMap, the default backend forwards them to raylib
+    struct TileDrawBackend
+    {
+        virtual ~TileDrawBackend() = default;
+
+        // called before and after the tiles of a layer are emitted
+        virtual void BeginLayer(const TileLayer& /*layer*/) {}
+        virtual void EndLayer(const TileLayer& /*layer*/) { Flush(); }
+
+        virtual void DrawTile(const TileSheet& sheet, const TileDrawCommand& command, Color tint) = 0;
+
+        // draws a run of prebuilt quads that all use the same sheet
+        virtual void DrawQuads(const TileSheet& sheet, const TileQuad* quads, size_t count, Color tint) = 0;
+
+        // draws a block of pre-rendered tiles, such as a layer cache chunk
+        virtual void DrawTexture(Texture2D texture, Rectangle source, Rectangle destination, Color tint) = 0;
+
+        // called before any non tile drawing (drawables, object and user layers) so that any pending work is submitted in order
+        virtual void Flush() {}
+    };
+
+    // draws tiles with raylib as soon as they are emitted
+    struct RaylibTileDrawBackend : public TileDrawBackend
+    {
+        void DrawTile(const TileSheet& sheet, const TileDrawCommand& command, Color tint) override;
+        void DrawQuads(const TileSheet& sheet, const TileQuad* quads, size_t count, Color tint) override;
+        void DrawTexture(Texture2D texture, Rectangle source, Rectangle destination, Color tint) override;
+    };
+
+    // the commands recorded for one texture
+    struct TileDrawBatch
+    {
+        unsigned int TextureId = 0;
+        std::vector<TileDrawCommand> Commands;
+        std::vector<Color> CommandTints;        // the tint of each command
+        std::vector<TileQuad> Quads;            // quads submitted from layer meshes
+        std::vector<Color> QuadTints;           // the tint of each quad
+    };
+
+    // a pre-rendered texture drawn through the backend, such as a layer cache chunk
+    struct TileTextureDraw
+    {
+        unsigned int TextureId = 0;
+        Rectangle Source = { 0 };
+        Rectangle Destination = { 0 };
+        Color Tint = WHITE;
+    };
+
+    // records tile draws into per texture command buffers instead of drawing them, does not need a GPU
+    struct RecordingTileDrawBackend : public TileDrawBackend
+    {
+        std::vector<TileDrawBatch> Batches;     // one batch per texture, in the order the textures were first used
+        size_t LayerCount = 0;                  // the number of tile layers emitted since the last clear
+        size_t FlushCount = 0;                  // the number of flushes since the last clear
+        std::vector<TileTextureDraw> TextureDraws;  // the pre-rendered textures drawn since the last clear, in draw order
+
+        void BeginLayer(const TileLayer& layer) override;
+        void DrawTile(const TileSheet& sheet, const TileDrawCommand& command, Color tint) override;
+        void DrawQuads(const TileSheet& sheet, const TileQuad* quads, size_t count, Color tint) override;
+        void DrawTexture(Texture2D texture, Rectangle source, Rectangle destination, Color tint) override;
+        void Flush() override;
+
+        // total number of commands in all batches
+        size_t GetCommandCount() const;
 
-    // draw stats
-    size_t GetTileDrawStats();
+        // total number of mesh quads in all batches
+        size_t GetQuadCount() const;
+
+        // removes all commands but keeps the allocated buffers for the next frame
+        void Clear();
+
+    private:
+        size_t LastBatch = 0;
+        TileDrawBatch& GetBatch(const TileSheet& sheet);
+    };
+
+    /// <summary>
+    /// Set the backend that DrawTileMap emits tiles into when drawing with a context
+    /// </summary>
+    /// <param name="context">The context to draw with the backend</param>
+    /// <param name="backend">The backend to use, or nullptr to use the default raylib backend. The backend must outlive any draw calls</param>
+    void SetTileDrawBackend(TileDrawContext& context, TileDrawBackend* backend);
+
+    /// <summary>
+    /// Get the backend that is used by DrawTileMap for a context
+    /// </summary>
+    /// <param name="context">The context to check</param>
+    /// <returns>The active backend, never nullptr</returns>
+    TileDrawBackend* GetTileDrawBackend(const TileDrawContext& context);
 
     // TODO, general collision API
     struct CollisionRecord
     {
         TileLayerType Type = TileLayerType::Tile;
         Rectangle Bounds = { 0,0,0,0 };
-        int32_t ItemId = 0;
+        int32_t ItemId = 0;         // the object id, or the tile id (the top left tile for merged rectangles)
+        int CellX = -1;             // the cells that were hit, for tile layers
+        int CellY = -1;
+        int CellWidth = 0;
+        int CellHeight = 0;
     };
 
-    size_t GetCollisions(TileMap& map, Rectangle rect, std::vector<CollisionRecord>& results);
-}
+    /// <summary>
+    /// Turns collisions on or off for a layer. Tile layers build a bit mask of their solid cells so queries can test 64 cells at a time,
+    /// and place the collision shapes of tiles that have them into an index so those tiles only collide with their shapes
+    /// </summary>
+    /// <param name="map">The map that owns the layer</param>
+    /// <param name="layer">The layer to change</param>
+    /// <param name="enabled">Should the layer be used for collision checks?</param>
+    void SetLayerCollisions(const TileMap& map, LayerInfo& layer, bool enabled);
+
+    /// <summary>
+    /// Merges the solid cells of a tile layer into rectangles, so queries over walls and floors return one record per rectangle instead of one per cell.
+    /// The layer is split into square regions that are merged on their own, SetLayerTile only merges the region it changed again
+    /// </summary>
+    /// <param name="map">The map that owns the layer</param>
+    /// <param name="layer">The layer to merge</param>
+    /// <param name="regionSize">The number of cells on each side of a region, up to 64. Rectangles never cross regions</param>
+    void EnableMergedCollisions(const TileMap& map, TileLayer& layer, int regionSize = 32);
+
+    /// <summary>
+    /// Frees the merged rectangles of a layer, queries go back to reporting each cell
+    /// </summary>
+    /// <param name="layer">The layer to release</param>
+    void ReleaseMergedCollisions(TileLayer& layer);
+
+    /// <summary>
+    /// Finds everything in the collision layers that overlaps a rectangle
+    /// </summary>
+    /// <param name="map">The map to check</param>
+    /// <param name="rect">The world space rectangle to check</param>
+    /// <param name="results">Cleared and filled with the collisions</param>
+    /// <returns>The number of collisions found</returns>
+    size_t GetCollisions(const TileMap& map, Rectangle rect, std::vector<CollisionRecord>& results);
+
+    /// <summary>
+    /// Finds everything in the collision layers that overlaps a rectangle, without allocating
+    /// </summary>
+    /// <param name="map">The map to check</param>
+    /// <param name="rect">The world space rectangle to check</param>
+    /// <param name="results">A buffer for the collisions</param>
+    /// <param name="capacity">The number of records the buffer can hold, any extra collisions are counted but not stored</param>
+    /// <returns>The number of collisions found, which can be larger than capacity</returns>
+    size_t GetCollisions(const TileMap& map, Rectangle rect, CollisionRecord* results, size_t capacity);
+
+    // called for each collision found, return false to stop the query
+    using CollisionCallback = std::function<bool(const CollisionRecord& record)>;
 
+    /// <summary>
+    /// Calls a function for everything in the collision layers that overlaps a rectangle
+    /// </summary>
+    /// <param name="map">The map to check</param>
+    /// <param name="rect">The world space rectangle to check</param>
+    /// <param name="callback">Called for each collision, return false to stop</param>
+    /// <returns>The number of collisions passed to the callback</returns>
+    size_t GetCollisions(const TileMap& map, Rectangle rect, const CollisionCallback& callback);
+
+    /// <summary>
+    /// Checks if anything in the collision layers overlaps a rectangle, stopping at the first hit
+    /// </summary>
+    /// <param name="map">The map to check</param>
+    /// <param name="rect">The world space rectangle to check</param>
+    /// <returns>True if there was a collision</returns>
+    bool HasCollision(const TileMap& map, Rectangle rect);
+
+    // where the results for one query are stored in a batch
+    struct CollisionRange
+    {
+        size_t Start = 0;       // the index of the first record in the batch results
+        size_t Count = 0;       // the number of records for the query
+    };
+
+    // the output of GetCollisionsBatch, keep it around between calls to reuse the memory
+    struct CollisionBatch
+    {
+        std::vector<CollisionRecord> Results;                   // every collision, grouped by query in the order of the queries
+        std::vector<CollisionRange> Ranges;                     // one range per query
+
+        std::vector<const LayerInfo*> Layers;                   // scratch, the collision layers
+        std::vector<std::vector<CollisionRecord>> BlockResults; // scratch, the results from each block of queries
+    };
+
+    /// <summary>
+    /// Finds the collisions for many rectangles at once, spread across the worker threads.
+    /// The results are the same no matter how many threads are used
+    /// </summary>
+    /// <param name="map">The map to check, it must not be changed until the call returns</param>
+    /// <param name="rects">The world space rectangles to check</param>
+    /// <param name="count">The number of rectangles</param>
+    /// <param name="batch">Filled with the results and the range of results for each rectangle</param>
+    /// <returns>The total number of collisions found</returns>
+    size_t GetCollisionsBatch(const TileMap& map, const Rectangle* rects, size_t count, CollisionBatch& batch);
+
+    // a ray in world space
+    struct TileRay
+    {
+        Vector2 Origin = { 0, 0 };          // where the ray starts
+        Vector2 Direction = { 1, 0 };       // the direction of the ray, does not need to be normalized
+        float MaxDistance = 1000;           // how far along the direction to check
+    };
+
+    // the first thing a ray hit
+    struct RaycastHit
+    {
+        bool Hit = false;                           // did the ray hit anything?
+        TileLayerType Type = TileLayerType::Tile;   // the type of layer that was hit
+        Vector2 Point = { 0, 0 };                   // the world position of the hit
+        Vector2 Normal = { 0, 0 };                  // the surface normal at the hit, rays that start inside something get the reverse of the ray direction
+        float Distance = 0;                         // the distance from the ray origin to the hit
+        int32_t ItemId = 0;                         // the tile id or the object id that was hit
+        int CellX = -1;                             // the cell that was hit, for tile layers
+        int CellY = -1;
+        const LayerInfo* Layer = nullptr;           // the layer that was hit
+    };
+
+    /// <summary>
+    /// Casts a ray against one tile or object layer, tile layers are walked one cell at a time with a DDA.
+    /// Tiles with collision shapes are tested against the shapes that SetLayerCollisions placed, like GetCollisions
+    /// </summary>
+    /// <param name="map">The map that owns the layer</param>
+    /// <param name="layer">The layer to check, it does not need to have collisions enabled</param>
+    /// <param name="ray">The ray to cast</param>
+    /// <param name="hit">Filled out with the closest hit</param>
+    /// <returns>True if the ray hit something</returns>
+    bool RaycastLayer(const TileMap& map, const LayerInfo& layer, const TileRay& ray, RaycastHit& hit);
+
+    /// <summary>
+    /// Casts a ray against all the collision layers in a map
+    /// </summary>
+    /// <param name="map">The map to check</param>
+    /// <param name="ray">The ray to cast</param>
+    /// <param name="hit">Filled out with the closest hit</param>
+    /// <returns>True if the ray hit something</returns>
+    bool Raycast(const TileMap& map, const TileRay& ray, RaycastHit& hit);
+
+    /// <summary>
+    /// Checks if there is a clear line between two points, stopping at the first thing in the collision layers
+    /// </summary>
+    /// <param name="map">The map to check</param>
+    /// <param name="from">The start point</param>
+    /// <param name="to">The end point</param>
+    /// <returns>True if nothing is in the way</returns>
+    bool LineOfSight(const TileMap& map, Vector2 from, Vector2 to);
+
+    /// <summary>
+    /// Casts many rays against the collision layers, spread across the worker threads
+    /// </summary>
+    /// <param name="map">The map to check, it must not be changed until the call returns</param>
+    /// <param name="rays">The rays to cast</param>
+    /// <param name="count">The number of rays</param>
+    /// <param name="hits">An array of count hits, filled out in the same order as the rays</param>
+    /// <returns>The number of rays that hit something</returns>
+    size_t RaycastBatch(const TileMap& map, const TileRay* rays, size_t count, RaycastHit* hits);
+
+    // an entrance cell on the border of a path cluster, the abstract graph is made of these
+    struct PathNode
+    {
+        int X = 0;                          // the cell of the entrance
+        int Y = 0;
+        int Cluster = 0;                    // the cluster the cell is in
+        int32_t Peer = -1;                  // the entrance on the other side of the border, one step away
+        bool Alive = false;                 // false once the border is rebuilt, the node is free to reuse
+
+        struct Edge
+        {
+            int32_t Node = 0;
+            float Cost = 0;
+        };
+        std::vector<Edge> Edges;            // the other entrances of the same cluster that can be reached, with the cost of the shortest path inside the cluster
+    };
+
+    struct PathScratch;
+
+    // a grid of walkable cells built from the collision layers of a map, split into clusters for hierarchical (HPA*) path queries.
+    // queries share the grid and can run on any number of threads, updates wait for running queries to finish
+    struct PathGrid
+    {
+        int Width = 0;                      // the size of the grid in cells
+        int Height = 0;
+        Vector2 CellSize = { 0, 0 };        // the size of one cell in world space
+        int ClusterSize = 16;               // the number of cells on each side of a cluster
+        int ClustersX = 0;
+        int ClustersY = 0;
+
+        std::vector<uint8_t> Blocked;       // one per cell, non zero if the cell can not be walked through
+
+        std::vector<PathNode> Nodes;                    // the entrances, indexed by node id
+        std::vector<int32_t> FreeNodes;                 // node ids that can be reused
+        std::vector<std::vector<int32_t>> BorderNodes;  // the entrances on each cluster border, vertical borders first
+
+        mutable std::shared_mutex Lock;                             // held shared by queries and exclusive by updates
+        mutable std::mutex ScratchLock;
+        mutable std::vector<std::unique_ptr<PathScratch>> Scratch;  // search memory that is not in use, kept between queries so they do not allocate
+
+        PathGrid();
+        PathGrid(const PathGrid&) = delete;
+        PathGrid& operator=(const PathGrid&) = delete;
+        ~PathGrid();
+
+        bool IsBlocked(int x, int y) const { return x < 0 || y < 0 || x >= Width || y >= Height || Blocked[size_t(y) * Width + x] != 0; }
+    };
+
+    /// <summary>
+    /// Builds a path grid from the collision layers of a map. A cell is blocked if anything in the collision layers overlaps it,
+    /// the grid uses the size of the first collision tile layer (or the first tile layer). The clusters are built across the worker threads
+    /// </summary>
+    /// <param name="map">The map to build from, turn on the collision layers first</param>
+    /// <param name="grid">The grid to fill out</param>
+    /// <param name="clusterSize">The number of cells on each side of a cluster, larger clusters have fewer entrances but slower local searches</param>
+    /// <returns>True if the map has a tile layer to build from</returns>
+    bool BuildPathGrid(const TileMap& map, PathGrid& grid, int clusterSize = 16);
+
+    /// <summary>
+    /// Updates the cells of a path grid from the collision layers after tiles were changed, only the clusters around the cells are rebuilt
+    /// </summary>
+    /// <param name="map">The map the grid was built from</param>
+    /// <param name="grid">The grid to update</param>
+    /// <param name="x">The first cell that changed</param>
+    /// <param name="y">The first cell that changed</param>
+    /// <param name="width">The number of cells that changed in X</param>
+    /// <param name="height">The number of cells that changed in Y</param>
+    void UpdatePathGrid(const TileMap& map, PathGrid& grid, int x, int y, int width = 1, int height = 1);
+
+    /// <summary>
+    /// Finds a path between two world space points, moving in 8 directions without cutting the corners of blocked cells.
+    /// Paths are found on the cluster graph and then refined inside each cluster, so they are close to but not always the shortest.
+    /// Safe to call from many threads at once, and does not allocate once the path vector and the grid's search memory have grown
+    /// </summary>
+    /// <param name="grid">The grid to search</param>
+    /// <param name="start">The world space start point</param>
+    /// <param name="goal">The world space goal point</param>
+    /// <param name="path">Cleared and filled with the center of each cell on the path, from the start cell to the goal cell</param>
+    /// <returns>True if a path was found</returns>
+    bool FindPath(const PathGrid& grid, Vector2 start, Vector2 goal, std::vector<Vector2>& path);
+
+    // the cost to reach the nearest goal and the direction to move from every cell of a path grid, shared by any number of units
+    struct FlowField
+    {
+        static constexpr uint8_t NoDirection = 8;
+
+        int Width = 0;                          // the size of the field in cells, the same as the path grid
+        int Height = 0;
+        Vector2 CellSize = { 0, 0 };
+        int SectorSize = 32;                    // the number of cells on each side of a sector, sectors are computed in parallel
+        int SectorsX = 0;
+        int SectorsY = 0;
+
+        std::vector<int32_t> Goals;             // the goal cells, as y * Width + x
+        std::vector<float> Integration;         // the walking cost from each cell to the nearest goal, infinite if no goal can be reached
+        std::vector<uint8_t> Directions;        // the neighbor to move to from each cell, or NoDirection for goals, blocked and unreachable cells
+    };
+
+    /// <summary>
+    /// Builds a flow field towards one or more goals over a path grid, moving the same way as FindPath.
+    /// The field is split into sectors that are computed across the worker threads
+    /// </summary>
+    /// <param name="grid">The grid to build from</param>
+    /// <param name="field">The field to fill out</param>
+    /// <param name="goals">The world space goal points, goals outside the grid or in blocked cells are skipped</param>
+    /// <param name="goalCount">The number of goals</param>
+    /// <param name="sectorSize">The number of cells on each side of a sector</param>
+    /// <returns>True if any goal was in a walkable cell</returns>
+    bool BuildFlowField(const PathGrid& grid, FlowField& field, const Vector2* goals, size_t goalCount, int sectorSize = 32);
+
+    /// <summary>
+    /// Updates a flow field after cells of its path grid changed, call UpdatePathGrid first. Only the cells whose flow went through the changed cells are computed again
+    /// </summary>
+    /// <param name="grid">The grid the field was built from</param>
+    /// <param name="field">The field to update</param>
+    /// <param name="x">The first cell that changed</param>
+    /// <param name="y">The first cell that changed</param>
+    /// <param name="width">The number of cells that changed in X</param>
+    /// <param name="height">The number of cells that changed in Y</param>
+    void InvalidateFlowField(const PathGrid& grid, FlowField& field, int x, int y, int width = 1, int height = 1);
+
+    /// <summary>
+    /// Gets the direction to move from a world space point, a lookup into the direction field. The field must not be changed while units read it
+    /// </summary>
+    /// <param name="field">The field to read</param>
+    /// <param name="position">The world space point</param>
+    /// <returns>A unit vector towards the nearest goal, or zero at a goal or if no goal can be reached</returns>
+    Vector2 GetFlowDirection(const FlowField& field, Vector2 position);
+
+    /// <summary>
+    /// Sets the number of worker threads used by the batched queries, the calling thread always helps
+    /// </summary>
+    /// <param name="count">The number of workers, 0 runs everything on the calling thread and -1 uses one less than the number of cores</param>
+    void SetTileMapWorkerCount(int count);
+
+    /// <summary>
+    /// Gets the number of worker threads used by the batched queries
+    /// </summary>
+    /// <returns>The number of workers, not counting the calling thread</returns>
+    int GetTileMapWorkerCount();
+
+    /// <summary>
+    /// Estimates the CPU memory used by a map's tiles, collision masks, meshes and objects, plus the GPU memory of its layer caches. Sheet textures are shared and not counted
+    /// </summary>
+    /// <param name="map">The map to measure</param>
+    /// <returns>The size in bytes</returns>
+    size_t GetTileMapMemoryUsage(const TileMap& map);
+
+    // the stages of a map in a world
+    enum class WorldMapState
+    {
+        Unloaded,       // not in memory
+        Loading,        // a background load is running
+        Loaded,         // the map is in memory and drawn
+        Failed,         // the map could not be loaded, it is not tried again
+    };
+
+    // one map placed in a world
+    struct WorldMap
+    {
+        std::string FilePath;                               // the map file
+        Rectangle Bounds = { 0 };                           // the world space area of the map, the map is drawn with its top left here
+        WorldMapState State = WorldMapState::Unloaded;
+        TileMap Map;                                        // the map data while it is loaded
+        TileMapLoadHandle Load;                             // the background load while it is loading
+        size_t MemoryUsage = 0;                             // GetTileMapMemoryUsage from when it was loaded
+        uint64_t LastVisibleFrame = 0;                      // the last world update the map was in view, the oldest are evicted first
+    };
+
+    // a set of maps placed next to each other, loaded in the background as the view gets near them
+    struct TileWorld
+    {
+        std::vector<std::unique_ptr<WorldMap>> Maps;    // every map in the world, loaded or not
+
+        float PrefetchRadius = 512;                     // how far outside the view to start loading maps, in world units
+        size_t MemoryBudget = 64 * 1024 * 1024;         // loaded maps outside the prefetch area are unloaded, oldest first, while the world uses more than this
+        size_t MemoryUsed = 0;                          // the memory used by the loaded maps
+        float UploadBudget = 0.002f;                    // seconds per update spent uploading textures, see UpdateTileMapLoads
+        TileMapLoadContext LoadContext;                 // the loader settings used for every map
+        uint64_t Frame = 0;                             // incremented on every world update
+
+        std::function<void(WorldMap& map)> OnMapLoaded;     // called after a map is loaded, use it to enable collisions or build meshes
+        std::function<void(WorldMap& map)> OnMapUnloaded;   // called before a map is unloaded
+    };
+
+    /// <summary>
+    /// Loads the map list from a Tiled .world file, the maps themselves are loaded by UpdateTileWorld
+    /// </summary>
+    /// <param name="filepath">The .world file</param>
+    /// <param name="world">The world to add the maps to</param>
+    /// <returns>True if the file was read</returns>
+    bool LoadTileWorld(const std::string& filepath, TileWorld& world);
+
+    /// <summary>
+    /// Adds a map to a world, for worlds that are not made in Tiled such as a grid of maps
+    /// </summary>
+    /// <param name="world">The world to add to</param>
+    /// <param name="filepath">The map file</param>
+    /// <param name="bounds">The world space area of the map</param>
+    /// <returns>The new world map</returns>
+    WorldMap* AddWorldMap(TileWorld& world, const std::string& filepath, Rectangle bounds);
+
+    /// <summary>
+    /// Starts loading the maps near the view, finishes loads that are done and unloads old maps while over the memory budget.
+    /// Call once a frame from the main thread, it calls UpdateTileMapLoads with the world upload budget
+    /// </summary>
+    /// <param name="world">The world to update</param>
+    /// <param name="view">The world space area that is visible</param>
+    void UpdateTileWorld(TileWorld& world, Rectangle view);
+
+    /// <summary>
+    /// Gets the world space area a camera can see
+    /// </summary>
+    /// <param name="camera">The camera</param>
+    /// <param name="bounds">The size of the view, if zero the screen size is used</param>
+    /// <returns>The bounding rectangle of the view</returns>
+    Rectangle GetCameraView(const Camera2D& camera, Vector2 bounds = { 0, 0 });
+
+    /// <summary>
+    /// Draws every loaded map that is in view, each offset to its place in the world. Call inside BeginMode2D with the same camera
+    /// </summary>
+    /// <param name="world">The world to draw</param>
+    /// <param name="camera">The camera used for culling, in world space</param>
+    /// <param name="bounds">An optional view size, if not provided the screen size will be used</param>
+    void DrawTileWorld(TileWorld& world, Camera2D* camera, Vector2 bounds = { 0, 0 });
+
+    /// <summary>
+    /// Draws every loaded map that is in view with a draw context, see DrawTileWorld
+    /// </summary>
+    void DrawTileWorld(TileWorld& world, TileDrawContext& context, Camera2D* camera, Vector2 bounds = { 0, 0 });
+
+    /// <summary>
+    /// Finds everything in the collision layers of the loaded maps that overlaps a world space rectangle, bounds are in world space
+    /// </summary>
+    /// <returns>The number of collisions found</returns>
+    size_t GetWorldCollisions(const TileWorld& world, Rectangle rect, std::vector<CollisionRecord>& results);
+
+    /// <summary>
+    /// Checks if anything in the collision layers of the loaded maps overlaps a world space rectangle
+    /// </summary>
+    bool HasWorldCollision(const TileWorld& world, Rectangle rect);
+
+    /// <summary>
+    /// Casts a world space ray against the collision layers of the loaded maps, the hit point is in world space
+    /// </summary>
+    bool RaycastWorld(const TileWorld& world, const TileRay& ray, RaycastHit& hit);
+
+    /// <summary>
+    /// Unloads every map and clears the world
+    /// </summary>
+    void UnloadTileWorld(TileWorld& world);
+}
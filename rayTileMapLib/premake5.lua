@@ -31,4 +31,7 @@ project ("rayTileMapLib")
     includedirs { "./src" }
     includedirs { "./include" }
     includedirs { "./include/external/PUGIXML" }
+
+    -- zstd is built from source for layer decompression, without the assembly or legacy format decoders
+    defines { "ZSTD_DISABLE_ASM", "ZSTD_LEGACY_SUPPORT=0" }
     include_raylib()
\ No newline at end of file
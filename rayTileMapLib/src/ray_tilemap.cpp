@@ -30,13 +30,16 @@
 #include "external/PUGIXML/pugixml.hpp"
 
 #include <algorithm>
+#include <cmath>
 
 namespace RayTiled
 {
     static LoadTextureFunction LoadTextureFunc = nullptr;
     static LoadTextFileFunction LoadTextFileFunc = nullptr;
 
-    std::string FolderPath;
+    Texture2D AcquireTexture(const TileMapLoadContext& context, const std::string& fullpath);
+    void ReleaseTexture(const Texture2D& texture, bool unload);
+
     void SetLoadTextureFunction(LoadTextureFunction func)
     {
         LoadTextureFunc = func;
@@ -47,21 +50,37 @@ namespace RayTiled
         LoadTextFileFunc = func;
     }
 
-    void SetFolderPath(const std::string& path)
+    // the folder part of a path, GetDirectoryPath returns a static buffer so it can't be used from the loader thread
+    std::string GetFolderPath(const std::string& filepath)
     {
-        FolderPath = path;
+        size_t slash = filepath.find_last_of("/\\");
+        if (slash == std::string::npos)
+            return std::string();
+
+        if (slash == 0)
+            return filepath.substr(0, 1);
+
+        return filepath.substr(0, slash);
     }
 
-    void ClearFolderPath()
+    std::string GetLoadPath(const TileMapLoadContext& context, const std::string& fileName)
     {
-        FolderPath.clear();
+        if (context.BasePath.empty())
+            return fileName;
+
+        return context.BasePath + "/" + fileName;
     }
 
-    Texture2D GetTexture(const std::string& fileName)
+    bool HasLoadTextureFunction(const TileMapLoadContext& context)
     {
-        std::string fullpath = fileName;
-        if (!FolderPath.empty())
-            fullpath = (FolderPath + "/" + fileName);
+        return context.TextureLoader != nullptr || LoadTextureFunc != nullptr;
+    }
+
+    // loads a texture from a path that already has the map folder in it
+    Texture2D LoadTextureFile(const TileMapLoadContext& context, const std::string& fullpath)
+    {
+        if (context.TextureLoader)
+            return context.TextureLoader(fullpath.c_str());
 
         if (LoadTextureFunc)
             return LoadTextureFunc(fullpath.c_str());
@@ -69,37 +88,219 @@ namespace RayTiled
         return LoadTexture(fullpath.c_str());
     }
 
-    pugi::xml_parse_result ParseXML(const std::string& fileName, pugi::xml_document& doc)
+    Texture2D GetTexture(const TileMapLoadContext& context, const std::string& fileName)
+    {
+        // background loads can't use the GPU, textures are left empty and uploaded later from the sheet texture paths
+        if (context.DeferTextures)
+            return Texture2D{ 0 };
+
+        std::string fullpath = GetLoadPath(context, fileName);
+        if (!context.UseTextureCache)
+            return LoadTextureFile(context, fullpath);
+
+        return AcquireTexture(context, fullpath);
+    }
+
+    // files from a custom loader may not be on disk, so their file time can't tell when they change
+    bool UsesFileTimes(const TileMapLoadContext& context)
+    {
+        return !context.TextFileLoader && !LoadTextFileFunc;
+    }
+
+    pugi::xml_parse_result ParseXML(const TileMapLoadContext& context, const std::string& fileName, pugi::xml_document& doc)
     {
         pugi::xml_parse_result result;
 
-        std::string fullpath = fileName;
-        if (!FolderPath.empty())
-            fullpath = (FolderPath + "/" + fileName);
-        if (LoadTextFileFunc)
+        std::string fullpath = GetLoadPath(context, fileName);
+        if (context.TextFileLoader)
+        {
+            result = doc.load_string(context.TextFileLoader(fullpath.c_str()).c_str());
+        }
+        else if (LoadTextFileFunc)
         {
             result = doc.load_string(LoadTextFileFunc(fullpath.c_str()).c_str());
         }
         else
         {
             char* data = LoadFileText(fullpath.c_str());
+            if (data == nullptr)
+            {
+                result.status = pugi::xml_parse_status::status_file_not_found;
+                return result;
+            }
+
             result = doc.load_string(data);
             UnloadFileText(data);
         }
         return result;
     }
 
+    bool ReadTextFile(const TileMapLoadContext& context, const std::string& fullpath, std::string& text)
+    {
+        if (context.TextFileLoader)
+        {
+            text = context.TextFileLoader(fullpath.c_str());
+            return !text.empty();
+        }
+
+        if (LoadTextFileFunc)
+        {
+            text = LoadTextFileFunc(fullpath.c_str());
+            return !text.empty();
+        }
+
+        char* data = LoadFileText(fullpath.c_str());
+        if (data == nullptr)
+            return false;
+
+        text = data;
+        UnloadFileText(data);
+        return true;
+    }
+
+    size_t GetTileMapMemoryUsage(const TileMap& map)
+    {
+        size_t bytes = sizeof(TileMap) + map.TileLookup.capacity() * sizeof(TileLookupEntry);
+        bytes += map.Properties.Properties.capacity() * sizeof(Property) + map.Properties.Text.capacity() + map.Properties.Slots.capacity() * sizeof(uint32_t);
+        bytes += map.Animations.capacity() * sizeof(TileAnimationState);
+        for (const auto& [id, sheet] : map.TileSheets)
+        {
+            bytes += sizeof(TileSheet) + sheet.Tiles.capacity() * sizeof(Rectangle);
+            for (const auto& [index, animation] : sheet.Animations)
+                bytes += sizeof(TileAnimation) + animation.Frames.capacity() * sizeof(TileAnimationFrame);
+        }
+
+        for (const auto& layer : map.Layers)
+        {
+            if (layer->Type == TileLayerType::Tile)
+            {
+                const TileLayer& tileLayer = static_cast<const TileLayer&>(*layer);
+                bytes += sizeof(TileLayer) + tileLayer.TileData.capacity() * sizeof(TileInfo) + tileLayer.CollisionMask.capacity() * sizeof(uint64_t);
+
+                const TileShapeIndex& shapes = tileLayer.CollisionShapes;
+                bytes += shapes.Shapes.capacity() * sizeof(TileShapeInstance) + shapes.Points.capacity() * sizeof(Vector2);
+                bytes += shapes.FreeShapes.capacity() * sizeof(uint32_t);
+                for (const auto& bucket : shapes.Buckets)
+                    bytes += sizeof(bucket) + bucket.capacity() * sizeof(uint32_t);
+                for (const auto& [key, cell] : shapes.CellShapes)
+                    bytes += sizeof(key) + sizeof(cell) + cell.capacity() * sizeof(uint32_t);
+
+                if (tileLayer.MergedCollisions)
+                {
+                    for (const auto& region : tileLayer.MergedCollisions->Regions)
+                        bytes += sizeof(region) + region.capacity() * sizeof(TileCollisionRect);
+                }
+
+                // tiles in a cooked file still take up memory once the pages are touched
+                if (tileLayer.ExternalTileData != nullptr)
+                    bytes += size_t(tileLayer.Bounds.x) * size_t(tileLayer.Bounds.y) * sizeof(TileInfo);
+
+                for (const auto& [key, chunk] : tileLayer.Chunks)
+                    bytes += sizeof(TileLayerChunk) + chunk.TileData.capacity() * sizeof(TileInfo) + chunk.SolidRows.capacity() * sizeof(uint64_t);
+
+                if (tileLayer.Mesh)
+                {
+                    for (const auto& sheet : tileLayer.Mesh->Sheets)
+                    {
+                        for (const auto& row : sheet.Rows)
+                            bytes += sizeof(row) + row.capacity() * sizeof(TileQuad);
+                    }
+                }
+
+                if (tileLayer.Cache)
+                    bytes += tileLayer.Cache->MemoryUsed + tileLayer.Cache->Chunks.capacity() * sizeof(TileLayerCacheChunk);
+            }
+            else if (layer->Type == TileLayerType::Object)
+            {
+                const ObjectLayer& objectLayer = static_cast<const ObjectLayer&>(*layer);
+                bytes += sizeof(ObjectLayer);
+                for (const auto& object : objectLayer.Objets)
+                {
+                    // close enough for every object type, the text object is the largest
+                    bytes += sizeof(ObjectLayer::TextObject);
+                    if (object->Type == ObjectLayer::ObjectType::Polygon)
+                        bytes += static_cast<const ObjectLayer::PolygonObject&>(*object).Points.capacity() * sizeof(Vector2);
+                }
+
+                for (const auto& [key, cell] : objectLayer.Grid.Cells)
+                    bytes += sizeof(key) + sizeof(cell) + cell.capacity() * sizeof(ObjectLayer::Object*);
+
+                bytes += objectLayer.ObjectIndexes.size() * (sizeof(int32_t) + sizeof(size_t));
+            }
+        }
+
+        return bytes;
+    }
+
     void UnloadTileMap(TileMap& map, bool releaseTextures)
     {
+        for (auto& layer : map.Layers)
+        {
+            if (layer->Type == TileLayerType::Tile)
+                ReleaseTileLayerCache(*static_cast<TileLayer*>(layer.get()));
+        }
+
         map.Layers.clear();
-        if (releaseTextures)
+        map.TileLookup.clear();
+        map.Animations.clear();
+        map.CookedData.reset();
+        map.Properties.Clear();
+        for (auto& [id, sheet] : map.TileSheets)
         {
-            for (auto& [id, sheet] : map.TileSheets)
+            ReleaseTexture(sheet.Texture, releaseTextures);
+        }
+        map.TileSheets.clear();
+    }
+
+    void BuildTileLookup(TileMap& map)
+    {
+        map.TileLookup.clear();
+
+        for (const auto& [startId, sheet] : map.TileSheets)
+        {
+            size_t end = size_t(sheet.StartingTileId) + sheet.Tiles.size();
+            if (map.TileLookup.size() < end)
+                map.TileLookup.resize(end);
+
+            for (size_t index = 0; index < sheet.Tiles.size(); index++)
             {
-                UnloadTexture(sheet.Texture);
+                TileLookupEntry& entry = map.TileLookup[sheet.StartingTileId + index];
+                entry = TileLookupEntry();
+                entry.Sheet = &sheet;
+                entry.LocalIndex = uint16_t(index);
+                entry.Source = sheet.Tiles[index];
+            }
+
+            for (const auto& [index, shapes] : sheet.CollisionShapes)
+            {
+                if (index < sheet.Tiles.size() && !shapes.empty())
+                    map.TileLookup[sheet.StartingTileId + index].CollisionShapes = &shapes;
+            }
+        }
+
+        // animated tiles start on their first frame
+        map.Animations.clear();
+        for (const auto& [startId, sheet] : map.TileSheets)
+        {
+            for (const auto& [index, animation] : sheet.Animations)
+            {
+                // a later sheet may cover the same ids
+                bool valid = index < sheet.Tiles.size() && map.TileLookup[sheet.StartingTileId + index].Sheet == &sheet && !animation.Frames.empty() && animation.Length > 0;
+                for (const auto& frame : animation.Frames)
+                    valid = valid && frame.TileIndex < sheet.Tiles.size();
+
+                if (!valid)
+                    continue;
+
+                TileLookupEntry& entry = map.TileLookup[sheet.StartingTileId + index];
+                entry.Animation = int(map.Animations.size());
+                entry.Source = sheet.Tiles[animation.Frames.front().TileIndex];
+
+                TileAnimationState& state = map.Animations.emplace_back();
+                state.TileId = uint16_t(sheet.StartingTileId + index);
+                state.Animation = &animation;
             }
         }
-        map.TileSheets.clear();
     }
 
     LayerInfo* InsertTileMapLayer(std::unique_ptr<LayerInfo> layer, TileMap& map, int beforeId)
@@ -135,6 +336,9 @@ namespace RayTiled
         {
             if (itr->get()->LayerId == layerId)
             {
+                if (itr->get()->Type == TileLayerType::Tile)
+                    ReleaseTileLayerCache(*static_cast<TileLayer*>(itr->get()));
+
                 map.Layers.erase(itr);
                 return true;
             }
@@ -174,61 +378,41 @@ namespace RayTiled
         return nullptr;
     }
 
-    size_t GetCollisions(TileMap& map, Rectangle rect, std::vector<CollisionRecord>& results)
+    void UpdateTileLayerMeshCell(const TileMap& map, TileLayer& layer, int x, int y);
+    void InvalidateTileLayerCacheCell(TileLayer& layer, int x, int y);
+    void UpdateTileLayerCollisionCell(const TileMap& map, TileLayer& layer, int x, int y);
+
+    bool SetLayerTile(const TileMap& map, TileLayer& layer, int x, int y, uint16_t tileIndex, uint8_t flags)
     {
-        results.clear();
+        if (x >= layer.Bounds.x || x < 0 || y >= layer.Bounds.y || y < 0)
+            return false;
 
-        for (auto& layer : map.Layers)
+        // tiles that live in a cooked file are read only, take a copy on the first edit
+        if (layer.ExternalTileData != nullptr)
         {
-            if (!layer->CheckForCollisions)
-                continue;
-
-            if (layer->Type == TileLayerType::Tile)
-            {
-                TileLayer* tileLayer = static_cast<TileLayer*>(layer.get());
-
-                int x = int(rect.x / tileLayer->TileSize.x);
-                int y = int(rect.y / tileLayer->TileSize.y);
-
-                int w = int((rect.x + rect.width) / tileLayer->TileSize.x);
-                int h = int((rect.y + rect.height) / tileLayer->TileSize.y);
+            layer.TileData.assign(layer.ExternalTileData, layer.ExternalTileData + size_t(layer.Bounds.x) * size_t(layer.Bounds.y));
+            layer.ExternalTileData = nullptr;
+        }
 
-                for (; y <= h; y++)
-                {
-                    for (int i = x; i <= w; i++)
-                    {
-                        uint16_t tile = 0;
-                        if (tileLayer->CellHasTile(i, y, &tile))
-                        {
-                            results.emplace_back();
-                            results.back().Type = TileLayerType::Tile;
-                            results.back().Bounds = { i * tileLayer->TileSize.x , y * tileLayer->TileSize.y, tileLayer->TileSize.x , tileLayer->TileSize.y };
-                            results.back().ItemId = tile;
-                        }
-                    }
-                }
-            }
-            else if (layer->Type == TileLayerType::Object)
-            {
-                ObjectLayer* objectLayer = static_cast<ObjectLayer*>(layer.get());
+        TileInfo* tile = layer.GetTileInfo(x, y);
+        if (tile == nullptr)
+        {
+            // clearing a cell in an empty chunk has nothing to do
+            if (tileIndex == 0)
+                return true;
 
-                for (auto& object : objectLayer->Objets)
-                {
-                    if (object->Type == ObjectLayer::ObjectType::Generic)
-                    {
-                        if (CheckCollisionRecs(rect, object->Bounds))
-                        {
-                            results.emplace_back();
-                            results.back().Type = TileLayerType::Object;
-                            results.back().Bounds = object->Bounds;
-                            results.back().ItemId = object->Id;
-                        }
-                    }
-                }
-            }
+            auto& chunk = layer.Chunks[TileLayer::GetChunkKey(x / layer.ChunkWidth, y / layer.ChunkHeight)];
+            chunk.TileData.resize(size_t(layer.ChunkWidth) * layer.ChunkHeight);
+            tile = layer.GetTileInfo(x, y);
         }
 
-        return !results.empty();
+        tile->TileIndex = tileIndex;
+        tile->TileFlags = flags;
+
+        UpdateTileLayerMeshCell(map, layer, x, y);
+        InvalidateTileLayerCacheCell(layer, x, y);
+        UpdateTileLayerCollisionCell(map, layer, x, y);
+        return true;
     }
 
     void TileLayer::AddDrawable(Drawable* item)
@@ -254,7 +438,8 @@ namespace RayTiled
 
     const TileInfo* TileLayer::GetTile(int x, int y, Rectangle& screenRect) const
     {
-        if (x > Bounds.x || x < 0 || y > Bounds.y || y < 0)
+        const TileInfo* tile = GetTileInfo(x, y);
+        if (tile == nullptr)
             return nullptr;
 
         screenRect.width = TileSize.x;
@@ -288,18 +473,156 @@ namespace RayTiled
                 break;
         }
 
-        return &TileData[y * int(Bounds.x) + x];
+        return tile;
+    }
+
+    const TileLayerChunk* TileLayer::FindChunk(int chunkX, int chunkY) const
+    {
+        auto itr = Chunks.find(GetChunkKey(chunkX, chunkY));
+        if (itr == Chunks.end())
+            return nullptr;
+
+        return &itr->second;
+    }
+
+    const TileInfo* TileLayer::GetTileInfo(int x, int y) const
+    {
+        if (x >= Bounds.x || x < 0 || y >= Bounds.y || y < 0)
+            return nullptr;
+
+        if (!Sparse)
+            return &GetTileData()[size_t(y) * int(Bounds.x) + x];
+
+        const TileLayerChunk* chunk = FindChunk(x / ChunkWidth, y / ChunkHeight);
+        if (chunk == nullptr)
+            return nullptr;
+
+        return &chunk->TileData[size_t(y % ChunkHeight) * ChunkWidth + (x % ChunkWidth)];
+    }
+
+    TileInfo* TileLayer::GetTileInfo(int x, int y)
+    {
+        return const_cast<TileInfo*>(static_cast<const TileLayer*>(this)->GetTileInfo(x, y));
+    }
+
+    // the range of whole steps k where offset + k * scale is strictly between low and high
+    static void GetStepRange(float offset, float scale, float low, float high, int& start, int& end)
+    {
+        constexpr double limit = 1 << 30;
+        start = int(std::clamp(std::floor(double(low - offset) / scale) + 1, -limit, limit));
+        end = int(std::clamp(std::ceil(double(high - offset) / scale), -limit, limit));
+    }
+
+    static int FloorDivide(int value, int divisor)
+    {
+        int result = value / divisor;
+        if ((value % divisor != 0) && ((value < 0) != (divisor < 0)))
+            result--;
+        return result;
+    }
+
+    void TileLayer::GetVisibleSpans(Rectangle view, std::vector<TileRowSpan>& spans) const
+    {
+        spans.clear();
+
+        int width = int(Bounds.x);
+        int height = int(Bounds.y);
+
+        if (width <= 0 || height <= 0 || TileSize.x <= 0 || TileSize.y <= 0)
+            return;
+
+        // a tile is visible when its screen rect starts inside these ranges
+        float lowX = view.x - TileSize.x;
+        float highX = view.x + view.width;
+        float lowY = view.y - TileSize.y;
+        float highY = view.y + view.height;
+
+        float halfWidth = TileSize.x * 0.5f;
+        float halfHeight = TileSize.y * 0.5f;
+        float quarterHeight = TileSize.y * 0.25f;
+
+        auto addSpan = [&](int y, int startX, int endX, int step, int parity)
+        {
+            startX = std::max(startX, 0);
+            endX = std::min(endX, width);
+
+            if (step == 2 && (startX & 1) != parity)
+                startX++;
+
+            if (startX < endX)
+                spans.push_back(TileRowSpan{ y, startX, endX, step });
+        };
+
+        int startX, endX, startY, endY;
+
+        switch (Orientation)
+        {
+            case TileMapOrientation::Orthogonal:
+            case TileMapOrientation::Oblique:
+            {
+                bool oblique = Orientation == TileMapOrientation::Oblique;
+                GetStepRange(0, oblique ? halfWidth : TileSize.x, lowX, highX, startX, endX);
+                GetStepRange(0, oblique ? halfHeight : TileSize.y, lowY, highY, startY, endY);
+
+                for (int y = std::max(startY, 0); y < std::min(endY, height); y++)
+                    addSpan(y, startX, endX, 1, 0);
+            }
+            break;
+
+            case TileMapOrientation::Isometric:
+            {
+                // screen x follows x - y and screen y follows x + y, so each row is the overlap of two diagonal bands
+                int startU, endU, startV, endV;
+                GetStepRange(0, halfWidth, lowX, highX, startU, endU);
+                GetStepRange(0, quarterHeight, lowY, highY, startV, endV);
+
+                startY = std::max(FloorDivide(startV - (endU - 1), 2), 0);
+                endY = std::min(FloorDivide(endV - 1 - startU, 2) + 1, height);
+
+                for (int y = startY; y < endY; y++)
+                    addSpan(y, std::max(startU + y, startV - y), std::min(endU + y, endV - y), 1, 0);
+            }
+            break;
+
+            case TileMapOrientation::Staggered:
+            case TileMapOrientation::Hexagonal:
+            {
+                // odd columns are pushed down by a quarter tile, so a row can have only its even or odd columns visible
+                float rowHeight = Orientation == TileMapOrientation::Staggered ? halfHeight : TileSize.y;
+
+                GetStepRange(0, halfWidth, lowX, highX, startX, endX);
+                GetStepRange(0, rowHeight, lowY - quarterHeight, highY, startY, endY);
+
+                for (int y = std::max(startY, 0); y < std::min(endY, height); y++)
+                {
+                    float evenY = y * rowHeight;
+                    float oddY = evenY + quarterHeight;
+
+                    bool even = evenY > lowY && evenY < highY;
+                    bool odd = oddY > lowY && oddY < highY;
+
+                    if (even && odd)
+                        addSpan(y, startX, endX, 1, 0);
+                    else if (even)
+                        addSpan(y, startX, endX, 2, 0);
+                    else if (odd)
+                        addSpan(y, startX, endX, 2, 1);
+                }
+            }
+            break;
+        }
     }
 
-    bool TileLayer::CellHasTile(int x, int y, uint16_t* result)
+    bool TileLayer::CellHasTile(int x, int y, uint16_t* result) const
     {
-        if (x > Bounds.x || x < 0 || y > Bounds.y || y < 0)
+        const TileInfo* tile = GetTileInfo(x, y);
+        if (tile == nullptr)
             return false;
 
         if (result)
-            *result = TileData[y * int(Bounds.x) + x].TileIndex;
+            *result = tile->TileIndex;
 
-        return TileData[y * int(Bounds.x) + x].TileIndex > 0;
+        return tile->TileIndex > 0;
     }
 
 }
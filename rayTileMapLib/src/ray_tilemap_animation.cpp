@@ -0,0 +1,88 @@
+/**********************************************************************************************
+*
+*   RayTileMap
+*
+*   LICENSE: MIT
+*
+*   Copyright (c) 2024 Jeffery Myers
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "ray_tilemap.h"
+
+#include <cmath>
+
+namespace RayTiled
+{
+    void UpdateTileLayerMeshAnimations(const TileMap& map, TileLayer& layer);
+    void InvalidateAnimatedCacheChunks(const TileMap& map, TileLayer& layer);
+
+    // finds the frame that is showing at a point in the loop
+    static size_t GetAnimationFrame(const TileAnimation& animation, double time)
+    {
+        float position = float(std::fmod(time, double(animation.Length)));
+        if (position < 0)
+            position += animation.Length;
+
+        size_t frame = 0;
+        while (frame + 1 < animation.Frames.size() && position >= animation.Frames[frame].Duration)
+        {
+            position -= animation.Frames[frame].Duration;
+            frame++;
+        }
+
+        return frame;
+    }
+
+    void UpdateTileAnimations(TileMap& map, double time)
+    {
+        // the timing is done once per animated tile id, not once per cell
+        bool changed = false;
+        for (auto& state : map.Animations)
+        {
+            size_t frame = GetAnimationFrame(*state.Animation, time);
+            state.Changed = frame != state.Frame;
+            if (!state.Changed)
+                continue;
+
+            state.Frame = frame;
+
+            TileLookupEntry& entry = map.TileLookup[state.TileId];
+            entry.Source = entry.Sheet->Tiles[state.Animation->Frames[frame].TileIndex];
+            changed = true;
+        }
+
+        if (!changed)
+            return;
+
+        // tiles drawn from the lookup pick up the new frame on their own, prebuilt data needs updating
+        for (auto& layer : map.Layers)
+        {
+            if (layer->Type != TileLayerType::Tile)
+                continue;
+
+            TileLayer& tileLayer = static_cast<TileLayer&>(*layer);
+            UpdateTileLayerMeshAnimations(map, tileLayer);
+            InvalidateAnimatedCacheChunks(map, tileLayer);
+        }
+    }
+}
@@ -0,0 +1,336 @@
+/**********************************************************************************************
+*
+*   RayTileMap
+*
+*   LICENSE: MIT
+*
+*   Copyright (c) 2024 Jeffery Myers
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "ray_tilemap.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace RayTiled
+{
+    std::string GetFolderPath(const std::string& filepath);
+    bool HasLoadTextureFunction(const TileMapLoadContext& context);
+    Texture2D LoadTextureFile(const TileMapLoadContext& context, const std::string& fullpath);
+    bool IsTextureCached(const std::string& fullpath);
+    bool AcquireCachedTexture(const std::string& fullpath, Texture2D& texture);
+    Texture2D AddCachedTexture(const std::string& fullpath, Texture2D texture);
+    Texture2D AcquireTexture(const TileMapLoadContext& context, const std::string& fullpath);
+
+    // a sheet texture waiting for the main thread
+    struct PendingTexture
+    {
+        uint16_t SheetId = 0;
+        std::string Path;       // the full path, the texture cache key
+        Image Data = { 0 };     // the decoded image, empty when a custom texture loader is installed or the texture was already loaded
+    };
+
+    struct TileMapLoad
+    {
+        std::string FilePath;
+        TileMapLoadContext Context;         // the loader settings, with textures deferred to the main thread
+        TileMap Map;
+
+        std::mutex Lock;                    // guards the state and the cancel flag
+        std::condition_variable Parsed;     // signaled when the loader thread is done with the load
+        TileMapLoadState State = TileMapLoadState::Loading;
+        bool Cancelled = false;
+
+        // owned by the main thread once the state is Uploading
+        std::vector<PendingTexture> Uploads;
+        size_t NextUpload = 0;
+    };
+
+    // one background thread that parses maps in the order they were requested
+    struct MapLoaderThread
+    {
+        std::thread Thread;
+        std::mutex Lock;
+        std::condition_variable WorkReady;
+        std::deque<TileMapLoadHandle> Queue;
+        bool Quit = false;
+
+        ~MapLoaderThread()
+        {
+            {
+                std::lock_guard<std::mutex> guard(Lock);
+                Quit = true;
+            }
+            WorkReady.notify_all();
+
+            if (Thread.joinable())
+                Thread.join();
+        }
+    };
+
+    static MapLoaderThread Loader;
+
+    // loads that have not been finished by the main thread, only used from the main thread
+    static std::vector<TileMapLoadHandle> ActiveLoads;
+
+    static void FreePendingImages(TileMapLoad& load)
+    {
+        for (size_t i = load.NextUpload; i < load.Uploads.size(); i++)
+        {
+            if (load.Uploads[i].Data.data != nullptr)
+                UnloadImage(load.Uploads[i].Data);
+        }
+        load.Uploads.clear();
+        load.NextUpload = 0;
+    }
+
+    static bool IsCancelled(TileMapLoad& load)
+    {
+        std::lock_guard<std::mutex> guard(load.Lock);
+        return load.Cancelled;
+    }
+
+    static void RunLoad(TileMapLoad& load)
+    {
+        bool loaded = false;
+        std::vector<PendingTexture> uploads;
+
+        if (!IsCancelled(load))
+        {
+            loaded = LoadTileMap(load.FilePath, load.Map, load.Context);
+        }
+
+        if (loaded)
+        {
+            // decode the images here so the main thread only has to upload them
+            std::string folder = GetFolderPath(load.FilePath);
+            bool decode = !HasLoadTextureFunction(load.Context);
+            for (const auto& [id, sheet] : load.Map.TileSheets)
+            {
+                if (IsCancelled(load))
+                    break;
+
+                PendingTexture& upload = uploads.emplace_back();
+                upload.SheetId = id;
+                upload.Path = folder.empty() ? sheet.TexturePath : folder + "/" + sheet.TexturePath;
+                if (decode && !(load.Context.UseTextureCache && IsTextureCached(upload.Path)))
+                    upload.Data = LoadImage(upload.Path.c_str());
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(load.Lock);
+        load.Uploads = std::move(uploads);
+        if (load.Cancelled)
+        {
+            FreePendingImages(load);
+            UnloadTileMap(load.Map, false);
+            load.State = TileMapLoadState::Cancelled;
+        }
+        else if (!loaded)
+        {
+            UnloadTileMap(load.Map, false);
+            load.State = TileMapLoadState::Failed;
+        }
+        else
+        {
+            load.State = TileMapLoadState::Uploading;
+        }
+        load.Parsed.notify_all();
+    }
+
+    static void LoaderThreadMain()
+    {
+        while (true)
+        {
+            TileMapLoadHandle load;
+            {
+                std::unique_lock<std::mutex> guard(Loader.Lock);
+                Loader.WorkReady.wait(guard, [] { return Loader.Quit || !Loader.Queue.empty(); });
+                if (Loader.Quit)
+                    return;
+
+                load = std::move(Loader.Queue.front());
+                Loader.Queue.pop_front();
+            }
+
+            RunLoad(*load);
+        }
+    }
+
+    TileMapLoadHandle LoadTileMapAsync(const std::string& filepath)
+    {
+        return LoadTileMapAsync(filepath, TileMapLoadContext());
+    }
+
+    TileMapLoadHandle LoadTileMapAsync(const std::string& filepath, const TileMapLoadContext& context)
+    {
+        TileMapLoadHandle load = std::make_shared<TileMapLoad>();
+        load->FilePath = filepath;
+        load->Context = context;
+        load->Context.DeferTextures = true;
+
+        {
+            std::lock_guard<std::mutex> guard(Loader.Lock);
+            if (!Loader.Thread.joinable())
+                Loader.Thread = std::thread(LoaderThreadMain);
+
+            Loader.Queue.push_back(load);
+        }
+        Loader.WorkReady.notify_one();
+
+        ActiveLoads.push_back(load);
+        return load;
+    }
+
+    static TileMapLoadState GetState(TileMapLoad& load)
+    {
+        std::lock_guard<std::mutex> guard(load.Lock);
+        return load.State;
+    }
+
+    static void UploadNextTexture(TileMapLoad& load)
+    {
+        PendingTexture& upload = load.Uploads[load.NextUpload++];
+
+        // another map may have loaded the same texture since the image was decoded
+        Texture2D texture = { 0 };
+        if (!load.Context.UseTextureCache)
+        {
+            if (upload.Data.data != nullptr)
+                texture = LoadTextureFromImage(upload.Data);
+            else
+                texture = LoadTextureFile(load.Context, upload.Path);
+        }
+        else if (!AcquireCachedTexture(upload.Path, texture))
+        {
+            if (upload.Data.data != nullptr)
+                texture = AddCachedTexture(upload.Path, LoadTextureFromImage(upload.Data));
+            else
+                texture = AcquireTexture(load.Context, upload.Path);
+        }
+
+        if (upload.Data.data != nullptr)
+        {
+            UnloadImage(upload.Data);
+            upload.Data = Image{ 0 };
+        }
+
+        load.Map.TileSheets[upload.SheetId].Texture = texture;
+    }
+
+    static void FinishUploads(TileMapLoad& load)
+    {
+        load.Uploads.clear();
+        load.NextUpload = 0;
+
+        std::lock_guard<std::mutex> guard(load.Lock);
+        load.State = TileMapLoadState::Done;
+    }
+
+    void UpdateTileMapLoads(float budgetSeconds)
+    {
+        double endTime = GetTime() + budgetSeconds;
+
+        for (auto& load : ActiveLoads)
+        {
+            if (GetState(*load) != TileMapLoadState::Uploading)
+                continue;
+
+            while (load->NextUpload < load->Uploads.size())
+            {
+                UploadNextTexture(*load);
+                if (GetTime() >= endTime)
+                    break;
+            }
+
+            if (load->NextUpload == load->Uploads.size())
+                FinishUploads(*load);
+
+            if (GetTime() >= endTime)
+                break;
+        }
+
+        // the handles keep finished loads alive for the game
+        std::erase_if(ActiveLoads, [](const TileMapLoadHandle& load)
+            {
+                TileMapLoadState state = GetState(*load);
+                return state != TileMapLoadState::Loading && state != TileMapLoadState::Uploading;
+            });
+    }
+
+    TileMapLoadState GetTileMapLoadState(const TileMapLoadHandle& handle)
+    {
+        if (!handle)
+            return TileMapLoadState::Failed;
+
+        return GetState(*handle);
+    }
+
+    bool WaitForTileMapLoad(const TileMapLoadHandle& handle)
+    {
+        if (!handle)
+            return false;
+
+        {
+            std::unique_lock<std::mutex> guard(handle->Lock);
+            handle->Parsed.wait(guard, [&] { return handle->State != TileMapLoadState::Loading; });
+            if (handle->State != TileMapLoadState::Uploading)
+                return handle->State == TileMapLoadState::Done;
+        }
+
+        while (handle->NextUpload < handle->Uploads.size())
+            UploadNextTexture(*handle);
+
+        FinishUploads(*handle);
+        return true;
+    }
+
+    void CancelTileMapLoad(const TileMapLoadHandle& handle)
+    {
+        if (!handle)
+            return;
+
+        std::lock_guard<std::mutex> guard(handle->Lock);
+        handle->Cancelled = true;
+
+        // the loader thread cleans up loads that are still parsing
+        if (handle->State != TileMapLoadState::Uploading && handle->State != TileMapLoadState::Done)
+            return;
+
+        FreePendingImages(*handle);
+        UnloadTileMap(handle->Map);
+        handle->State = TileMapLoadState::Cancelled;
+    }
+
+    bool TakeLoadedTileMap(const TileMapLoadHandle& handle, TileMap& map)
+    {
+        if (!handle || GetState(*handle) != TileMapLoadState::Done)
+            return false;
+
+        map = std::move(handle->Map);
+        handle->Map = TileMap();
+        return true;
+    }
+}
@@ -0,0 +1,304 @@
+/**********************************************************************************************
+*
+*   RayTileMap
+*
+*   LICENSE: MIT
+*
+*   Copyright (c) 2024 Jeffery Myers
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "ray_tilemap.h"
+
+#include "rlgl.h"
+
+#include <algorithm>
+
+namespace RayTiled
+{
+    void DrawTileBlock(const TileMap& map, TileDrawContext& context, const TileLayer* tileLayer, int startX, int startY, int endX, int endY);
+    bool GetTileViewRange(const TileLayer& tileLayer, Camera2D* camera, Vector2 bounds, std::vector<TileRowSpan>& spans, int& startX, int& startY, int& endX, int& endY);
+
+    // color plus the depth buffer that raylib creates with each render texture
+    static constexpr size_t CacheBytesPerPixel = 8;
+
+    static void UnloadChunk(TileLayerCache& cache, TileLayerCacheChunk& chunk)
+    {
+        if (chunk.Target.id == 0)
+            return;
+
+        cache.MemoryUsed -= size_t(chunk.Target.texture.width) * size_t(chunk.Target.texture.height) * CacheBytesPerPixel;
+        UnloadRenderTexture(chunk.Target);
+        chunk.Target = RenderTexture2D{ 0 };
+        chunk.Dirty = true;
+    }
+
+    void EnableTileLayerCache(TileLayer& layer, int chunkSize, size_t memoryBudget)
+    {
+        ReleaseTileLayerCache(layer);
+
+        layer.Cache = std::make_unique<TileLayerCache>();
+        TileLayerCache& cache = *layer.Cache;
+
+        cache.ChunkSize = std::max(chunkSize, 1);
+        cache.MemoryBudget = memoryBudget;
+        cache.ChunksX = (int(layer.Bounds.x) + cache.ChunkSize - 1) / cache.ChunkSize;
+        cache.ChunksY = (int(layer.Bounds.y) + cache.ChunkSize - 1) / cache.ChunkSize;
+        cache.Chunks.resize(size_t(cache.ChunksX) * size_t(cache.ChunksY));
+    }
+
+    void ReleaseTileLayerCache(TileLayer& layer)
+    {
+        if (!layer.Cache)
+            return;
+
+        for (auto& chunk : layer.Cache->Chunks)
+            UnloadChunk(*layer.Cache, chunk);
+
+        layer.Cache.reset();
+    }
+
+    void InvalidateTileLayerCacheCell(TileLayer& layer, int x, int y)
+    {
+        if (!layer.Cache)
+            return;
+
+        if (x < 0 || y < 0 || x >= int(layer.Bounds.x) || y >= int(layer.Bounds.y))
+            return;
+
+        TileLayerCache& cache = *layer.Cache;
+        cache.Chunks[(y / cache.ChunkSize) * cache.ChunksX + (x / cache.ChunkSize)].Dirty = true;
+    }
+
+    // frees the least recently seen chunk that was not visible this frame
+    static bool EvictChunk(TileLayerCache& cache)
+    {
+        TileLayerCacheChunk* oldest = nullptr;
+        for (auto& chunk : cache.Chunks)
+        {
+            if (chunk.Target.id == 0 || chunk.LastUsedFrame == cache.Frame)
+                continue;
+
+            if (oldest == nullptr || chunk.LastUsedFrame < oldest->LastUsedFrame)
+                oldest = &chunk;
+        }
+
+        if (oldest == nullptr)
+            return false;
+
+        UnloadChunk(cache, *oldest);
+        return true;
+    }
+
+    // sparse layers have nothing to render in areas that were never painted
+    static bool HasTilesInRange(const TileLayer& layer, int startX, int startY, int endX, int endY)
+    {
+        if (!layer.Sparse)
+            return true;
+
+        for (int chunkY = startY / layer.ChunkHeight; chunkY <= (endY - 1) / layer.ChunkHeight; chunkY++)
+        {
+            for (int chunkX = startX / layer.ChunkWidth; chunkX <= (endX - 1) / layer.ChunkWidth; chunkX++)
+            {
+                if (layer.FindChunk(chunkX, chunkY))
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+    // finds the animated tiles in a block of cells, so the chunk can be rendered again when they change frame
+    static void FindAnimatedTiles(const TileMap& map, const TileLayer& layer, int startX, int startY, int endX, int endY, std::vector<uint16_t>& tiles)
+    {
+        tiles.clear();
+        if (map.Animations.empty())
+            return;
+
+        for (int y = startY; y < endY; y++)
+        {
+            for (int x = startX; x < endX; x++)
+            {
+                const TileInfo* tile = layer.GetTileInfo(x, y);
+                if (tile == nullptr)
+                    continue;
+
+                const TileLookupEntry* lookup = GetTileLookup(map, tile->TileIndex);
+                if (lookup != nullptr && lookup->Animation >= 0 && std::find(tiles.begin(), tiles.end(), tile->TileIndex) == tiles.end())
+                    tiles.push_back(tile->TileIndex);
+            }
+        }
+    }
+
+    // stops trying to render a chunk that does not fit, so it is not checked against the budget every frame
+    static void MarkChunkUncacheable(TileLayerCache& cache, TileLayerCacheChunk& chunk, int chunkX, int chunkY)
+    {
+        chunk.Uncacheable = true;
+        cache.UncacheableChunks.push_back(size_t(chunkY) * size_t(cache.ChunksX) + size_t(chunkX));
+        cache.UncacheableBudget = cache.MemoryBudget;
+    }
+
+    static void ClearUncacheableChunks(TileLayerCache& cache)
+    {
+        for (size_t index : cache.UncacheableChunks)
+            cache.Chunks[index].Uncacheable = false;
+
+        cache.UncacheableChunks.clear();
+    }
+
+    static void RenderChunk(const TileMap& map, TileLayer& layer, TileLayerCacheChunk& chunk, int chunkX, int chunkY)
+    {
+        TileLayerCache& cache = *layer.Cache;
+
+        int startX = chunkX * cache.ChunkSize;
+        int startY = chunkY * cache.ChunkSize;
+        int endX = std::min(startX + cache.ChunkSize, int(layer.Bounds.x));
+        int endY = std::min(startY + cache.ChunkSize, int(layer.Bounds.y));
+
+        if (!HasTilesInRange(layer, startX, startY, endX, endY))
+        {
+            UnloadChunk(cache, chunk);
+            chunk.AnimatedTiles.clear();
+            chunk.Dirty = false;
+            return;
+        }
+
+        if (chunk.Target.id == 0)
+        {
+            int width = int((endX - startX) * layer.TileSize.x);
+            int height = int((endY - startY) * layer.TileSize.y);
+            size_t size = size_t(width) * size_t(height) * CacheBytesPerPixel;
+
+            while (cache.MemoryUsed + size > cache.MemoryBudget)
+            {
+                // everything resident is on screen, the chunk will be drawn tile by tile
+                if (!EvictChunk(cache))
+                {
+                    MarkChunkUncacheable(cache, chunk, chunkX, chunkY);
+                    return;
+                }
+            }
+
+            chunk.Target = LoadRenderTexture(width, height);
+            if (chunk.Target.id == 0)
+            {
+                MarkChunkUncacheable(cache, chunk, chunkX, chunkY);
+                return;
+            }
+
+            cache.MemoryUsed += size;
+        }
+
+        // the cache is always drawn with raylib, even when a custom backend is installed
+        TileDrawContext context;
+
+        BeginTextureMode(chunk.Target);
+        ClearBackground(BLANK);
+
+        rlPushMatrix();
+        rlTranslatef(-startX * layer.TileSize.x, -startY * layer.TileSize.y, 0);
+        DrawTileBlock(map, context, &layer, startX, startY, endX, endY);
+        rlPopMatrix();
+
+        EndTextureMode();
+
+        FindAnimatedTiles(map, layer, startX, startY, endX, endY, chunk.AnimatedTiles);
+        chunk.Dirty = false;
+    }
+
+    static void UpdateTileLayerCache(const TileMap& map, TileLayer& layer, std::vector<TileRowSpan>& spans, Camera2D* camera, Vector2 bounds)
+    {
+        TileLayerCache& cache = *layer.Cache;
+        cache.Frame++;
+
+        int startX, startY, endX, endY;
+        if (!GetTileViewRange(layer, camera, bounds, spans, startX, startY, endX, endY))
+            return;
+
+        int chunkStartX = startX / cache.ChunkSize;
+        int chunkStartY = startY / cache.ChunkSize;
+        int chunkEndX = (endX + cache.ChunkSize - 1) / cache.ChunkSize;
+        int chunkEndY = (endY + cache.ChunkSize - 1) / cache.ChunkSize;
+
+        // chunks that did not fit may fit once the budget changes or other chunks leave the view
+        int viewChunks[4] = { chunkStartX, chunkStartY, chunkEndX, chunkEndY };
+        if (!cache.UncacheableChunks.empty() && (cache.MemoryBudget != cache.UncacheableBudget || !std::equal(viewChunks, viewChunks + 4, cache.ViewChunks)))
+            ClearUncacheableChunks(cache);
+
+        std::copy(viewChunks, viewChunks + 4, cache.ViewChunks);
+
+        // mark everything visible first so that none of it is evicted to make room
+        for (int chunkY = chunkStartY; chunkY < chunkEndY; chunkY++)
+        {
+            for (int chunkX = chunkStartX; chunkX < chunkEndX; chunkX++)
+                cache.Chunks[chunkY * cache.ChunksX + chunkX].LastUsedFrame = cache.Frame;
+        }
+
+        for (int chunkY = chunkStartY; chunkY < chunkEndY; chunkY++)
+        {
+            for (int chunkX = chunkStartX; chunkX < chunkEndX; chunkX++)
+            {
+                TileLayerCacheChunk& chunk = cache.Chunks[chunkY * cache.ChunksX + chunkX];
+                if ((chunk.Dirty || chunk.Target.id == 0) && !chunk.Uncacheable)
+                    RenderChunk(map, layer, chunk, chunkX, chunkY);
+            }
+        }
+    }
+
+    void UpdateTileMapCaches(TileMap& map, Camera2D* camera, Vector2 bounds)
+    {
+        // caches are only updated on the thread that owns the GL context, reused between frames so that culling does not allocate
+        static thread_local std::vector<TileRowSpan> spans;
+
+        for (auto& layer : map.Layers)
+        {
+            if (layer->Type != TileLayerType::Tile)
+                continue;
+
+            TileLayer* tileLayer = static_cast<TileLayer*>(layer.get());
+            if (tileLayer->Cache && tileLayer->Orientation == TileMapOrientation::Orthogonal)
+                UpdateTileLayerCache(map, *tileLayer, spans, camera, bounds);
+        }
+    }
+
+    void InvalidateAnimatedCacheChunks(const TileMap& map, TileLayer& layer)
+    {
+        if (!layer.Cache)
+            return;
+
+        for (auto& chunk : layer.Cache->Chunks)
+        {
+            if (chunk.Dirty)
+                continue;
+
+            for (uint16_t id : chunk.AnimatedTiles)
+            {
+                const TileLookupEntry* lookup = GetTileLookup(map, id);
+                if (lookup != nullptr && lookup->Animation >= 0 && map.Animations[lookup->Animation].Changed)
+                {
+                    chunk.Dirty = true;
+                    break;
+                }
+            }
+        }
+    }
+}
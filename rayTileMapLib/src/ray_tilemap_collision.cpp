@@ -0,0 +1,982 @@
+/**********************************************************************************************
+*
+*   RayTileMap
+*
+*   LICENSE: MIT
+*
+*   Copyright (c) 2024 Jeffery Myers
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "ray_tilemap.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace RayTiled
+{
+    using ParallelJob = std::function<void(size_t start, size_t end)>;
+    void ParallelFor(size_t count, size_t grain, const ParallelJob& func);
+
+    static bool IsSolidTile(const TileMap& map, const TileInfo& tile)
+    {
+        return tile.TileIndex != 0 && GetTileLookup(map, tile.TileIndex) != nullptr;
+    }
+
+    static void BuildChunkSolidRows(const TileMap& map, const TileLayer& layer, TileLayerChunk& chunk)
+    {
+        chunk.SolidRows.assign(layer.ChunkHeight, 0);
+
+        for (int y = 0; y < layer.ChunkHeight; y++)
+        {
+            for (int x = 0; x < layer.ChunkWidth; x++)
+            {
+                if (IsSolidTile(map, chunk.TileData[size_t(y) * layer.ChunkWidth + x]))
+                    chunk.SolidRows[y] |= uint64_t(1) << x;
+            }
+        }
+    }
+
+    // sparse layers keep a word per chunk row, so the chunks can be at most 64 cells wide to have a mask
+    static bool CanMaskChunks(const TileLayer& layer)
+    {
+        return layer.ChunkWidth <= 64;
+    }
+
+    static void BuildCollisionMask(const TileMap& map, TileLayer& layer)
+    {
+        if (layer.Sparse)
+        {
+            if (CanMaskChunks(layer))
+            {
+                for (auto& [key, chunk] : layer.Chunks)
+                    BuildChunkSolidRows(map, layer, chunk);
+            }
+            return;
+        }
+
+        int width = int(layer.Bounds.x);
+        int height = int(layer.Bounds.y);
+
+        layer.CollisionMaskStride = (width + 63) / 64;
+        layer.CollisionMask.assign(size_t(layer.CollisionMaskStride) * size_t(height), 0);
+
+        const TileInfo* tiles = layer.GetTileData();
+        for (int y = 0; y < height; y++)
+        {
+            uint64_t* row = layer.CollisionMask.data() + size_t(y) * layer.CollisionMaskStride;
+            for (int x = 0; x < width; x++)
+            {
+                if (IsSolidTile(map, tiles[size_t(y) * width + x]))
+                    row[x / 64] |= uint64_t(1) << (x % 64);
+            }
+        }
+    }
+
+    // tiles with collision shapes are tested against their shapes instead of the whole cell
+    static bool HasCollisionShapes(const TileMap& map, uint16_t tile)
+    {
+        const TileLookupEntry* lookup = GetTileLookup(map, tile);
+        return lookup != nullptr && lookup->CollisionShapes != nullptr;
+    }
+
+    // moves a point inside a tile by the tile flips, in the same order Tiled applies them
+    static Vector2 FlipTilePoint(Vector2 point, Vector2 size, uint8_t flags)
+    {
+        if (flags & TileFlagsFlipDiagonal)
+            point = Vector2{ point.y, point.x };
+
+        if (flags & TileFlagsFlipHorizontal)
+            point.x = size.x - point.x;
+
+        if (flags & TileFlagsFlipVertical)
+            point.y = size.y - point.y;
+
+        return point;
+    }
+
+    static uint64_t GetShapeCellKey(int x, int y)
+    {
+        return (uint64_t(uint32_t(x)) << 32) | uint64_t(uint32_t(y));
+    }
+
+    // the bucket a world coordinate is in, shapes that hang off the layer go in the edge buckets
+    static int GetShapeBucket(float value, float bucketSize, int bucketCount)
+    {
+        return std::clamp(int(std::floor(value / bucketSize)), 0, bucketCount - 1);
+    }
+
+    // calls func with every bucket the bounds of a shape touch
+    template<class Func>
+    static void ForEachShapeBucket(const TileLayer& layer, TileShapeIndex& index, const Rectangle& bounds, Func&& func)
+    {
+        float bucketWidth = layer.TileSize.x * index.BucketSize;
+        float bucketHeight = layer.TileSize.y * index.BucketSize;
+
+        int startX = GetShapeBucket(bounds.x, bucketWidth, index.BucketsX);
+        int startY = GetShapeBucket(bounds.y, bucketHeight, index.BucketsY);
+        int endX = GetShapeBucket(bounds.x + bounds.width, bucketWidth, index.BucketsX);
+        int endY = GetShapeBucket(bounds.y + bounds.height, bucketHeight, index.BucketsY);
+
+        for (int y = startY; y <= endY; y++)
+        {
+            for (int x = startX; x <= endX; x++)
+                func(index.Buckets[size_t(y) * index.BucketsX + x]);
+        }
+    }
+
+    // adds the shapes of the tile in a cell to the index
+    static void AddCellShapes(const TileLayer& layer, TileShapeIndex& index, int x, int y, const TileInfo& tile, const std::vector<TileCollisionShape>& shapes)
+    {
+        if (index.Buckets.empty())
+        {
+            index.BucketsX = std::max((int(layer.Bounds.x) + index.BucketSize - 1) / index.BucketSize, 1);
+            index.BucketsY = std::max((int(layer.Bounds.y) + index.BucketSize - 1) / index.BucketSize, 1);
+            index.Buckets.resize(size_t(index.BucketsX) * size_t(index.BucketsY));
+        }
+
+        Vector2 cellOrigin = { x * layer.TileSize.x, y * layer.TileSize.y };
+        std::vector<uint32_t>& cellShapes = index.CellShapes[GetShapeCellKey(x, y)];
+
+        for (const auto& shape : shapes)
+        {
+            uint32_t shapeIndex = 0;
+            if (!index.FreeShapes.empty())
+            {
+                shapeIndex = index.FreeShapes.back();
+                index.FreeShapes.pop_back();
+            }
+            else
+            {
+                shapeIndex = uint32_t(index.Shapes.size());
+                index.Shapes.emplace_back();
+            }
+
+            TileShapeInstance& instance = index.Shapes[shapeIndex];
+            instance = TileShapeInstance();
+            instance.Type = shape.Type;
+            instance.TileId = tile.TileIndex;
+            instance.CellX = x;
+            instance.CellY = y;
+
+            Vector2 minPoint = { 0, 0 };
+            Vector2 maxPoint = { 0, 0 };
+            if (shape.Type == TileShapeType::Polygon)
+            {
+                instance.FirstPoint = uint32_t(index.Points.size());
+                instance.PointCount = uint32_t(shape.Points.size());
+
+                for (size_t i = 0; i < shape.Points.size(); i++)
+                {
+                    Vector2 local = { shape.Bounds.x + shape.Points[i].x, shape.Bounds.y + shape.Points[i].y };
+                    Vector2 point = Vector2Add(cellOrigin, FlipTilePoint(local, layer.TileSize, tile.TileFlags));
+                    index.Points.push_back(point);
+
+                    minPoint = i == 0 ? point : Vector2Min(minPoint, point);
+                    maxPoint = i == 0 ? point : Vector2Max(maxPoint, point);
+                }
+            }
+            else
+            {
+                // rectangles and ellipses stay axis aligned under every flip, so only the corners move
+                Vector2 a = FlipTilePoint(Vector2{ shape.Bounds.x, shape.Bounds.y }, layer.TileSize, tile.TileFlags);
+                Vector2 b = FlipTilePoint(Vector2{ shape.Bounds.x + shape.Bounds.width, shape.Bounds.y + shape.Bounds.height }, layer.TileSize, tile.TileFlags);
+                minPoint = Vector2Add(cellOrigin, Vector2Min(a, b));
+                maxPoint = Vector2Add(cellOrigin, Vector2Max(a, b));
+            }
+
+            instance.Bounds = { minPoint.x, minPoint.y, maxPoint.x - minPoint.x, maxPoint.y - minPoint.y };
+
+            cellShapes.push_back(shapeIndex);
+            ForEachShapeBucket(layer, index, instance.Bounds, [shapeIndex](std::vector<uint32_t>& bucket) { bucket.push_back(shapeIndex); });
+        }
+    }
+
+    // takes the shapes of a cell out of the index, their slots are reused by the next shapes added
+    static void RemoveCellShapes(const TileLayer& layer, TileShapeIndex& index, int x, int y)
+    {
+        auto itr = index.CellShapes.find(GetShapeCellKey(x, y));
+        if (itr == index.CellShapes.end())
+            return;
+
+        for (uint32_t shapeIndex : itr->second)
+        {
+            const TileShapeInstance& instance = index.Shapes[shapeIndex];
+            ForEachShapeBucket(layer, index, instance.Bounds, [shapeIndex](std::vector<uint32_t>& bucket)
+                {
+                    auto entry = std::find(bucket.begin(), bucket.end(), shapeIndex);
+                    if (entry != bucket.end())
+                        bucket.erase(entry);
+                });
+
+            index.UnusedPoints += instance.PointCount;
+            index.FreeShapes.push_back(shapeIndex);
+        }
+
+        index.CellShapes.erase(itr);
+    }
+
+    // drops the points of removed polygons, only the shapes still in the index are visited
+    static void CompactShapePoints(TileShapeIndex& index)
+    {
+        std::vector<Vector2> points;
+        points.reserve(index.Points.size() - index.UnusedPoints);
+
+        for (const auto& [key, cellShapes] : index.CellShapes)
+        {
+            for (uint32_t shapeIndex : cellShapes)
+            {
+                TileShapeInstance& instance = index.Shapes[shapeIndex];
+                if (instance.PointCount == 0)
+                    continue;
+
+                uint32_t firstPoint = uint32_t(points.size());
+                points.insert(points.end(), index.Points.begin() + instance.FirstPoint, index.Points.begin() + instance.FirstPoint + instance.PointCount);
+                instance.FirstPoint = firstPoint;
+            }
+        }
+
+        index.Points = std::move(points);
+        index.UnusedPoints = 0;
+    }
+
+    static void BuildCollisionShapes(const TileMap& map, TileLayer& layer)
+    {
+        TileShapeIndex& index = layer.CollisionShapes;
+        int bucketSize = index.BucketSize;
+        index = TileShapeIndex();
+        index.BucketSize = bucketSize;
+
+        bool hasShapes = std::any_of(map.TileSheets.begin(), map.TileSheets.end(), [](const auto& sheet) { return !sheet.second.CollisionShapes.empty(); });
+        if (!hasShapes)
+            return;
+
+        auto addCell = [&](int x, int y, const TileInfo& tile)
+            {
+                const TileLookupEntry* lookup = tile.TileIndex != 0 ? GetTileLookup(map, tile.TileIndex) : nullptr;
+                if (lookup != nullptr && lookup->CollisionShapes != nullptr)
+                    AddCellShapes(layer, index, x, y, tile, *lookup->CollisionShapes);
+            };
+
+        int width = int(layer.Bounds.x);
+        int height = int(layer.Bounds.y);
+
+        if (layer.Sparse)
+        {
+            for (auto& [key, chunk] : layer.Chunks)
+            {
+                int startX = int(uint32_t(key >> 32)) * layer.ChunkWidth;
+                int startY = int(uint32_t(key)) * layer.ChunkHeight;
+
+                for (int y = 0; y < layer.ChunkHeight; y++)
+                {
+                    for (int x = 0; x < layer.ChunkWidth; x++)
+                        addCell(startX + x, startY + y, chunk.TileData[size_t(y) * layer.ChunkWidth + x]);
+                }
+            }
+        }
+        else
+        {
+            const TileInfo* tiles = layer.GetTileData();
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                    addCell(x, y, tiles[size_t(y) * width + x]);
+            }
+        }
+    }
+
+    static bool HasTilesInRegion(const TileLayer& layer, const TileLayerMergedCollisions& merged, int regionX, int regionY)
+    {
+        int startX = regionX * merged.RegionSize;
+        int startY = regionY * merged.RegionSize;
+        int endX = std::min(startX + merged.RegionSize, int(layer.Bounds.x)) - 1;
+        int endY = std::min(startY + merged.RegionSize, int(layer.Bounds.y)) - 1;
+
+        for (int chunkY = startY / layer.ChunkHeight; chunkY <= endY / layer.ChunkHeight; chunkY++)
+        {
+            for (int chunkX = startX / layer.ChunkWidth; chunkX <= endX / layer.ChunkWidth; chunkX++)
+            {
+                if (layer.FindChunk(chunkX, chunkY))
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+    // merges the full solid cells of one region into rectangles, widest run first then as far down as the run stays solid
+    static void MergeCollisionRegion(const TileMap& map, const TileLayer& layer, TileLayerMergedCollisions& merged, int regionX, int regionY)
+    {
+        auto& rects = merged.Regions[size_t(regionY) * merged.RegionsX + regionX];
+        rects.clear();
+
+        int startX = regionX * merged.RegionSize;
+        int startY = regionY * merged.RegionSize;
+        int width = std::min(merged.RegionSize, int(layer.Bounds.x) - startX);
+        int height = std::min(merged.RegionSize, int(layer.Bounds.y) - startY);
+
+        // one bit per cell that is solid and not merged yet
+        uint64_t open[64] = { 0 };
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                const TileInfo* tile = layer.GetTileInfo(startX + x, startY + y);
+                if (tile != nullptr && IsSolidTile(map, *tile) && !HasCollisionShapes(map, tile->TileIndex))
+                    open[y] |= uint64_t(1) << x;
+            }
+        }
+
+        for (int y = 0; y < height; y++)
+        {
+            while (open[y] != 0)
+            {
+                int x = std::countr_zero(open[y]);
+                int runWidth = std::countr_one(open[y] >> x);
+                uint64_t run = (runWidth == 64 ? ~uint64_t(0) : (uint64_t(1) << runWidth) - 1) << x;
+
+                int runHeight = 1;
+                while (y + runHeight < height && (open[y + runHeight] & run) == run)
+                    runHeight++;
+
+                for (int row = y; row < y + runHeight; row++)
+                    open[row] &= ~run;
+
+                rects.push_back(TileCollisionRect{ startX + x, startY + y, runWidth, runHeight });
+            }
+        }
+    }
+
+    void EnableMergedCollisions(const TileMap& map, TileLayer& layer, int regionSize)
+    {
+        layer.MergedCollisions = std::make_unique<TileLayerMergedCollisions>();
+        TileLayerMergedCollisions& merged = *layer.MergedCollisions;
+
+        merged.RegionSize = std::clamp(regionSize, 1, 64);
+        merged.RegionsX = (int(layer.Bounds.x) + merged.RegionSize - 1) / merged.RegionSize;
+        merged.RegionsY = (int(layer.Bounds.y) + merged.RegionSize - 1) / merged.RegionSize;
+        merged.Regions.resize(size_t(merged.RegionsX) * size_t(merged.RegionsY));
+
+        for (int regionY = 0; regionY < merged.RegionsY; regionY++)
+        {
+            for (int regionX = 0; regionX < merged.RegionsX; regionX++)
+            {
+                // sparse layers have nothing to merge in chunks that were never painted
+                if (layer.Sparse && !HasTilesInRegion(layer, merged, regionX, regionY))
+                    continue;
+
+                MergeCollisionRegion(map, layer, merged, regionX, regionY);
+            }
+        }
+    }
+
+    void ReleaseMergedCollisions(TileLayer& layer)
+    {
+        layer.MergedCollisions.reset();
+    }
+
+    void SetLayerCollisions(const TileMap& map, LayerInfo& layer, bool enabled)
+    {
+        layer.CheckForCollisions = enabled;
+
+        if (layer.Type != TileLayerType::Tile)
+            return;
+
+        TileLayer& tileLayer = static_cast<TileLayer&>(layer);
+        if (enabled)
+        {
+            BuildCollisionMask(map, tileLayer);
+            BuildCollisionShapes(map, tileLayer);
+        }
+        else
+        {
+            tileLayer.CollisionShapes = TileShapeIndex();
+            tileLayer.CollisionMask.clear();
+            tileLayer.CollisionMask.shrink_to_fit();
+            tileLayer.CollisionMaskStride = 0;
+
+            for (auto& [key, chunk] : tileLayer.Chunks)
+            {
+                chunk.SolidRows.clear();
+                chunk.SolidRows.shrink_to_fit();
+            }
+        }
+    }
+
+    static void UpdateCollisionMaskCell(const TileMap& map, TileLayer& layer, int x, int y)
+    {
+        if (layer.Sparse)
+        {
+            auto itr = layer.Chunks.find(TileLayer::GetChunkKey(x / layer.ChunkWidth, y / layer.ChunkHeight));
+            if (itr == layer.Chunks.end())
+                return;
+
+            TileLayerChunk& chunk = itr->second;
+            if (chunk.SolidRows.empty())
+            {
+                // chunks painted after the mask was built get their own mask
+                if (layer.CheckForCollisions && CanMaskChunks(layer))
+                    BuildChunkSolidRows(map, layer, chunk);
+                return;
+            }
+
+            uint64_t& word = chunk.SolidRows[y % layer.ChunkHeight];
+            uint64_t bit = uint64_t(1) << (x % layer.ChunkWidth);
+
+            if (IsSolidTile(map, chunk.TileData[size_t(y % layer.ChunkHeight) * layer.ChunkWidth + (x % layer.ChunkWidth)]))
+                word |= bit;
+            else
+                word &= ~bit;
+            return;
+        }
+
+        if (layer.CollisionMask.empty())
+            return;
+
+        uint64_t& word = layer.CollisionMask[size_t(y) * layer.CollisionMaskStride + x / 64];
+        uint64_t bit = uint64_t(1) << (x % 64);
+
+        if (IsSolidTile(map, layer.GetTileData()[size_t(y) * int(layer.Bounds.x) + x]))
+            word |= bit;
+        else
+            word &= ~bit;
+    }
+
+    void UpdateTileLayerCollisionCell(const TileMap& map, TileLayer& layer, int x, int y)
+    {
+        UpdateCollisionMaskCell(map, layer, x, y);
+
+        if (layer.MergedCollisions)
+        {
+            TileLayerMergedCollisions& merged = *layer.MergedCollisions;
+            MergeCollisionRegion(map, layer, merged, x / merged.RegionSize, y / merged.RegionSize);
+        }
+
+        if (!layer.CheckForCollisions)
+            return;
+
+        // replace the shapes of this cell only
+        TileShapeIndex& index = layer.CollisionShapes;
+        RemoveCellShapes(layer, index, x, y);
+
+        const TileInfo* tile = layer.GetTileInfo(x, y);
+        const TileLookupEntry* lookup = tile != nullptr && tile->TileIndex != 0 ? GetTileLookup(map, tile->TileIndex) : nullptr;
+        if (lookup != nullptr && lookup->CollisionShapes != nullptr)
+            AddCellShapes(layer, index, x, y, *tile, *lookup->CollisionShapes);
+
+        if (index.UnusedPoints > index.Points.size() / 2)
+            CompactShapePoints(index);
+    }
+
+    // the cells a rectangle touches, edges included, clamped to the layer
+    static bool GetCellRange(const TileLayer& layer, const Rectangle& rect, int& startX, int& startY, int& endX, int& endY)
+    {
+        startX = std::max(int(std::floor(rect.x / layer.TileSize.x)), 0);
+        startY = std::max(int(std::floor(rect.y / layer.TileSize.y)), 0);
+        endX = std::min(int(std::floor((rect.x + rect.width) / layer.TileSize.x)), int(layer.Bounds.x) - 1);
+        endY = std::min(int(std::floor((rect.y + rect.height) / layer.TileSize.y)), int(layer.Bounds.y) - 1);
+
+        return startX <= endX && startY <= endY;
+    }
+
+    static CollisionRecord MakeTileRecord(const TileLayer& layer, int x, int y, uint16_t tile)
+    {
+        CollisionRecord record;
+        record.Type = TileLayerType::Tile;
+        record.Bounds = { x * layer.TileSize.x, y * layer.TileSize.y, layer.TileSize.x, layer.TileSize.y };
+        record.ItemId = tile;
+        record.CellX = x;
+        record.CellY = y;
+        record.CellWidth = 1;
+        record.CellHeight = 1;
+        return record;
+    }
+
+    // calls visit for each solid cell in the range, scanning the mask one word at a time
+    template<class Visitor>
+    static bool VisitMaskCells(const TileLayer& layer, int startX, int startY, int endX, int endY, Visitor&& visit)
+    {
+        int startWord = startX / 64;
+        int endWord = endX / 64;
+
+        uint64_t firstMask = ~uint64_t(0) << (startX % 64);
+        uint64_t lastMask = ~uint64_t(0) >> (63 - (endX % 64));
+
+        for (int y = startY; y <= endY; y++)
+        {
+            const uint64_t* row = layer.CollisionMask.data() + size_t(y) * layer.CollisionMaskStride;
+            for (int wordIndex = startWord; wordIndex <= endWord; wordIndex++)
+            {
+                uint64_t word = row[wordIndex];
+                if (wordIndex == startWord)
+                    word &= firstMask;
+                if (wordIndex == endWord)
+                    word &= lastMask;
+
+                while (word != 0)
+                {
+                    int x = wordIndex * 64 + std::countr_zero(word);
+                    word &= word - 1;
+
+                    if (!visit(x, y))
+                        return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // calls visit for each solid cell of a sparse layer in the range, row by row, skipping chunks that were never painted
+    template<class Visitor>
+    static bool VisitChunkCells(const TileMap& map, const TileLayer& layer, int startX, int startY, int endX, int endY, Visitor&& visit)
+    {
+        int startChunkX = startX / layer.ChunkWidth;
+        int endChunkX = endX / layer.ChunkWidth;
+
+        for (int y = startY; y <= endY; y++)
+        {
+            int chunkY = y / layer.ChunkHeight;
+            int localY = y % layer.ChunkHeight;
+
+            for (int chunkX = startChunkX; chunkX <= endChunkX; chunkX++)
+            {
+                const TileLayerChunk* chunk = layer.FindChunk(chunkX, chunkY);
+                if (chunk == nullptr)
+                    continue;
+
+                int chunkStartX = chunkX * layer.ChunkWidth;
+                int localStart = std::max(startX - chunkStartX, 0);
+                int localEnd = std::min(endX - chunkStartX, layer.ChunkWidth - 1);
+                const TileInfo* row = chunk->TileData.data() + size_t(localY) * layer.ChunkWidth;
+
+                if (!chunk->SolidRows.empty())
+                {
+                    uint64_t word = chunk->SolidRows[localY];
+                    word &= ~uint64_t(0) << localStart;
+                    word &= ~uint64_t(0) >> (63 - localEnd);
+
+                    while (word != 0)
+                    {
+                        int localX = std::countr_zero(word);
+                        word &= word - 1;
+
+                        if (HasCollisionShapes(map, row[localX].TileIndex))
+                            continue;
+
+                        if (!visit(MakeTileRecord(layer, chunkStartX + localX, y, row[localX].TileIndex)))
+                            return false;
+                    }
+                    continue;
+                }
+
+                for (int localX = localStart; localX <= localEnd; localX++)
+                {
+                    if (!IsSolidTile(map, row[localX]) || HasCollisionShapes(map, row[localX].TileIndex))
+                        continue;
+
+                    if (!visit(MakeTileRecord(layer, chunkStartX + localX, y, row[localX].TileIndex)))
+                        return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    static bool RectsTouch(const Rectangle& a, const Rectangle& b)
+    {
+        return a.x <= b.x + b.width && b.x <= a.x + a.width && a.y <= b.y + b.height && b.y <= a.y + a.height;
+    }
+
+    // clips a segment to a rectangle (Liang-Barsky), true if any part of it is inside
+    static bool SegmentTouchesRect(Vector2 a, Vector2 b, const Rectangle& rect)
+    {
+        float p[4] = { a.x - b.x, b.x - a.x, a.y - b.y, b.y - a.y };
+        float q[4] = { a.x - rect.x, rect.x + rect.width - a.x, a.y - rect.y, rect.y + rect.height - a.y };
+
+        float enter = 0;
+        float exit = 1;
+        for (int i = 0; i < 4; i++)
+        {
+            if (p[i] == 0)
+            {
+                if (q[i] < 0)
+                    return false;
+                continue;
+            }
+
+            float t = q[i] / p[i];
+            if (p[i] < 0)
+                enter = std::max(enter, t);
+            else
+                exit = std::min(exit, t);
+
+            if (enter > exit)
+                return false;
+        }
+
+        return true;
+    }
+
+    static bool PointInPolygon(Vector2 point, const Vector2* points, size_t count)
+    {
+        bool inside = false;
+        for (size_t i = 0, j = count - 1; i < count; j = i++)
+        {
+            if ((points[i].y > point.y) != (points[j].y > point.y) &&
+                point.x < (points[j].x - points[i].x) * (point.y - points[i].y) / (points[j].y - points[i].y) + points[i].x)
+                inside = !inside;
+        }
+
+        return inside;
+    }
+
+    // the exact test for a shape whose bounds touch the rectangle
+    static bool ShapeTouchesRect(const TileShapeIndex& index, const TileShapeInstance& shape, const Rectangle& rect)
+    {
+        switch (shape.Type)
+        {
+        case TileShapeType::Ellipse:
+        {
+            float radiusX = shape.Bounds.width * 0.5f;
+            float radiusY = shape.Bounds.height * 0.5f;
+            if (radiusX <= 0 || radiusY <= 0)
+                return true;
+
+            // the closest point of the rectangle to the center, in the space where the ellipse is a unit circle
+            Vector2 center = { shape.Bounds.x + radiusX, shape.Bounds.y + radiusY };
+            float dx = (std::clamp(center.x, rect.x, rect.x + rect.width) - center.x) / radiusX;
+            float dy = (std::clamp(center.y, rect.y, rect.y + rect.height) - center.y) / radiusY;
+            return dx * dx + dy * dy <= 1;
+        }
+        case TileShapeType::Polygon:
+        {
+            const Vector2* points = index.Points.data() + shape.FirstPoint;
+
+            // polygons can be concave, so check the edges and containment instead of separating axes
+            for (uint32_t i = 0; i < shape.PointCount; i++)
+            {
+                if (SegmentTouchesRect(points[i], points[(i + 1) % shape.PointCount], rect))
+                    return true;
+            }
+
+            return PointInPolygon(Vector2{ rect.x, rect.y }, points, shape.PointCount);
+        }
+        default:
+            return true;
+        }
+    }
+
+    // calls visit for each tile collision shape that touches the rectangle
+    template<class Visitor>
+    static bool VisitShapeCollisions(const TileLayer& layer, const Rectangle& rect, Visitor&& visit)
+    {
+        const TileShapeIndex& index = layer.CollisionShapes;
+        if (index.CellShapes.empty())
+            return true;
+
+        float bucketWidth = layer.TileSize.x * index.BucketSize;
+        float bucketHeight = layer.TileSize.y * index.BucketSize;
+
+        int startX = GetShapeBucket(rect.x, bucketWidth, index.BucketsX);
+        int startY = GetShapeBucket(rect.y, bucketHeight, index.BucketsY);
+        int endX = GetShapeBucket(rect.x + rect.width, bucketWidth, index.BucketsX);
+        int endY = GetShapeBucket(rect.y + rect.height, bucketHeight, index.BucketsY);
+
+        for (int y = startY; y <= endY; y++)
+        {
+            for (int x = startX; x <= endX; x++)
+            {
+                for (uint32_t shapeIndex : index.Buckets[size_t(y) * index.BucketsX + x])
+                {
+                    const TileShapeInstance& shape = index.Shapes[shapeIndex];
+                    if (!RectsTouch(rect, shape.Bounds))
+                        continue;
+
+                    // shapes can be in many buckets, only report them from the bucket that has the corner of the overlap
+                    if (GetShapeBucket(std::max(rect.x, shape.Bounds.x), bucketWidth, index.BucketsX) != x ||
+                        GetShapeBucket(std::max(rect.y, shape.Bounds.y), bucketHeight, index.BucketsY) != y)
+                        continue;
+
+                    if (!ShapeTouchesRect(index, shape, rect))
+                        continue;
+
+                    CollisionRecord record;
+                    record.Type = TileLayerType::Tile;
+                    record.Bounds = shape.Bounds;
+                    record.ItemId = shape.TileId;
+                    record.CellX = shape.CellX;
+                    record.CellY = shape.CellY;
+                    record.CellWidth = 1;
+                    record.CellHeight = 1;
+                    if (!visit(record))
+                        return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // calls visit for each merged rectangle that covers a cell in the range
+    template<class Visitor>
+    static bool VisitMergedRects(const TileLayer& layer, int startX, int startY, int endX, int endY, Visitor&& visit)
+    {
+        const TileLayerMergedCollisions& merged = *layer.MergedCollisions;
+
+        for (int regionY = startY / merged.RegionSize; regionY <= endY / merged.RegionSize; regionY++)
+        {
+            for (int regionX = startX / merged.RegionSize; regionX <= endX / merged.RegionSize; regionX++)
+            {
+                for (const TileCollisionRect& rect : merged.Regions[size_t(regionY) * merged.RegionsX + regionX])
+                {
+                    if (rect.X > endX || rect.X + rect.Width <= startX || rect.Y > endY || rect.Y + rect.Height <= startY)
+                        continue;
+
+                    CollisionRecord record;
+                    record.Type = TileLayerType::Tile;
+                    record.Bounds = { rect.X * layer.TileSize.x, rect.Y * layer.TileSize.y, rect.Width * layer.TileSize.x, rect.Height * layer.TileSize.y };
+                    record.ItemId = layer.GetTileInfo(rect.X, rect.Y)->TileIndex;
+                    record.CellX = rect.X;
+                    record.CellY = rect.Y;
+                    record.CellWidth = rect.Width;
+                    record.CellHeight = rect.Height;
+                    if (!visit(record))
+                        return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // calls visit with each collision record in one layer, visit returns false to stop
+    // returns false if the search was stopped
+    template<class Visitor>
+    static bool VisitLayerCollisions(const TileMap& map, const LayerInfo& layer, const Rectangle& rect, Visitor&& visit)
+    {
+        if (layer.Type == TileLayerType::Tile)
+        {
+            const TileLayer& tileLayer = static_cast<const TileLayer&>(layer);
+
+            int startX, startY, endX, endY;
+            if (!GetCellRange(tileLayer, rect, startX, startY, endX, endY))
+                return VisitShapeCollisions(tileLayer, rect, visit);
+
+            if (tileLayer.MergedCollisions)
+                return VisitMergedRects(tileLayer, startX, startY, endX, endY, visit) && VisitShapeCollisions(tileLayer, rect, visit);
+
+            if (tileLayer.Sparse)
+                return VisitChunkCells(map, tileLayer, startX, startY, endX, endY, visit) && VisitShapeCollisions(tileLayer, rect, visit);
+
+            if (!tileLayer.CollisionMask.empty())
+            {
+                bool finished = VisitMaskCells(tileLayer, startX, startY, endX, endY, [&](int x, int y)
+                    {
+                        uint16_t tile = tileLayer.GetTileData()[size_t(y) * int(tileLayer.Bounds.x) + x].TileIndex;
+                        if (HasCollisionShapes(map, tile))
+                            return true;
+
+                        return bool(visit(MakeTileRecord(tileLayer, x, y, tile)));
+                    });
+
+                return finished && VisitShapeCollisions(tileLayer, rect, visit);
+            }
+
+            // collisions were turned on without SetLayerCollisions, so check each cell
+            for (int y = startY; y <= endY; y++)
+            {
+                for (int x = startX; x <= endX; x++)
+                {
+                    uint16_t tile = 0;
+                    if (tileLayer.CellHasTile(x, y, &tile) && GetTileLookup(map, tile))
+                    {
+                        if (!visit(MakeTileRecord(tileLayer, x, y, tile)))
+                            return false;
+                    }
+                }
+            }
+        }
+        else if (layer.Type == TileLayerType::Object)
+        {
+            const ObjectLayer& objectLayer = static_cast<const ObjectLayer&>(layer);
+
+            return objectLayer.ForEachObjectInRect(rect, [&visit](const ObjectLayer::Object& object)
+                {
+                    if (object.Type != ObjectLayer::ObjectType::Generic)
+                        return true;
+
+                    CollisionRecord record;
+                    record.Type = TileLayerType::Object;
+                    record.Bounds = object.Bounds;
+                    record.ItemId = object.Id;
+                    return bool(visit(record));
+                });
+        }
+
+        return true;
+    }
+
+    // calls visit with each collision record in every collision layer, visit returns false to stop
+    template<class Visitor>
+    static void VisitCollisions(const TileMap& map, const Rectangle& rect, Visitor&& visit)
+    {
+        for (auto& layer : map.Layers)
+        {
+            if (!layer->CheckForCollisions)
+                continue;
+
+            if (!VisitLayerCollisions(map, *layer, rect, visit))
+                return;
+        }
+    }
+
+    size_t GetCollisions(const TileMap& map, Rectangle rect, std::vector<CollisionRecord>& results)
+    {
+        results.clear();
+
+        VisitCollisions(map, rect, [&results](const CollisionRecord& record)
+            {
+                results.push_back(record);
+                return true;
+            });
+
+        return results.size();
+    }
+
+    size_t GetCollisions(const TileMap& map, Rectangle rect, CollisionRecord* results, size_t capacity)
+    {
+        size_t count = 0;
+
+        VisitCollisions(map, rect, [&](const CollisionRecord& record)
+            {
+                if (count < capacity)
+                    results[count] = record;
+
+                count++;
+                return true;
+            });
+
+        return count;
+    }
+
+    size_t GetCollisions(const TileMap& map, Rectangle rect, const CollisionCallback& callback)
+    {
+        size_t count = 0;
+
+        VisitCollisions(map, rect, [&](const CollisionRecord& record)
+            {
+                count++;
+                return callback(record);
+            });
+
+        return count;
+    }
+
+    bool HasCollision(const TileMap& map, Rectangle rect)
+    {
+        bool hit = false;
+
+        VisitCollisions(map, rect, [&hit](const CollisionRecord&)
+            {
+                hit = true;
+                return false;
+            });
+
+        return hit;
+    }
+
+    // queries are split into fixed size blocks so the output order does not depend on the number of threads
+    static constexpr size_t CollisionBatchBlockSize = 256;
+
+    size_t GetCollisionsBatch(const TileMap& map, const Rectangle* rects, size_t count, CollisionBatch& batch)
+    {
+        batch.Results.clear();
+        batch.Ranges.resize(count);
+
+        // find the collision layers once for all the queries
+        batch.Layers.clear();
+        for (auto& layer : map.Layers)
+        {
+            if (layer->CheckForCollisions)
+                batch.Layers.push_back(layer.get());
+        }
+
+        size_t blockCount = (count + CollisionBatchBlockSize - 1) / CollisionBatchBlockSize;
+        if (batch.BlockResults.size() < blockCount)
+            batch.BlockResults.resize(blockCount);
+
+        ParallelFor(blockCount, 1, [&](size_t startBlock, size_t endBlock)
+            {
+                for (size_t block = startBlock; block < endBlock; block++)
+                {
+                    auto& blockResults = batch.BlockResults[block];
+                    blockResults.clear();
+
+                    size_t start = block * CollisionBatchBlockSize;
+                    size_t end = std::min(start + CollisionBatchBlockSize, count);
+
+                    for (size_t query = start; query < end; query++)
+                    {
+                        // ranges start relative to the block and are moved once the block offsets are known
+                        batch.Ranges[query].Start = blockResults.size();
+
+                        for (const LayerInfo* layer : batch.Layers)
+                        {
+                            VisitLayerCollisions(map, *layer, rects[query], [&blockResults](const CollisionRecord& record)
+                                {
+                                    blockResults.push_back(record);
+                                    return true;
+                                });
+                        }
+
+                        batch.Ranges[query].Count = blockResults.size() - batch.Ranges[query].Start;
+                    }
+                }
+            });
+
+        size_t total = 0;
+        for (size_t block = 0; block < blockCount; block++)
+            total += batch.BlockResults[block].size();
+
+        batch.Results.resize(total);
+
+        size_t offset = 0;
+        for (size_t block = 0; block < blockCount; block++)
+        {
+            auto& blockResults = batch.BlockResults[block];
+            std::copy(blockResults.begin(), blockResults.end(), batch.Results.begin() + offset);
+
+            size_t start = block * CollisionBatchBlockSize;
+            size_t end = std::min(start + CollisionBatchBlockSize, count);
+            for (size_t query = start; query < end; query++)
+                batch.Ranges[query].Start += offset;
+
+            offset += blockResults.size();
+        }
+
+        return total;
+    }
+}
@@ -0,0 +1,584 @@
+/**********************************************************************************************
+*
+*   RayTileMap
+*
+*   LICENSE: MIT
+*
+*   Copyright (c) 2024 Jeffery Myers
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "ray_tilemap.h"
+#include "external/ZSTD/zstd.h"
+
+#include <array>
+#include <cstring>
+
+// decoders for the base64 and compressed layer data that Tiled can save
+namespace RayTiled
+{
+    static int8_t GetBase64Value(char c)
+    {
+        if (c >= 'A' && c <= 'Z')
+            return int8_t(c - 'A');
+        if (c >= 'a' && c <= 'z')
+            return int8_t(c - 'a' + 26);
+        if (c >= '0' && c <= '9')
+            return int8_t(c - '0' + 52);
+        if (c == '+')
+            return 62;
+        if (c == '/')
+            return 63;
+
+        return -1;
+    }
+
+    // decodes base64 text into a buffer, skipping any whitespace
+    // returns false if the text is not valid or does not fit in the buffer
+    bool DecodeBase64(const char* text, uint8_t* output, size_t outputSize, size_t& written)
+    {
+        written = 0;
+        if (text == nullptr)
+            return false;
+
+        uint32_t value = 0;
+        int valueBits = 0;
+
+        for (const char* pos = text; *pos != '\0'; pos++)
+        {
+            char c = *pos;
+            if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+                continue;
+
+            if (c == '=')
+                break;
+
+            int8_t digit = GetBase64Value(c);
+            if (digit < 0)
+                return false;
+
+            value = (value << 6) | uint32_t(digit);
+            valueBits += 6;
+
+            if (valueBits >= 8)
+            {
+                valueBits -= 8;
+                if (written >= outputSize)
+                    return false;
+
+                output[written++] = uint8_t(value >> valueBits);
+            }
+        }
+
+        return true;
+    }
+
+    // the largest number of bytes some base64 text can decode to
+    size_t GetBase64DecodedSize(const char* text)
+    {
+        return text ? (strlen(text) / 4 + 1) * 3 : 0;
+    }
+
+    // deflate decoder (RFC 1951), with a lookup table for the short codes
+    static constexpr int HuffmanFastBits = 10;
+    static constexpr int HuffmanMaxBits = 15;
+
+    struct HuffmanTable
+    {
+        uint16_t Fast[1 << HuffmanFastBits] = { 0 };    // (code length << 9) | symbol, for codes up to HuffmanFastBits long
+        uint16_t Counts[HuffmanMaxBits + 1] = { 0 };    // the number of codes of each length
+        uint16_t Symbols[288] = { 0 };                  // the symbols in canonical code order
+    };
+
+    struct InflateState
+    {
+        const uint8_t* Input = nullptr;
+        size_t InputSize = 0;
+        size_t InputPos = 0;
+
+        uint64_t BitBuffer = 0;
+        int BitCount = 0;
+
+        uint8_t* Output = nullptr;
+        size_t OutputSize = 0;
+        size_t OutputPos = 0;
+
+        bool Error = false;
+    };
+
+    static void RefillBits(InflateState& state)
+    {
+        while (state.BitCount <= 56 && state.InputPos < state.InputSize)
+        {
+            state.BitBuffer |= uint64_t(state.Input[state.InputPos++]) << state.BitCount;
+            state.BitCount += 8;
+        }
+    }
+
+    static uint32_t ReadBits(InflateState& state, int count)
+    {
+        if (count == 0)
+            return 0;
+
+        if (state.BitCount < count)
+        {
+            RefillBits(state);
+            if (state.BitCount < count)
+            {
+                state.Error = true;
+                return 0;
+            }
+        }
+
+        uint32_t value = uint32_t(state.BitBuffer & ((uint64_t(1) << count) - 1));
+        state.BitBuffer >>= count;
+        state.BitCount -= count;
+        return value;
+    }
+
+    static bool BuildHuffmanTable(HuffmanTable& table, const uint8_t* lengths, int count)
+    {
+        table = HuffmanTable();
+
+        for (int symbol = 0; symbol < count; symbol++)
+            table.Counts[lengths[symbol]]++;
+        table.Counts[0] = 0;
+
+        // reject over subscribed codes, incomplete codes are allowed
+        int left = 1;
+        for (int length = 1; length <= HuffmanMaxBits; length++)
+        {
+            left = (left << 1) - table.Counts[length];
+            if (left < 0)
+                return false;
+        }
+
+        uint16_t offsets[HuffmanMaxBits + 2] = { 0 };
+        for (int length = 1; length <= HuffmanMaxBits; length++)
+            offsets[length + 1] = offsets[length] + table.Counts[length];
+
+        for (int symbol = 0; symbol < count; symbol++)
+        {
+            if (lengths[symbol] != 0)
+                table.Symbols[offsets[lengths[symbol]]++] = uint16_t(symbol);
+        }
+
+        // fill the fast table with the bit reversed codes, since deflate stores codes starting at the high bit
+        uint32_t code = 0;
+        int index = 0;
+        for (int length = 1; length <= HuffmanMaxBits; length++)
+        {
+            for (int i = 0; i < table.Counts[length]; i++, index++, code++)
+            {
+                if (length > HuffmanFastBits)
+                    continue;
+
+                uint32_t reversed = 0;
+                for (int bit = 0; bit < length; bit++)
+                    reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+
+                for (uint32_t slot = reversed; slot < (1u << HuffmanFastBits); slot += (1u << length))
+                    table.Fast[slot] = uint16_t((length << 9) | table.Symbols[index]);
+            }
+            code <<= 1;
+        }
+
+        return true;
+    }
+
+    static int DecodeSymbol(InflateState& state, const HuffmanTable& table)
+    {
+        if (state.BitCount < HuffmanMaxBits)
+            RefillBits(state);
+
+        uint16_t entry = table.Fast[state.BitBuffer & ((1u << HuffmanFastBits) - 1)];
+        int length = entry >> 9;
+        if (entry != 0 && length <= state.BitCount)
+        {
+            state.BitBuffer >>= length;
+            state.BitCount -= length;
+            return entry & 0x1FF;
+        }
+
+        // long codes are decoded one bit at a time
+        int code = 0;
+        int first = 0;
+        int index = 0;
+        for (length = 1; length <= HuffmanMaxBits; length++)
+        {
+            code |= int(ReadBits(state, 1));
+            if (state.Error)
+                return -1;
+
+            int count = table.Counts[length];
+            if (code - first < count)
+                return table.Symbols[index + code - first];
+
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+
+        state.Error = true;
+        return -1;
+    }
+
+    static constexpr uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static constexpr uint8_t LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static constexpr uint16_t DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static constexpr uint8_t DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    static bool InflateCodes(InflateState& state, const HuffmanTable& literals, const HuffmanTable& distances)
+    {
+        while (true)
+        {
+            int symbol = DecodeSymbol(state, literals);
+            if (symbol < 0)
+                return false;
+
+            if (symbol < 256)
+            {
+                if (state.OutputPos >= state.OutputSize)
+                    return false;
+
+                state.Output[state.OutputPos++] = uint8_t(symbol);
+                continue;
+            }
+
+            if (symbol == 256)
+                return true;
+
+            symbol -= 257;
+            if (symbol >= 29)
+                return false;
+
+            size_t length = LengthBase[symbol] + ReadBits(state, LengthExtra[symbol]);
+
+            int distanceSymbol = DecodeSymbol(state, distances);
+            if (distanceSymbol < 0 || distanceSymbol >= 30)
+                return false;
+
+            size_t distance = DistanceBase[distanceSymbol] + ReadBits(state, DistanceExtra[distanceSymbol]);
+            if (state.Error || distance > state.OutputPos || length > state.OutputSize - state.OutputPos)
+                return false;
+
+            // the copy can overlap itself, so go one byte at a time
+            uint8_t* dest = state.Output + state.OutputPos;
+            const uint8_t* source = dest - distance;
+            for (size_t i = 0; i < length; i++)
+                dest[i] = source[i];
+
+            state.OutputPos += length;
+        }
+    }
+
+    static bool InflateStored(InflateState& state)
+    {
+        // stored blocks start on a byte boundary
+        ReadBits(state, state.BitCount % 8);
+
+        uint32_t length = ReadBits(state, 16);
+        uint32_t inverse = ReadBits(state, 16);
+        if (state.Error || length != (~inverse & 0xFFFF))
+            return false;
+
+        if (length > state.OutputSize - state.OutputPos)
+            return false;
+
+        // drain whatever is left in the bit buffer first
+        while (length > 0 && state.BitCount >= 8)
+        {
+            state.Output[state.OutputPos++] = uint8_t(ReadBits(state, 8));
+            length--;
+        }
+
+        if (length > state.InputSize - state.InputPos)
+            return false;
+
+        memcpy(state.Output + state.OutputPos, state.Input + state.InputPos, length);
+        state.OutputPos += length;
+        state.InputPos += length;
+        return true;
+    }
+
+    static bool InflateFixed(InflateState& state)
+    {
+        static HuffmanTable literals;
+        static HuffmanTable distances;
+        static bool built = [] ()
+            {
+                uint8_t lengths[288];
+                for (int i = 0; i < 288; i++)
+                    lengths[i] = i < 144 ? 8 : (i < 256 ? 9 : (i < 280 ? 7 : 8));
+                BuildHuffmanTable(literals, lengths, 288);
+
+                for (int i = 0; i < 30; i++)
+                    lengths[i] = 5;
+                BuildHuffmanTable(distances, lengths, 30);
+                return true;
+            }();
+
+        return built && InflateCodes(state, literals, distances);
+    }
+
+    static bool InflateDynamic(InflateState& state)
+    {
+        static constexpr uint8_t CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+        int literalCount = int(ReadBits(state, 5)) + 257;
+        int distanceCount = int(ReadBits(state, 5)) + 1;
+        int codeLengthCount = int(ReadBits(state, 4)) + 4;
+        if (state.Error || literalCount > 286 || distanceCount > 30)
+            return false;
+
+        uint8_t lengths[286 + 30] = { 0 };
+        for (int i = 0; i < codeLengthCount; i++)
+            lengths[CodeLengthOrder[i]] = uint8_t(ReadBits(state, 3));
+
+        HuffmanTable codeLengths;
+        if (state.Error || !BuildHuffmanTable(codeLengths, lengths, 19))
+            return false;
+
+        memset(lengths, 0, sizeof(lengths));
+
+        int index = 0;
+        while (index < literalCount + distanceCount)
+        {
+            int symbol = DecodeSymbol(state, codeLengths);
+            if (symbol < 0)
+                return false;
+
+            if (symbol < 16)
+            {
+                lengths[index++] = uint8_t(symbol);
+                continue;
+            }
+
+            uint8_t value = 0;
+            int repeat = 0;
+            if (symbol == 16)
+            {
+                if (index == 0)
+                    return false;
+
+                value = lengths[index - 1];
+                repeat = 3 + int(ReadBits(state, 2));
+            }
+            else if (symbol == 17)
+            {
+                repeat = 3 + int(ReadBits(state, 3));
+            }
+            else
+            {
+                repeat = 11 + int(ReadBits(state, 7));
+            }
+
+            if (state.Error || index + repeat > literalCount + distanceCount)
+                return false;
+
+            while (repeat-- > 0)
+                lengths[index++] = value;
+        }
+
+        // a block has to have an end code
+        if (lengths[256] == 0)
+            return false;
+
+        HuffmanTable literals;
+        HuffmanTable distances;
+        if (!BuildHuffmanTable(literals, lengths, literalCount) || !BuildHuffmanTable(distances, lengths + literalCount, distanceCount))
+            return false;
+
+        return InflateCodes(state, literals, distances);
+    }
+
+    static bool InflateBlocks(InflateState& state)
+    {
+        bool lastBlock = false;
+        while (!lastBlock)
+        {
+            lastBlock = ReadBits(state, 1) != 0;
+            uint32_t type = ReadBits(state, 2);
+            if (state.Error)
+                return false;
+
+            bool ok = false;
+            if (type == 0)
+                ok = InflateStored(state);
+            else if (type == 1)
+                ok = InflateFixed(state);
+            else if (type == 2)
+                ok = InflateDynamic(state);
+
+            if (!ok || state.Error)
+                return false;
+        }
+
+        // give back any whole bytes that were read ahead, so the caller can find the trailer
+        state.InputPos -= state.BitCount / 8;
+        state.BitCount = 0;
+        state.BitBuffer = 0;
+        return true;
+    }
+
+    static uint32_t ReadBigEndian32(const uint8_t* data)
+    {
+        return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | uint32_t(data[3]);
+    }
+
+    static uint32_t ReadLittleEndian32(const uint8_t* data)
+    {
+        return uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+    }
+
+    static uint32_t GetAdler32(const uint8_t* data, size_t size)
+    {
+        uint32_t a = 1;
+        uint32_t b = 0;
+
+        while (size > 0)
+        {
+            // the sums can not overflow for this many bytes before they are reduced
+            size_t block = size < 5552 ? size : 5552;
+            size -= block;
+
+            while (block-- > 0)
+            {
+                a += *data++;
+                b += a;
+            }
+
+            a %= 65521;
+            b %= 65521;
+        }
+
+        return (b << 16) | a;
+    }
+
+    // the CRC-32 used by gzip (reflected polynomial 0xEDB88320), one table lookup per byte
+    static uint32_t GetCrc32(const uint8_t* data, size_t size)
+    {
+        static const std::array<uint32_t, 256> table = [] ()
+            {
+                std::array<uint32_t, 256> values = {};
+                for (uint32_t i = 0; i < 256; i++)
+                {
+                    uint32_t value = i;
+                    for (int bit = 0; bit < 8; bit++)
+                        value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+                    values[i] = value;
+                }
+                return values;
+            }();
+
+        uint32_t crc = 0xFFFFFFFFu;
+        while (size-- > 0)
+            crc = table[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+
+        return crc ^ 0xFFFFFFFFu;
+    }
+
+    // decompresses zlib (RFC 1950) or gzip (RFC 1952) data into a buffer
+    // returns false if the data is not valid or does not fit in the buffer
+    bool InflateData(const uint8_t* data, size_t size, bool gzip, uint8_t* output, size_t outputSize, size_t& written)
+    {
+        written = 0;
+
+        InflateState state;
+        state.Input = data;
+        state.InputSize = size;
+        state.Output = output;
+        state.OutputSize = outputSize;
+
+        if (gzip)
+        {
+            if (size < 18 || data[0] != 0x1F || data[1] != 0x8B || data[2] != 8)
+                return false;
+
+            uint8_t flags = data[3];
+            size_t pos = 10;
+
+            if (flags & 0x04) // extra field
+            {
+                if (pos + 2 > size)
+                    return false;
+                pos += 2 + (size_t(data[pos]) | (size_t(data[pos + 1]) << 8));
+            }
+
+            for (uint8_t stringFlag : { uint8_t(0x08), uint8_t(0x10) }) // file name and comment
+            {
+                if ((flags & stringFlag) == 0)
+                    continue;
+
+                while (pos < size && data[pos] != 0)
+                    pos++;
+                pos++;
+            }
+
+            if (flags & 0x02) // header crc
+                pos += 2;
+
+            if (pos >= size)
+                return false;
+
+            state.InputPos = pos;
+            if (!InflateBlocks(state) || state.InputPos + 8 > size)
+                return false;
+
+            // the trailer has the crc and the uncompressed size, mod 2^32
+            if (ReadLittleEndian32(data + state.InputPos + 4) != uint32_t(state.OutputPos))
+                return false;
+
+            if (ReadLittleEndian32(data + state.InputPos) != GetCrc32(output, state.OutputPos))
+                return false;
+        }
+        else
+        {
+            if (size < 6 || (data[0] & 0x0F) != 8 || ((uint32_t(data[0]) << 8) | data[1]) % 31 != 0 || (data[1] & 0x20) != 0)
+                return false;
+
+            state.InputPos = 2;
+            if (!InflateBlocks(state) || state.InputPos + 4 > size)
+                return false;
+
+            if (ReadBigEndian32(data + state.InputPos) != GetAdler32(output, state.OutputPos))
+                return false;
+        }
+
+        written = state.OutputPos;
+        return true;
+    }
+
+    // decompresses a zstd frame into a buffer
+    // returns false if the data is not valid or does not fit in the buffer
+    bool ZstdDecompressData(const uint8_t* data, size_t size, uint8_t* output, size_t outputSize, size_t& written)
+    {
+        written = 0;
+
+        size_t result = ZSTD_decompress(output, outputSize, data, size);
+        if (ZSTD_isError(result))
+            return false;
+
+        written = result;
+        return true;
+    }
+}
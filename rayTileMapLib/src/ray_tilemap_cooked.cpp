@@ -0,0 +1,599 @@
+/**********************************************************************************************
+*
+*   RayTileMap
+*
+*   LICENSE: MIT
+*
+*   Copyright (c) 2024 Jeffery Myers
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "ray_tilemap.h"
+
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// cooked maps are a flat little endian dump of a loaded map
+// tile data is aligned in the file so dense layers can point straight into the mapped file instead of copying it
+
+namespace RayTiled
+{
+    Texture2D GetTexture(const TileMapLoadContext& context, const std::string& fileName);
+    const void* MapFileReadOnly(const char* fileName, size_t& size);
+    void UnmapFile(const void* data, size_t size);
+
+    static_assert(std::endian::native == std::endian::little, "cooked maps are stored little endian");
+    static_assert(sizeof(TileInfo) == 4 && sizeof(Vector2) == 8 && sizeof(Rectangle) == 16, "cooked maps store these structures directly");
+
+    static constexpr char CookedMagic[4] = { 'R', 'T', 'M', 'C' };
+    static constexpr uint32_t CookedVersion = 4;
+    static constexpr size_t CookedAlignment = 16;
+
+    struct CookedWriter
+    {
+        std::vector<uint8_t> Buffer;
+
+        void WriteBytes(const void* data, size_t size)
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            Buffer.insert(Buffer.end(), bytes, bytes + size);
+        }
+
+        template<class T>
+        void Write(const T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            WriteBytes(&value, sizeof(T));
+        }
+
+        void WriteString(const std::string& value)
+        {
+            Write(uint32_t(value.size()));
+            WriteBytes(value.data(), value.size());
+        }
+
+        void Align()
+        {
+            Buffer.resize((Buffer.size() + CookedAlignment - 1) / CookedAlignment * CookedAlignment, 0);
+        }
+
+        // arrays are aligned so they can be used in place
+        template<class T>
+        void WriteArray(const T* data, size_t count)
+        {
+            Write(uint64_t(count));
+            Align();
+            WriteBytes(data, count * sizeof(T));
+        }
+    };
+
+    struct CookedReader
+    {
+        const uint8_t* Data = nullptr;
+        size_t Size = 0;
+        size_t Offset = 0;
+        bool Failed = false;
+
+        const uint8_t* ReadBytes(size_t size)
+        {
+            if (Failed || size > Size - Offset)
+            {
+                Failed = true;
+                return nullptr;
+            }
+
+            const uint8_t* bytes = Data + Offset;
+            Offset += size;
+            return bytes;
+        }
+
+        template<class T>
+        T Read()
+        {
+            T value = {};
+            const uint8_t* bytes = ReadBytes(sizeof(T));
+            if (bytes != nullptr)
+                memcpy(&value, bytes, sizeof(T));
+            return value;
+        }
+
+        std::string ReadString()
+        {
+            uint32_t size = Read<uint32_t>();
+            const uint8_t* bytes = ReadBytes(size);
+            if (bytes == nullptr)
+                return std::string();
+
+            return std::string(reinterpret_cast<const char*>(bytes), size);
+        }
+
+        void Align()
+        {
+            size_t aligned = (Offset + CookedAlignment - 1) / CookedAlignment * CookedAlignment;
+            ReadBytes(aligned - Offset);
+        }
+
+        // returns a pointer into the file, the file base is page aligned so the data is aligned for T
+        template<class T>
+        const T* ReadArray(size_t& count)
+        {
+            uint64_t size = Read<uint64_t>();
+            Align();
+            if (Failed || size > (Size - Offset) / sizeof(T))
+            {
+                Failed = true;
+                count = 0;
+                return nullptr;
+            }
+
+            count = size_t(size);
+            return reinterpret_cast<const T*>(ReadBytes(count * sizeof(T)));
+        }
+
+        template<class T>
+        void ReadVector(std::vector<T>& values)
+        {
+            size_t count = 0;
+            const T* data = ReadArray<T>(count);
+            if (data != nullptr)
+                values.assign(data, data + count);
+        }
+    };
+
+    static void WriteLayerInfo(CookedWriter& writer, const LayerInfo& layer)
+    {
+        writer.Write(uint32_t(layer.Type));
+        writer.WriteString(layer.Name);
+        writer.Write(int32_t(layer.LayerId));
+        writer.Write(uint8_t(layer.Visible));
+        writer.Write(uint8_t(layer.CheckForCollisions));
+    }
+
+    static void WriteTileLayer(CookedWriter& writer, const TileLayer& layer)
+    {
+        writer.Write(layer.Bounds);
+        writer.Write(layer.TileSize);
+        writer.Write(uint32_t(layer.Orientation));
+        writer.Write(uint8_t(layer.Sparse));
+
+        if (!layer.Sparse)
+        {
+            writer.WriteArray(layer.GetTileData(), size_t(layer.Bounds.x) * size_t(layer.Bounds.y));
+            return;
+        }
+
+        writer.Write(int32_t(layer.ChunkWidth));
+        writer.Write(int32_t(layer.ChunkHeight));
+        writer.Write(uint32_t(layer.Chunks.size()));
+        for (const auto& [key, chunk] : layer.Chunks)
+        {
+            writer.Write(key);
+            writer.WriteArray(chunk.TileData.data(), chunk.TileData.size());
+        }
+    }
+
+    static void WriteObjectLayer(CookedWriter& writer, const ObjectLayer& layer)
+    {
+        writer.Write(layer.Grid.CellSize);
+        writer.Write(uint32_t(layer.Objets.size()));
+        for (const auto& object : layer.Objets)
+        {
+            writer.Write(uint32_t(object->Type));
+            writer.Write(object->Id);
+            writer.Write(object->Bounds);
+            writer.Write(object->Rotation);
+            writer.Write(uint8_t(object->Visible));
+            writer.Write(object->TileID);
+            writer.WriteString(object->Name);
+            writer.WriteString(object->ClassName);
+            writer.WriteString(object->TemplateName);
+
+            if (object->Type == ObjectLayer::ObjectType::Polygon)
+            {
+                const auto& points = static_cast<const ObjectLayer::PolygonObject&>(*object).Points;
+                writer.WriteArray(points.data(), points.size());
+            }
+            else if (object->Type == ObjectLayer::ObjectType::Text)
+            {
+                const auto& text = static_cast<const ObjectLayer::TextObject&>(*object);
+                writer.WriteString(text.Text);
+                writer.Write(text.FontSize);
+            }
+        }
+    }
+
+    // keys are only valid for one run of the program, so the file stores the names and properties refer to them by index
+    static void WriteProperties(CookedWriter& writer, const PropertyStore& store)
+    {
+        std::vector<PropertyKey> keys;
+        std::unordered_map<PropertyKey, uint32_t> keyIndices;
+        for (const Property& property : store.Properties)
+        {
+            if (keyIndices.try_emplace(property.Key, uint32_t(keys.size())).second)
+                keys.push_back(property.Key);
+        }
+
+        writer.Write(uint32_t(keys.size()));
+        for (PropertyKey key : keys)
+            writer.WriteString(GetPropertyName(key));
+
+        // written field by field so padding never reaches the file
+        writer.Write(uint32_t(store.Properties.size()));
+        for (const Property& property : store.Properties)
+        {
+            writer.Write(property.Owner);
+            writer.Write(keyIndices[property.Key]);
+            writer.Write(uint8_t(property.Type));
+            writer.Write(property.IntValue);
+            writer.Write(property.FloatValue);
+            writer.Write(property.ColorValue);
+            writer.Write(property.TextOffset);
+        }
+
+        writer.WriteArray(store.Text.data(), store.Text.size());
+    }
+
+    bool SaveCookedTileMap(const TileMap& map, const std::string& filepath)
+    {
+        CookedWriter writer;
+        writer.WriteBytes(CookedMagic, sizeof(CookedMagic));
+        writer.Write(CookedVersion);
+
+        writer.Write(uint32_t(map.Orientation));
+        writer.Write(map.TileRenderOrder);
+        writer.Write(uint8_t(map.Infinite));
+        writer.Write(map.Origin);
+
+        writer.Write(uint32_t(map.TileSheets.size()));
+        for (const auto& [startId, sheet] : map.TileSheets)
+        {
+            writer.Write(sheet.StartingTileId);
+            writer.WriteString(sheet.TexturePath);
+            writer.WriteArray(sheet.Tiles.data(), sheet.Tiles.size());
+
+            writer.Write(uint32_t(sheet.Animations.size()));
+            for (const auto& [index, animation] : sheet.Animations)
+            {
+                writer.Write(index);
+                writer.Write(uint32_t(animation.Frames.size()));
+                for (const auto& frame : animation.Frames)
+                {
+                    writer.Write(frame.TileIndex);
+                    writer.Write(frame.Duration);
+                }
+            }
+
+            writer.Write(uint32_t(sheet.CollisionShapes.size()));
+            for (const auto& [index, shapes] : sheet.CollisionShapes)
+            {
+                writer.Write(index);
+                writer.Write(uint32_t(shapes.size()));
+                for (const auto& shape : shapes)
+                {
+                    writer.Write(uint8_t(shape.Type));
+                    writer.Write(shape.Bounds);
+                    writer.WriteArray(shape.Points.data(), shape.Points.size());
+                }
+            }
+        }
+
+        uint32_t layerCount = 0;
+        for (const auto& layer : map.Layers)
+        {
+            if (layer->Type != TileLayerType::User)
+                layerCount++;
+        }
+
+        writer.Write(layerCount);
+        for (const auto& layer : map.Layers)
+        {
+            if (layer->Type == TileLayerType::User)
+                continue;
+
+            WriteLayerInfo(writer, *layer);
+            if (layer->Type == TileLayerType::Tile)
+                WriteTileLayer(writer, static_cast<const TileLayer&>(*layer));
+            else
+                WriteObjectLayer(writer, static_cast<const ObjectLayer&>(*layer));
+        }
+
+        WriteProperties(writer, map.Properties);
+
+        return SaveFileData(filepath.c_str(), writer.Buffer.data(), int(writer.Buffer.size()));
+    }
+
+    bool IsCookedTileMapFile(const std::string& filepath)
+    {
+        FILE* file = fopen(filepath.c_str(), "rb");
+        if (file == nullptr)
+            return false;
+
+        char magic[sizeof(CookedMagic)] = { 0 };
+        bool cooked = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, CookedMagic, sizeof(magic)) == 0;
+        fclose(file);
+        return cooked;
+    }
+
+    // a layer size must be a whole number of cells that fits in an int, anything else is a damaged file
+    static bool IsValidLayerSize(float cells)
+    {
+        return cells >= 0 && cells < 2147483648.0f && cells == std::floor(cells);
+    }
+
+    static bool ReadTileLayer(CookedReader& reader, TileLayer& layer)
+    {
+        layer.Bounds = reader.Read<Vector2>();
+        layer.TileSize = reader.Read<Vector2>();
+        layer.Orientation = TileMapOrientation(reader.Read<uint32_t>());
+        layer.Sparse = reader.Read<uint8_t>() != 0;
+
+        if (reader.Failed || !IsValidLayerSize(layer.Bounds.x) || !IsValidLayerSize(layer.Bounds.y))
+            return false;
+
+        if (!layer.Sparse)
+        {
+            size_t count = 0;
+            layer.ExternalTileData = reader.ReadArray<TileInfo>(count);
+            return !reader.Failed && count == size_t(layer.Bounds.x) * size_t(layer.Bounds.y);
+        }
+
+        // chunks are small and only exist where there are tiles, so they are copied
+        layer.ChunkWidth = reader.Read<int32_t>();
+        layer.ChunkHeight = reader.Read<int32_t>();
+        if (layer.ChunkWidth <= 0 || layer.ChunkHeight <= 0)
+            return false;
+
+        uint32_t chunkCount = reader.Read<uint32_t>();
+        for (uint32_t i = 0; i < chunkCount && !reader.Failed; i++)
+        {
+            uint64_t key = reader.Read<uint64_t>();
+            auto& chunk = layer.Chunks[key];
+            reader.ReadVector(chunk.TileData);
+            if (chunk.TileData.size() != size_t(layer.ChunkWidth) * size_t(layer.ChunkHeight))
+                return false;
+        }
+
+        return !reader.Failed;
+    }
+
+    static bool ReadObjectLayer(CookedReader& reader, ObjectLayer& layer)
+    {
+        float cellSize = reader.Read<float>();
+        uint32_t objectCount = reader.Read<uint32_t>();
+        for (uint32_t i = 0; i < objectCount && !reader.Failed; i++)
+        {
+            auto type = ObjectLayer::ObjectType(reader.Read<uint32_t>());
+
+            std::unique_ptr<ObjectLayer::Object> object;
+            if (type == ObjectLayer::ObjectType::Polygon)
+                object = std::make_unique<ObjectLayer::PolygonObject>();
+            else if (type == ObjectLayer::ObjectType::Text)
+                object = std::make_unique<ObjectLayer::TextObject>();
+            else
+                object = std::make_unique<ObjectLayer::Object>();
+
+            object->Type = type;
+            object->Id = reader.Read<int32_t>();
+            object->Bounds = reader.Read<Rectangle>();
+            object->Rotation = reader.Read<float>();
+            object->Visible = reader.Read<uint8_t>() != 0;
+            object->TileID = reader.Read<int32_t>();
+            object->Name = reader.ReadString();
+            object->ClassName = reader.ReadString();
+            object->TemplateName = reader.ReadString();
+
+            if (type == ObjectLayer::ObjectType::Polygon)
+            {
+                reader.ReadVector(static_cast<ObjectLayer::PolygonObject&>(*object).Points);
+            }
+            else if (type == ObjectLayer::ObjectType::Text)
+            {
+                auto& text = static_cast<ObjectLayer::TextObject&>(*object);
+                text.Text = reader.ReadString();
+                text.FontSize = reader.Read<float>();
+            }
+
+            layer.Objets.emplace_back(std::move(object));
+        }
+
+        if (reader.Failed || cellSize <= 0)
+            return false;
+
+        layer.RebuildIndex(cellSize);
+        return true;
+    }
+
+    static bool ReadProperties(CookedReader& reader, PropertyStore& store)
+    {
+        uint32_t keyCount = reader.Read<uint32_t>();
+        std::vector<PropertyKey> keys;
+        for (uint32_t i = 0; i < keyCount && !reader.Failed; i++)
+            keys.push_back(GetPropertyKey(reader.ReadString()));
+
+        uint32_t count = reader.Read<uint32_t>();
+        for (uint32_t i = 0; i < count && !reader.Failed; i++)
+        {
+            Property& property = store.Properties.emplace_back();
+            property.Owner = reader.Read<uint64_t>();
+
+            uint32_t keyIndex = reader.Read<uint32_t>();
+            if (keyIndex >= keys.size())
+                return false;
+
+            property.Key = keys[keyIndex];
+            property.Type = PropertyType(reader.Read<uint8_t>());
+            property.IntValue = reader.Read<int32_t>();
+            property.FloatValue = reader.Read<float>();
+            property.ColorValue = reader.Read<Color>();
+            property.TextOffset = reader.Read<uint32_t>();
+        }
+
+        reader.ReadVector(store.Text);
+        if (reader.Failed)
+            return false;
+
+        // text must be terminated and every text property must start inside it, so GetText can't run off the end
+        if (!store.Text.empty() && store.Text.back() != '\0')
+            return false;
+
+        for (const Property& property : store.Properties)
+        {
+            if ((property.Type == PropertyType::String || property.Type == PropertyType::File) && property.TextOffset >= store.Text.size())
+                return false;
+        }
+
+        store.Rehash();
+        return true;
+    }
+
+    static bool ReadCookedTileMap(const TileMapLoadContext& context, CookedReader& reader, TileMap& map)
+    {
+        const uint8_t* magic = reader.ReadBytes(sizeof(CookedMagic));
+        if (magic == nullptr || memcmp(magic, CookedMagic, sizeof(CookedMagic)) != 0)
+            return false;
+
+        if (reader.Read<uint32_t>() != CookedVersion)
+            return false;
+
+        map.Orientation = TileMapOrientation(reader.Read<uint32_t>());
+        map.TileRenderOrder = reader.Read<Vector2>();
+        map.Infinite = reader.Read<uint8_t>() != 0;
+        map.Origin = reader.Read<Vector2>();
+
+        uint32_t sheetCount = reader.Read<uint32_t>();
+        for (uint32_t i = 0; i < sheetCount && !reader.Failed; i++)
+        {
+            uint16_t startId = reader.Read<uint16_t>();
+            auto& sheet = map.TileSheets[startId];
+            sheet.StartingTileId = startId;
+            sheet.TexturePath = reader.ReadString();
+            reader.ReadVector(sheet.Tiles);
+
+            uint32_t animationCount = reader.Read<uint32_t>();
+            for (uint32_t a = 0; a < animationCount && !reader.Failed; a++)
+            {
+                TileAnimation& animation = sheet.Animations[reader.Read<uint16_t>()];
+                uint32_t frameCount = reader.Read<uint32_t>();
+                for (uint32_t f = 0; f < frameCount && !reader.Failed; f++)
+                {
+                    TileAnimationFrame& frame = animation.Frames.emplace_back();
+                    frame.TileIndex = reader.Read<uint16_t>();
+                    frame.Duration = reader.Read<float>();
+                    animation.Length += frame.Duration;
+                }
+            }
+
+            uint32_t shapeTileCount = reader.Read<uint32_t>();
+            for (uint32_t t = 0; t < shapeTileCount && !reader.Failed; t++)
+            {
+                auto& shapes = sheet.CollisionShapes[reader.Read<uint16_t>()];
+                uint32_t shapeCount = reader.Read<uint32_t>();
+                for (uint32_t c = 0; c < shapeCount && !reader.Failed; c++)
+                {
+                    TileCollisionShape& shape = shapes.emplace_back();
+                    shape.Type = TileShapeType(reader.Read<uint8_t>());
+                    shape.Bounds = reader.Read<Rectangle>();
+                    reader.ReadVector(shape.Points);
+                }
+            }
+
+            if (!reader.Failed)
+                sheet.Texture = GetTexture(context, sheet.TexturePath);
+        }
+
+        uint32_t layerCount = reader.Read<uint32_t>();
+        for (uint32_t i = 0; i < layerCount && !reader.Failed; i++)
+        {
+            auto type = TileLayerType(reader.Read<uint32_t>());
+
+            std::unique_ptr<LayerInfo> layer;
+            if (type == TileLayerType::Tile)
+                layer = std::make_unique<TileLayer>();
+            else if (type == TileLayerType::Object)
+                layer = std::make_unique<ObjectLayer>();
+            else
+                return false;
+
+            layer->Name = reader.ReadString();
+            layer->LayerId = reader.Read<int32_t>();
+            layer->Visible = reader.Read<uint8_t>() != 0;
+            layer->CheckForCollisions = reader.Read<uint8_t>() != 0;
+
+            LayerInfo& info = *map.Layers.emplace_back(std::move(layer));
+            bool valid = type == TileLayerType::Tile ? ReadTileLayer(reader, static_cast<TileLayer&>(info)) : ReadObjectLayer(reader, static_cast<ObjectLayer&>(info));
+            if (!valid)
+                return false;
+        }
+
+        if (!ReadProperties(reader, map.Properties))
+            return false;
+
+        BuildTileLookup(map);
+
+        // collision masks depend on the tile lookup
+        for (auto& layer : map.Layers)
+        {
+            if (layer->CheckForCollisions)
+                SetLayerCollisions(map, *layer, true);
+        }
+
+        return map.TileSheets.size() > 0;
+    }
+
+    bool LoadCookedTileMap(const TileMapLoadContext& context, const std::string& filepath, TileMap& map)
+    {
+        size_t size = 0;
+        const void* data = MapFileReadOnly(filepath.c_str(), size);
+        if (data != nullptr)
+        {
+            map.CookedData = std::shared_ptr<const void>(data, [size](const void* mapped) { UnmapFile(mapped, size); });
+        }
+        else
+        {
+            // platforms without file mapping read the whole file instead
+            int dataSize = 0;
+            unsigned char* fileData = LoadFileData(filepath.c_str(), &dataSize);
+            if (fileData == nullptr)
+                return false;
+
+            size = size_t(dataSize);
+            data = fileData;
+            map.CookedData = std::shared_ptr<const void>(data, [](const void* loaded) { UnloadFileData(static_cast<unsigned char*>(const_cast<void*>(loaded))); });
+        }
+
+        CookedReader reader;
+        reader.Data = static_cast<const uint8_t*>(data);
+        reader.Size = size;
+
+        bool ret = ReadCookedTileMap(context, reader, map);
+
+        if (!ret)
+        {
+            // nothing can point at the file after a failed load
+            map.Layers.clear();
+            map.CookedData.reset();
+        }
+        return ret;
+    }
+}
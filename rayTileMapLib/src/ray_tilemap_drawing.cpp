@@ -29,113 +29,493 @@
 #include "ray_tilemap.h"
 #include "external/PUGIXML/pugixml.hpp"
 
+#include "rlgl.h"
+
+#include <algorithm>
+#include <cmath>
+
 namespace RayTiled
 {
-    Texture2D GetTexture(const std::string& fileName);
+    void BuildTileQuad(const TileSheet& sheet, Rectangle sourceRect, Rectangle destinationRect, uint8_t flags, TileQuad& quad);
+
+    // keep each rlBegin/rlEnd block well under the default rlgl batch size
+    static constexpr size_t MaxQuadsPerBatch = 1024;
+
+    static void DrawTileQuads(Texture2D texture, const TileQuad* quads, size_t count, Color tint)
+    {
+        rlSetTexture(texture.id);
+
+        while (count > 0)
+        {
+            size_t batchCount = std::min(count, MaxQuadsPerBatch);
+            rlCheckRenderBatchLimit(int(batchCount * 4));
+
+            rlBegin(RL_QUADS);
+            rlColor4ub(tint.r, tint.g, tint.b, tint.a);
+            rlNormal3f(0.0f, 0.0f, 1.0f);
+
+            for (size_t i = 0; i < batchCount; i++)
+            {
+                for (int corner = 0; corner < 4; corner++)
+                {
+                    rlTexCoord2f(quads[i].TexCoords[corner].x, quads[i].TexCoords[corner].y);
+                    rlVertex2f(quads[i].Positions[corner].x, quads[i].Positions[corner].y);
+                }
+            }
+            rlEnd();
+
+            quads += batchCount;
+            count -= batchCount;
+        }
+
+        rlSetTexture(0);
+    }
 
     void TileSheet::DrawTile(uint16_t id, Rectangle destinationRectangle, uint8_t flags, Color tint) const
     {
-        Rectangle sourceRect = Tiles[id - StartingTileId];
-        float rotation = 0;
+        TileQuad quad;
+        BuildTileQuad(*this, Tiles[id - StartingTileId], destinationRectangle, flags, quad);
+        DrawTileQuads(Texture, &quad, 1, tint);
+    }
+
+    void RaylibTileDrawBackend::DrawTile(const TileSheet& sheet, const TileDrawCommand& command, Color tint)
+    {
+        TileQuad quad;
+        BuildTileQuad(sheet, command.Source, command.Destination, command.Flags, quad);
+        DrawTileQuads(sheet.Texture, &quad, 1, tint);
+    }
+
+    void RaylibTileDrawBackend::DrawQuads(const TileSheet& sheet, const TileQuad* quads, size_t count, Color tint)
+    {
+        DrawTileQuads(sheet.Texture, quads, count, tint);
+    }
 
-        if (flags & TileFlagsFlipDiagonal)
-            rotation -= 90;
-        if (flags & TileFlagsFlipHorizontal)
-            sourceRect.width *= -1;
-        if (flags & TileFlagsFlipVertical)
-            sourceRect.height *= -1;
+    void RaylibTileDrawBackend::DrawTexture(Texture2D texture, Rectangle source, Rectangle destination, Color tint)
+    {
+        DrawTexturePro(texture, source, destination, Vector2Zero(), 0, tint);
+    }
 
-        DrawTexturePro(Texture, sourceRect, destinationRectangle, Vector2Zero(), rotation, tint);
+    void RecordingTileDrawBackend::BeginLayer(const TileLayer& /*layer*/)
+    {
+        LayerCount++;
     }
 
-    const TileSheet* FindSheetForId(uint16_t id, const TileMap& map)
+    TileDrawBatch& RecordingTileDrawBackend::GetBatch(const TileSheet& sheet)
     {
-        for (const auto& [startId, sheet] : map.TileSheets)
+        // tiles from the same sheet tend to come in runs, so check the last batch before searching
+        if (LastBatch >= Batches.size() || Batches[LastBatch].TextureId != sheet.Texture.id)
         {
-            if (sheet.HasId(id))
-                return &sheet;
+            LastBatch = 0;
+            while (LastBatch < Batches.size() && Batches[LastBatch].TextureId != sheet.Texture.id)
+                LastBatch++;
+
+            if (LastBatch == Batches.size())
+            {
+                Batches.emplace_back();
+                Batches.back().TextureId = sheet.Texture.id;
+            }
         }
 
-        return nullptr;
+        return Batches[LastBatch];
+    }
+
+    void RecordingTileDrawBackend::DrawTile(const TileSheet& sheet, const TileDrawCommand& command, Color tint)
+    {
+        TileDrawBatch& batch = GetBatch(sheet);
+        batch.Commands.push_back(command);
+        batch.CommandTints.push_back(tint);
+    }
+
+    void RecordingTileDrawBackend::DrawQuads(const TileSheet& sheet, const TileQuad* quads, size_t count, Color tint)
+    {
+        TileDrawBatch& batch = GetBatch(sheet);
+        batch.Quads.insert(batch.Quads.end(), quads, quads + count);
+        batch.QuadTints.insert(batch.QuadTints.end(), count, tint);
     }
 
-    static size_t TilesDrawn = 0;
+    void RecordingTileDrawBackend::DrawTexture(Texture2D texture, Rectangle source, Rectangle destination, Color tint)
+    {
+        TextureDraws.push_back(TileTextureDraw{ texture.id, source, destination, tint });
+    }
 
-    size_t GetTileDrawStats()
+    void RecordingTileDrawBackend::Flush()
     {
-        return TilesDrawn;
+        FlushCount++;
     }
 
-    void DrawTileLayer(TileMap& map, TileLayer* tileLayer, Camera2D* camera, Vector2 bounds)
+    size_t RecordingTileDrawBackend::GetCommandCount() const
     {
-        int startX = 0;
-        int startY = 0;
+        size_t count = 0;
+        for (const auto& batch : Batches)
+            count += batch.Commands.size();
 
-        int endX = int(tileLayer->Bounds.x);
-        int endY = int(tileLayer->Bounds.y);
+        return count;
+    }
 
-        int xDirection = 1;
-        int yDirection = 1;
+    size_t RecordingTileDrawBackend::GetQuadCount() const
+    {
+        size_t count = 0;
+        for (const auto& batch : Batches)
+            count += batch.Quads.size();
+
+        return count;
+    }
 
-        if (camera && tileLayer->Orientation == TileMapOrientation::Orthogonal)
+    void RecordingTileDrawBackend::Clear()
+    {
+        for (auto& batch : Batches)
         {
-            if (bounds.x <= 0 || bounds.y <= 0)
+            batch.Commands.clear();
+            batch.CommandTints.clear();
+            batch.Quads.clear();
+            batch.QuadTints.clear();
+        }
+
+        LayerCount = 0;
+        FlushCount = 0;
+        TextureDraws.clear();
+    }
+
+    // the raylib backend has no state, so every map can share it
+    static RaylibTileDrawBackend DefaultDrawBackend;
+
+    void SetTileDrawBackend(TileDrawContext& context, TileDrawBackend* backend)
+    {
+        context.Backend = backend;
+    }
+
+    static TileDrawBackend& GetBackend(const TileDrawContext& context)
+    {
+        return context.Backend ? *context.Backend : DefaultDrawBackend;
+    }
+
+    TileDrawBackend* GetTileDrawBackend(const TileDrawContext& context)
+    {
+        return &GetBackend(context);
+    }
+
+    size_t GetTileDrawStats(const TileDrawContext& context)
+    {
+        return context.TilesDrawn;
+    }
+
+    TileDrawContext& GetDefaultTileDrawContext()
+    {
+        static thread_local TileDrawContext context;
+        return context;
+    }
+
+    static void BuildDrawableIndex(TileDrawableIndex& drawables, const TileLayer* tileLayer, int startRow, int endRow)
+    {
+        drawables.StartRow = startRow;
+        drawables.Rows.resize(tileLayer->Drawables.size());
+        drawables.BucketStarts.assign(size_t(endRow - startRow) + 1, 0);
+
+        // a drawable belongs to the row where y * height < Y <= (y + 1) * height
+        for (size_t i = 0; i < tileLayer->Drawables.size(); i++)
+        {
+            int row = int(std::ceil(tileLayer->Drawables[i]->GetY() / tileLayer->TileSize.y)) - 1;
+            if (row < startRow || row >= endRow)
+                row = -1;
+            else
+                drawables.BucketStarts[size_t(row - startRow) + 1]++;
+
+            drawables.Rows[i] = row;
+        }
+
+        for (size_t bucket = 1; bucket < drawables.BucketStarts.size(); bucket++)
+            drawables.BucketStarts[bucket] += drawables.BucketStarts[bucket - 1];
+
+        // counting sort, stable so drawables in the same row keep the layer order
+        drawables.Sorted.resize(drawables.BucketStarts.back());
+        std::vector<size_t>& next = drawables.BucketStarts;
+        for (size_t i = 0; i < tileLayer->Drawables.size(); i++)
+        {
+            if (drawables.Rows[i] >= 0)
+                drawables.Sorted[next[size_t(drawables.Rows[i] - startRow)]++] = tileLayer->Drawables[i];
+        }
+
+        // filling moved every start up to the next bucket, shift them back
+        for (size_t bucket = next.size() - 1; bucket > 0; bucket--)
+            next[bucket] = next[bucket - 1];
+        next[0] = 0;
+    }
+
+    static void DrawRowDrawables(TileDrawContext& context, TileLayer* tileLayer, int y, int startX, int endX)
+    {
+        const TileDrawableIndex& drawables = context.Drawables;
+        size_t bucket = size_t(y - drawables.StartRow);
+        size_t begin = drawables.BucketStarts[bucket];
+        size_t end = drawables.BucketStarts[bucket + 1];
+
+        if (begin == end)
+            return;
+
+        GetBackend(context).Flush();
+        for (size_t i = begin; i < end; i++)
+            tileLayer->CustomDrawalbeFunction(*tileLayer, *drawables.Sorted[i], startX * tileLayer->TileSize.x, endX * tileLayer->TileSize.x);
+    }
+
+    static void DrawMeshRow(TileDrawContext& context, const TileLayerMeshSheet& meshSheet, int y, int startX, int endX)
+    {
+        const auto& row = meshSheet.Rows[y];
+
+        auto begin = std::lower_bound(row.begin(), row.end(), startX, [](const TileQuad& quad, int column) { return quad.X < column; });
+        auto end = std::lower_bound(begin, row.end(), endX, [](const TileQuad& quad, int column) { return quad.X < column; });
+
+        if (begin == end)
+            return;
+
+        GetBackend(context).DrawQuads(*meshSheet.Sheet, &(*begin), size_t(end - begin), WHITE);
+        context.TilesDrawn += size_t(end - begin);
+    }
+
+    // draws the quads of a span in column order like the per tile path, so overlapping tiles from different sheets keep their back to front order.
+    // each run of columns that use the same sheet is sent as one batch
+    static void DrawMeshSpan(TileDrawContext& context, const TileLayerMesh& mesh, const TileRowSpan& span)
+    {
+        if (mesh.Sheets.size() == 1)
+        {
+            DrawMeshRow(context, mesh.Sheets.front(), span.Y, span.StartX, span.EndX);
+            return;
+        }
+
+        int x = span.StartX;
+        while (x < span.EndX)
+        {
+            // a cell is in at most one sheet, so the sheet with the first quad owns every column up to the first quad of any other sheet
+            const TileLayerMeshSheet* runSheet = nullptr;
+            int runStart = span.EndX;
+            int runEnd = span.EndX;
+
+            for (const auto& meshSheet : mesh.Sheets)
             {
-                bounds.x = (float)GetScreenWidth();
-                bounds.y = (float)GetScreenHeight();
+                const auto& row = meshSheet.Rows[span.Y];
+                auto next = std::lower_bound(row.begin(), row.end(), x, [](const TileQuad& quad, int column) { return quad.X < column; });
+                if (next == row.end())
+                    continue;
+
+                if (next->X < runStart)
+                {
+                    runEnd = runStart;
+                    runStart = next->X;
+                    runSheet = &meshSheet;
+                }
+                else if (next->X < runEnd)
+                {
+                    runEnd = next->X;
+                }
             }
-            Vector2 viewportStart = GetScreenToWorld2D(Vector2Zero(), *camera);
-            Vector2 viewportEnd = GetScreenToWorld2D(bounds, *camera);
 
-            startX = std::max(startX, int(viewportStart.x / tileLayer->TileSize.x) - 1);
-            startY = std::max(startY, int(viewportStart.y / tileLayer->TileSize.y) - 1);
+            if (runSheet == nullptr)
+                return;
 
-            endX = std::min(endX, int(viewportEnd.x / tileLayer->TileSize.x) + 2);
-            endY = std::min(endY, int(viewportEnd.y / tileLayer->TileSize.y) + 2);
+            DrawMeshRow(context, *runSheet, span.Y, runStart, runEnd);
+            x = runEnd;
         }
+    }
 
-        // Handle the direction stuff from the map file
+    // draws the tiles in a set of row spans, without any drawables
+    static void DrawTileSpans(const TileMap& map, TileDrawContext& context, const TileLayer* tileLayer, const TileRowSpan* spans, size_t count)
+    {
+        if (tileLayer->Mesh)
+        {
+            // every other column spans are sent whole so each row stays one run
+            for (size_t i = 0; i < count; i++)
+                DrawMeshSpan(context, *tileLayer->Mesh, spans[i]);
+            return;
+        }
 
-        for (int y = startY; y != endY; y+= yDirection)
+        for (size_t i = 0; i < count; i++)
         {
-            for (int x = startX; x != endX; x += xDirection)
+            const TileRowSpan& span = spans[i];
+            for (int x = span.StartX; x < span.EndX; x += span.Step)
             {
+                // skip over chunks that were never painted
+                if (tileLayer->Sparse && x >= 0 && span.Y >= 0 && !tileLayer->FindChunk(x / tileLayer->ChunkWidth, span.Y / tileLayer->ChunkHeight))
+                {
+                    int nextChunkX = (x / tileLayer->ChunkWidth + 1) * tileLayer->ChunkWidth;
+                    x = nextChunkX + (span.Step - (nextChunkX - span.StartX) % span.Step) % span.Step - span.Step;
+                    continue;
+                }
+
                 Rectangle destRect;
-                const auto* tile = tileLayer->GetTile(x, y, destRect);
+                const auto* tile = tileLayer->GetTile(x, span.Y, destRect);
                 if (tile == nullptr || tile->TileIndex == 0)
                     continue;
 
-                if (map.LastTileSheet == nullptr || !map.LastTileSheet->HasId(tile->TileIndex))
-                    map.LastTileSheet = FindSheetForId(tile->TileIndex, map);
-
-                if (!map.LastTileSheet)
+                const TileLookupEntry* lookup = GetTileLookup(map, tile->TileIndex);
+                if (!lookup)
                     continue;
 
-                map.LastTileSheet->DrawTile(tile->TileIndex, destRect, tile->TileFlags, WHITE);
-                TilesDrawn++;
+                TileDrawCommand command;
+                command.Source = lookup->Source;
+                command.Destination = destRect;
+                command.Flags = tile->TileFlags;
+
+                GetBackend(context).DrawTile(*lookup->Sheet, command, WHITE);
+                context.TilesDrawn++;
             }
-            
-            if (tileLayer->CustomDrawalbeFunction)
+        }
+    }
+
+    // draws the tiles in a block of cells, without any drawables
+    void DrawTileBlock(const TileMap& map, TileDrawContext& context, const TileLayer* tileLayer, int startX, int startY, int endX, int endY)
+    {
+        for (int y = startY; y < endY; y++)
+        {
+            TileRowSpan span = { y, startX, endX, 1 };
+            DrawTileSpans(map, context, tileLayer, &span, 1);
+        }
+    }
+
+    static void DrawTileLayerCached(const TileMap& map, TileDrawContext& context, const TileLayer* tileLayer, int startX, int startY, int endX, int endY)
+    {
+        const TileLayerCache& cache = *tileLayer->Cache;
+
+        int chunkStartX = startX / cache.ChunkSize;
+        int chunkStartY = startY / cache.ChunkSize;
+        int chunkEndX = (endX + cache.ChunkSize - 1) / cache.ChunkSize;
+        int chunkEndY = (endY + cache.ChunkSize - 1) / cache.ChunkSize;
+
+        for (int chunkY = chunkStartY; chunkY < chunkEndY; chunkY++)
+        {
+            for (int chunkX = chunkStartX; chunkX < chunkEndX; chunkX++)
             {
-                for (auto& drawable : tileLayer->Drawables)
+                const TileLayerCacheChunk& chunk = cache.Chunks[chunkY * cache.ChunksX + chunkX];
+
+                int cellX = chunkX * cache.ChunkSize;
+                int cellY = chunkY * cache.ChunkSize;
+
+                if (chunk.Dirty || chunk.Target.id == 0)
                 {
-                    float yPos = drawable->GetY();
-                    if (yPos > y * tileLayer->TileSize.y && yPos <= (y + 1) * tileLayer->TileSize.y)
-                        tileLayer->CustomDrawalbeFunction(*tileLayer, *drawable, startX * tileLayer->TileSize.x, endX * tileLayer->TileSize.x);
+                    // not rendered yet, so draw the visible part of the chunk tile by tile
+                    DrawTileBlock(map, context, tileLayer, std::max(startX, cellX), std::max(startY, cellY),
+                        std::min(endX, cellX + cache.ChunkSize), std::min(endY, cellY + cache.ChunkSize));
+                    continue;
                 }
+
+                float width = float(chunk.Target.texture.width);
+                float height = float(chunk.Target.texture.height);
+
+                // render textures are stored upside down
+                Rectangle source = { 0, 0, width, -height };
+                Rectangle destination = { cellX * tileLayer->TileSize.x, cellY * tileLayer->TileSize.y, width, height };
+
+                GetBackend(context).DrawTexture(chunk.Target.texture, source, destination, WHITE);
+            }
+        }
+    }
+
+    // finds the visible cells of a layer, every cell is visible when there is no camera
+    static bool GetTileViewSpans(const TileLayer& tileLayer, Camera2D* camera, Vector2 bounds, std::vector<TileRowSpan>& spans)
+    {
+        if (camera)
+        {
+            if (bounds.x <= 0 || bounds.y <= 0)
+            {
+                bounds.x = (float)GetScreenWidth();
+                bounds.y = (float)GetScreenHeight();
+            }
+
+            // use all four corners so that rotated cameras are covered
+            Vector2 corners[4] = {
+                GetScreenToWorld2D(Vector2Zero(), *camera),
+                GetScreenToWorld2D(Vector2{ bounds.x, 0 }, *camera),
+                GetScreenToWorld2D(Vector2{ 0, bounds.y }, *camera),
+                GetScreenToWorld2D(bounds, *camera),
+            };
+
+            Vector2 min = corners[0];
+            Vector2 max = corners[0];
+            for (int i = 1; i < 4; i++)
+            {
+                min = Vector2Min(min, corners[i]);
+                max = Vector2Max(max, corners[i]);
+            }
+
+            tileLayer.GetVisibleSpans(Rectangle{ min.x, min.y, max.x - min.x, max.y - min.y }, spans);
+        }
+        else
+        {
+            spans.clear();
+            for (int y = 0; y < int(tileLayer.Bounds.y); y++)
+                spans.push_back(TileRowSpan{ y, 0, int(tileLayer.Bounds.x), 1 });
+        }
+
+        return !spans.empty();
+    }
+
+    bool GetTileViewRange(const TileLayer& tileLayer, Camera2D* camera, Vector2 bounds, std::vector<TileRowSpan>& spans, int& startX, int& startY, int& endX, int& endY)
+    {
+        if (!GetTileViewSpans(tileLayer, camera, bounds, spans))
+            return false;
+
+        startX = spans.front().StartX;
+        endX = spans.front().EndX;
+        for (const auto& span : spans)
+        {
+            startX = std::min(startX, span.StartX);
+            endX = std::max(endX, span.EndX);
+        }
+
+        startY = spans.front().Y;
+        endY = spans.back().Y + 1;
+        return true;
+    }
+
+    void DrawTileLayer(const TileMap& map, TileDrawContext& context, TileLayer* tileLayer, Camera2D* camera, Vector2 bounds)
+    {
+        bool hasDrawables = tileLayer->CustomDrawalbeFunction && !tileLayer->Drawables.empty();
+        TileDrawBackend& backend = GetBackend(context);
+
+        if (!hasDrawables && tileLayer->Cache && tileLayer->Orientation == TileMapOrientation::Orthogonal)
+        {
+            int startX, startY, endX, endY;
+            if (!GetTileViewRange(*tileLayer, camera, bounds, context.VisibleSpans, startX, startY, endX, endY))
+                return;
+
+            backend.BeginLayer(*tileLayer);
+            DrawTileLayerCached(map, context, tileLayer, startX, startY, endX, endY);
+            backend.EndLayer(*tileLayer);
+            return;
+        }
+
+        std::vector<TileRowSpan>& spans = context.VisibleSpans;
+        if (!GetTileViewSpans(*tileLayer, camera, bounds, spans))
+            return;
+
+        backend.BeginLayer(*tileLayer);
+
+        if (!hasDrawables)
+        {
+            DrawTileSpans(map, context, tileLayer, spans.data(), spans.size());
+        }
+        else
+        {
+            // Handle the direction stuff from the map file
+
+            BuildDrawableIndex(context.Drawables, tileLayer, spans.front().Y, spans.back().Y + 1);
+
+            for (const auto& span : spans)
+            {
+                DrawTileSpans(map, context, tileLayer, &span, 1);
+                DrawRowDrawables(context, tileLayer, span.Y, span.StartX, span.EndX);
             }
         }
+
+        backend.EndLayer(*tileLayer);
     }
 
-    void DrawVirtualLayer(TileMap& map, UserLayer* virtualLayer, Camera2D* camera, Vector2 bounds)
+    void DrawVirtualLayer(const TileMap& map, UserLayer* virtualLayer, Camera2D* camera, Vector2 bounds)
     {
         if (virtualLayer && virtualLayer->DrawFunction)
             virtualLayer->DrawFunction(*virtualLayer, camera, bounds);
     }
 
-    void DrawTileMap(TileMap& map, Camera2D* camera, Vector2 bounds)
+    void DrawTileMap(const TileMap& map, TileDrawContext& context, Camera2D* camera, Vector2 bounds)
     {
-        TilesDrawn = 0;
+        context.TilesDrawn = 0;
         for (auto& layer : map.Layers)
         {
             switch (layer->Type)
@@ -143,7 +523,7 @@ namespace RayTiled
             default:
                 break;
             case TileLayerType::Tile:
-                DrawTileLayer(map, static_cast<TileLayer*>(layer.get()), camera, bounds);
+                DrawTileLayer(map, context, static_cast<TileLayer*>(layer.get()), camera, bounds);
                 break;
             case TileLayerType::Object:
             {
@@ -158,4 +538,9 @@ namespace RayTiled
             }
         }
     }
+
+    void DrawTileMap(const TileMap& map, Camera2D* camera, Vector2 bounds)
+    {
+        DrawTileMap(map, GetDefaultTileDrawContext(), camera, bounds);
+    }
 }
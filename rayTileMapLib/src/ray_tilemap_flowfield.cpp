@@ -0,0 +1,438 @@
+/**********************************************************************************************
+*
+*   RayTileMap
+*
+*   LICENSE: MIT
+*
+*   Copyright (c) 2024 Jeffery Myers
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "ray_tilemap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace RayTiled
+{
+    using ParallelJob = std::function<void(size_t start, size_t end)>;
+    void ParallelFor(size_t count, size_t grain, const ParallelJob& func);
+
+    static constexpr float Unreachable = std::numeric_limits<float>::infinity();
+    static constexpr float DiagonalCost = 1.41421356f;
+
+    static const int FlowOffsets[8][2] = { {1,0}, {-1,0}, {0,1}, {0,-1}, {1,1}, {1,-1}, {-1,1}, {-1,-1} };
+
+    static const Vector2 FlowVectors[9] =
+    {
+        { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 },
+        { 0.70710678f, 0.70710678f }, { 0.70710678f, -0.70710678f }, { -0.70710678f, 0.70710678f }, { -0.70710678f, -0.70710678f },
+        { 0, 0 }
+    };
+
+    struct FlowOpenEntry
+    {
+        float Cost = 0;
+        int32_t Index = 0;
+
+        bool operator < (const FlowOpenEntry& other) const { return Cost > other.Cost; }
+    };
+
+    struct FlowSectorBounds
+    {
+        int X = 0;
+        int Y = 0;
+        int Width = 0;
+        int Height = 0;
+
+        bool Contains(int x, int y) const { return x >= X && y >= Y && x < X + Width && y < Y + Height; }
+        bool IsEdge(int x, int y) const { return x == X || y == Y || x == X + Width - 1 || y == Y + Height - 1; }
+    };
+
+    static FlowSectorBounds GetSectorBounds(const FlowField& field, int sector)
+    {
+        FlowSectorBounds bounds;
+        bounds.X = (sector % field.SectorsX) * field.SectorSize;
+        bounds.Y = (sector / field.SectorsX) * field.SectorSize;
+        bounds.Width = std::min(field.SectorSize, field.Width - bounds.X);
+        bounds.Height = std::min(field.SectorSize, field.Height - bounds.Y);
+        return bounds;
+    }
+
+    static int GetSector(const FlowField& field, int x, int y)
+    {
+        return (y / field.SectorSize) * field.SectorsX + (x / field.SectorSize);
+    }
+
+    // the cost of stepping from a cell to a neighbor, or a negative value if the step is not allowed
+    static float GetStepCost(const PathGrid& grid, int x, int y, int direction)
+    {
+        int dx = FlowOffsets[direction][0];
+        int dy = FlowOffsets[direction][1];
+        if (grid.IsBlocked(x + dx, y + dy))
+            return -1;
+
+        if (dx == 0 || dy == 0)
+            return 1;
+
+        // no cutting corners
+        if (grid.IsBlocked(x + dx, y) || grid.IsBlocked(x, y + dy))
+            return -1;
+
+        return DiagonalCost;
+    }
+
+    // pulls in the costs from the cells around a sector, then spreads them through it with a Dijkstra search.
+    // returns true if a cell on the edge of the sector got cheaper, so the sectors around it need to run again
+    static bool RelaxSector(const PathGrid& grid, FlowField& field, int sector, std::vector<FlowOpenEntry>& open)
+    {
+        FlowSectorBounds bounds = GetSectorBounds(field, sector);
+        bool edgeChanged = false;
+
+        open.clear();
+        for (int y = bounds.Y; y < bounds.Y + bounds.Height; y++)
+        {
+            for (int x = bounds.X; x < bounds.X + bounds.Width; x++)
+            {
+                size_t index = size_t(y) * field.Width + x;
+                if (grid.Blocked[index])
+                    continue;
+
+                float& cost = field.Integration[index];
+                if (bounds.IsEdge(x, y))
+                {
+                    // steps are the same both ways, so the cost from a neighbor is its cost plus the step to it
+                    for (int i = 0; i < 8; i++)
+                    {
+                        int nx = x + FlowOffsets[i][0];
+                        int ny = y + FlowOffsets[i][1];
+                        if (bounds.Contains(nx, ny))
+                            continue;
+
+                        float step = GetStepCost(grid, x, y, i);
+                        if (step < 0)
+                            continue;
+
+                        float pulled = field.Integration[size_t(ny) * field.Width + nx] + step;
+                        if (pulled < cost)
+                        {
+                            cost = pulled;
+                            edgeChanged = true;
+                        }
+                    }
+                }
+
+                if (cost != Unreachable)
+                    open.push_back({ cost, int32_t(index) });
+            }
+        }
+
+        std::make_heap(open.begin(), open.end());
+        while (!open.empty())
+        {
+            std::pop_heap(open.begin(), open.end());
+            FlowOpenEntry entry = open.back();
+            open.pop_back();
+
+            if (entry.Cost > field.Integration[entry.Index])
+                continue;
+
+            int x = entry.Index % field.Width;
+            int y = entry.Index / field.Width;
+            for (int i = 0; i < 8; i++)
+            {
+                int nx = x + FlowOffsets[i][0];
+                int ny = y + FlowOffsets[i][1];
+                if (!bounds.Contains(nx, ny))
+                    continue;
+
+                float step = GetStepCost(grid, x, y, i);
+                if (step < 0)
+                    continue;
+
+                int32_t index = ny * field.Width + nx;
+                float cost = entry.Cost + step;
+                if (cost >= field.Integration[index])
+                    continue;
+
+                field.Integration[index] = cost;
+                if (bounds.IsEdge(nx, ny))
+                    edgeChanged = true;
+
+                open.push_back({ cost, index });
+                std::push_heap(open.begin(), open.end());
+            }
+        }
+
+        return edgeChanged;
+    }
+
+    // runs the active sectors until no costs change. Sectors are run in four passes by the parity of their coordinates,
+    // so sectors running at the same time never share an edge and only read cells that are not being written
+    static void RelaxFlowField(const PathGrid& grid, FlowField& field, std::vector<uint8_t>& active, std::vector<uint8_t>& touched)
+    {
+        std::vector<int> batch;
+        std::vector<uint8_t> changed;
+
+        bool running = true;
+        while (running)
+        {
+            running = false;
+            for (int pass = 0; pass < 4; pass++)
+            {
+                batch.clear();
+                for (int sy = pass / 2; sy < field.SectorsY; sy += 2)
+                {
+                    for (int sx = pass % 2; sx < field.SectorsX; sx += 2)
+                    {
+                        int sector = sy * field.SectorsX + sx;
+                        if (!active[sector])
+                            continue;
+
+                        active[sector] = 0;
+                        touched[sector] = 1;
+                        batch.push_back(sector);
+                    }
+                }
+
+                if (batch.empty())
+                    continue;
+
+                running = true;
+                changed.assign(batch.size(), 0);
+                ParallelFor(batch.size(), 1, [&](size_t start, size_t end)
+                    {
+                        std::vector<FlowOpenEntry> open;
+                        for (size_t i = start; i < end; i++)
+                            changed[i] = RelaxSector(grid, field, batch[i], open) ? 1 : 0;
+                    });
+
+                for (size_t i = 0; i < batch.size(); i++)
+                {
+                    if (!changed[i])
+                        continue;
+
+                    int sx = batch[i] % field.SectorsX;
+                    int sy = batch[i] / field.SectorsX;
+                    for (int y = std::max(sy - 1, 0); y <= std::min(sy + 1, field.SectorsY - 1); y++)
+                    {
+                        for (int x = std::max(sx - 1, 0); x <= std::min(sx + 1, field.SectorsX - 1); x++)
+                        {
+                            if (x != sx || y != sy)
+                                active[y * field.SectorsX + x] = 1;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    static void BuildSectorDirections(const PathGrid& grid, FlowField& field, int sector)
+    {
+        FlowSectorBounds bounds = GetSectorBounds(field, sector);
+        for (int y = bounds.Y; y < bounds.Y + bounds.Height; y++)
+        {
+            for (int x = bounds.X; x < bounds.X + bounds.Width; x++)
+            {
+                size_t index = size_t(y) * field.Width + x;
+                float own = field.Integration[index];
+
+                // point at the neighbor the cost came from, so following the directions walks the shortest path
+                uint8_t direction = FlowField::NoDirection;
+                if (!grid.Blocked[index] && own != Unreachable && own > 0)
+                {
+                    float best = Unreachable;
+                    for (int i = 0; i < 8; i++)
+                    {
+                        float step = GetStepCost(grid, x, y, i);
+                        if (step < 0)
+                            continue;
+
+                        float cost = field.Integration[size_t(y + FlowOffsets[i][1]) * field.Width + x + FlowOffsets[i][0]] + step;
+                        if (cost < best)
+                        {
+                            best = cost;
+                            direction = uint8_t(i);
+                        }
+                    }
+                }
+                field.Directions[index] = direction;
+            }
+        }
+    }
+
+    // builds the directions of the touched sectors and the sectors around them, since cells next to a changed cell can point somewhere new
+    static void BuildFlowDirections(const PathGrid& grid, FlowField& field, const std::vector<uint8_t>& touched)
+    {
+        std::vector<int> sectors;
+        for (int sy = 0; sy < field.SectorsY; sy++)
+        {
+            for (int sx = 0; sx < field.SectorsX; sx++)
+            {
+                bool near = false;
+                for (int y = std::max(sy - 1, 0); y <= std::min(sy + 1, field.SectorsY - 1) && !near; y++)
+                {
+                    for (int x = std::max(sx - 1, 0); x <= std::min(sx + 1, field.SectorsX - 1) && !near; x++)
+                        near = touched[y * field.SectorsX + x] != 0;
+                }
+
+                if (near)
+                    sectors.push_back(sy * field.SectorsX + sx);
+            }
+        }
+
+        ParallelFor(sectors.size(), 1, [&](size_t start, size_t end)
+            {
+                for (size_t i = start; i < end; i++)
+                    BuildSectorDirections(grid, field, sectors[i]);
+            });
+    }
+
+    // puts the goals back after cells were reset, marking their sectors to run
+    static void SeedFlowGoals(const PathGrid& grid, FlowField& field, std::vector<uint8_t>& active)
+    {
+        for (int32_t goal : field.Goals)
+        {
+            if (grid.Blocked[goal])
+                continue;
+
+            field.Integration[goal] = 0;
+            active[GetSector(field, goal % field.Width, goal / field.Width)] = 1;
+        }
+    }
+
+    bool BuildFlowField(const PathGrid& grid, FlowField& field, const Vector2* goals, size_t goalCount, int sectorSize)
+    {
+        std::shared_lock<std::shared_mutex> lock(grid.Lock);
+
+        field.Width = grid.Width;
+        field.Height = grid.Height;
+        field.CellSize = grid.CellSize;
+        field.SectorSize = std::max(sectorSize, 4);
+        field.SectorsX = (field.Width + field.SectorSize - 1) / field.SectorSize;
+        field.SectorsY = (field.Height + field.SectorSize - 1) / field.SectorSize;
+
+        field.Integration.assign(size_t(field.Width) * field.Height, Unreachable);
+        field.Directions.assign(size_t(field.Width) * field.Height, FlowField::NoDirection);
+
+        field.Goals.clear();
+        for (size_t i = 0; i < goalCount; i++)
+        {
+            if (field.CellSize.x <= 0 || field.CellSize.y <= 0)
+                break;
+
+            int x = int(floorf(goals[i].x / field.CellSize.x));
+            int y = int(floorf(goals[i].y / field.CellSize.y));
+            if (!grid.IsBlocked(x, y))
+                field.Goals.push_back(y * field.Width + x);
+        }
+
+        if (field.Goals.empty())
+            return false;
+
+        std::vector<uint8_t> active(size_t(field.SectorsX) * field.SectorsY, 0);
+        std::vector<uint8_t> touched(active.size(), 0);
+        SeedFlowGoals(grid, field, active);
+
+        RelaxFlowField(grid, field, active, touched);
+
+        // every sector gets directions, even the ones no goal could reach
+        std::fill(touched.begin(), touched.end(), 1);
+        BuildFlowDirections(grid, field, touched);
+        return true;
+    }
+
+    void InvalidateFlowField(const PathGrid& grid, FlowField& field, int x, int y, int width, int height)
+    {
+        std::shared_lock<std::shared_mutex> lock(grid.Lock);
+        if (field.Width != grid.Width || field.Height != grid.Height || field.Integration.empty())
+            return;
+
+        // the neighbors of a changed cell are reset too, since a new wall can block the diagonal steps around it
+        int minX = std::max(x - 1, 0);
+        int minY = std::max(y - 1, 0);
+        int maxX = std::min(x + width + 1, field.Width);
+        int maxY = std::min(y + height + 1, field.Height);
+        if (minX >= maxX || minY >= maxY)
+            return;
+
+        std::vector<uint8_t> active(size_t(field.SectorsX) * field.SectorsY, 0);
+        std::vector<uint8_t> touched(active.size(), 0);
+
+        std::vector<int32_t> reset;
+        for (int cellY = minY; cellY < maxY; cellY++)
+        {
+            for (int cellX = minX; cellX < maxX; cellX++)
+                reset.push_back(cellY * field.Width + cellX);
+        }
+
+        for (int32_t index : reset)
+        {
+            field.Integration[index] = Unreachable;
+            field.Directions[index] = FlowField::NoDirection;
+        }
+
+        // every cell that flowed through a reset cell may have a new cost, follow the directions backwards to find them
+        for (size_t i = 0; i < reset.size(); i++)
+        {
+            int cellX = reset[i] % field.Width;
+            int cellY = reset[i] / field.Width;
+            active[GetSector(field, cellX, cellY)] = 1;
+
+            for (int d = 0; d < 8; d++)
+            {
+                int nx = cellX + FlowOffsets[d][0];
+                int ny = cellY + FlowOffsets[d][1];
+                if (nx < 0 || ny < 0 || nx >= field.Width || ny >= field.Height)
+                    continue;
+
+                int32_t neighbor = ny * field.Width + nx;
+                uint8_t direction = field.Directions[neighbor];
+                if (direction == FlowField::NoDirection || nx + FlowOffsets[direction][0] != cellX || ny + FlowOffsets[direction][1] != cellY)
+                    continue;
+
+                field.Integration[neighbor] = Unreachable;
+                field.Directions[neighbor] = FlowField::NoDirection;
+                reset.push_back(neighbor);
+            }
+        }
+
+        SeedFlowGoals(grid, field, active);
+
+        RelaxFlowField(grid, field, active, touched);
+        BuildFlowDirections(grid, field, touched);
+    }
+
+    Vector2 GetFlowDirection(const FlowField& field, Vector2 position)
+    {
+        if (field.CellSize.x <= 0 || field.CellSize.y <= 0)
+            return FlowVectors[FlowField::NoDirection];
+
+        int x = int(floorf(position.x / field.CellSize.x));
+        int y = int(floorf(position.y / field.CellSize.y));
+        if (x < 0 || y < 0 || x >= field.Width || y >= field.Height)
+            return FlowVectors[FlowField::NoDirection];
+
+        return FlowVectors[field.Directions[size_t(y) * field.Width + x]];
+    }
+}
@@ -0,0 +1,202 @@
+/**********************************************************************************************
+*
+*   RayTileMap
+*
+*   LICENSE: MIT
+*
+*   Copyright (c) 2024 Jeffery Myers
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "ray_tilemap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace RayTiled
+{
+    // a range of work items that the pool runs in parallel
+    using ParallelJob = std::function<void(size_t start, size_t end)>;
+
+    // a set of persistent worker threads, the thread that submits a job also works on it
+    struct JobPool
+    {
+        std::vector<std::thread> Workers;
+
+        std::mutex SubmitLock;          // only one job runs at a time
+        std::mutex Lock;                // guards the job state below
+        std::condition_variable WorkReady;
+        std::condition_variable WorkDone;
+
+        const ParallelJob* Job = nullptr;
+        size_t Count = 0;
+        size_t Grain = 1;
+        std::atomic<size_t> NextIndex = 0;
+
+        uint64_t Generation = 0;
+        size_t ActiveWorkers = 0;
+        bool Quit = false;
+        bool Started = false;
+
+        ~JobPool() { Stop(); }
+
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(Lock);
+                Quit = true;
+            }
+            WorkReady.notify_all();
+
+            for (auto& worker : Workers)
+                worker.join();
+
+            Workers.clear();
+            Quit = false;
+        }
+    };
+
+    static JobPool Pool;
+
+    // set while a thread is working on a job, so nested jobs run inline instead of waiting on themselves
+    static thread_local bool InsideJob = false;
+
+    static void RunJobChunks(const ParallelJob& job, size_t count, size_t grain)
+    {
+        InsideJob = true;
+
+        while (true)
+        {
+            size_t start = Pool.NextIndex.fetch_add(grain);
+            if (start >= count)
+                break;
+
+            job(start, std::min(start + grain, count));
+        }
+
+        InsideJob = false;
+    }
+
+    static void WorkerLoop()
+    {
+        uint64_t lastGeneration = 0;
+
+        std::unique_lock<std::mutex> lock(Pool.Lock);
+        while (true)
+        {
+            Pool.WorkReady.wait(lock, [&lastGeneration]() { return Pool.Quit || Pool.Generation != lastGeneration; });
+            if (Pool.Quit)
+                return;
+
+            lastGeneration = Pool.Generation;
+
+            // the submitter may have already finished the job without us
+            if (Pool.Job == nullptr)
+                continue;
+
+            const ParallelJob* job = Pool.Job;
+            size_t count = Pool.Count;
+            size_t grain = Pool.Grain;
+            Pool.ActiveWorkers++;
+
+            lock.unlock();
+            RunJobChunks(*job, count, grain);
+            lock.lock();
+
+            if (--Pool.ActiveWorkers == 0)
+                Pool.WorkDone.notify_all();
+        }
+    }
+
+    static void StartWorkers(int count)
+    {
+        Pool.Stop();
+
+        if (count < 0)
+            count = std::max(int(std::thread::hardware_concurrency()) - 1, 0);
+
+        for (int i = 0; i < count; i++)
+            Pool.Workers.emplace_back(WorkerLoop);
+
+        Pool.Started = true;
+    }
+
+    void SetTileMapWorkerCount(int count)
+    {
+        std::lock_guard<std::mutex> submit(Pool.SubmitLock);
+        StartWorkers(count);
+    }
+
+    int GetTileMapWorkerCount()
+    {
+        std::lock_guard<std::mutex> submit(Pool.SubmitLock);
+        if (!Pool.Started)
+            StartWorkers(-1);
+
+        return int(Pool.Workers.size());
+    }
+
+    // runs func over [0, count) in chunks of grain items, on the worker threads and the calling thread
+    // returns when every chunk is done
+    void ParallelFor(size_t count, size_t grain, const ParallelJob& func)
+    {
+        if (count == 0)
+            return;
+
+        grain = std::max(grain, size_t(1));
+
+        if (InsideJob || count <= grain)
+        {
+            func(0, count);
+            return;
+        }
+
+        std::lock_guard<std::mutex> submit(Pool.SubmitLock);
+        if (!Pool.Started)
+            StartWorkers(-1);
+
+        if (Pool.Workers.empty())
+        {
+            func(0, count);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(Pool.Lock);
+            Pool.Job = &func;
+            Pool.Count = count;
+            Pool.Grain = grain;
+            Pool.NextIndex = 0;
+            Pool.Generation++;
+        }
+        Pool.WorkReady.notify_all();
+
+        RunJobChunks(func, count, grain);
+
+        std::unique_lock<std::mutex> lock(Pool.Lock);
+        Pool.WorkDone.wait(lock, []() { return Pool.ActiveWorkers == 0; });
+        Pool.Job = nullptr;
+    }
+}
@@ -0,0 +1,263 @@
+/**********************************************************************************************
+*
+*   RayTileMap
+*
+*   LICENSE: MIT
+*
+*   Copyright (c) 2024 Jeffery Myers
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "ray_tilemap.h"
+
+#include <algorithm>
+
+namespace RayTiled
+{
+    void BuildTileQuad(const TileSheet& sheet, Rectangle sourceRect, Rectangle destinationRect, uint8_t flags, TileQuad& quad)
+    {
+        // corners are in the same order that raylib uses for textured quads
+        quad.Positions[0] = Vector2{ destinationRect.x, destinationRect.y };
+        quad.Positions[1] = Vector2{ destinationRect.x, destinationRect.y + destinationRect.height };
+        quad.Positions[2] = Vector2{ destinationRect.x + destinationRect.width, destinationRect.y + destinationRect.height };
+        quad.Positions[3] = Vector2{ destinationRect.x + destinationRect.width, destinationRect.y };
+
+        // headless maps have no texture size, so avoid the divide by zero
+        float textureWidth = float(std::max(sheet.Texture.width, 1));
+        float textureHeight = float(std::max(sheet.Texture.height, 1));
+
+        float u0 = sourceRect.x / textureWidth;
+        float v0 = sourceRect.y / textureHeight;
+        float u1 = (sourceRect.x + sourceRect.width) / textureWidth;
+        float v1 = (sourceRect.y + sourceRect.height) / textureHeight;
+
+        Vector2* uv = quad.TexCoords;
+        uv[0] = Vector2{ u0, v0 };
+        uv[1] = Vector2{ u0, v1 };
+        uv[2] = Vector2{ u1, v1 };
+        uv[3] = Vector2{ u1, v0 };
+
+        // Tiled applies the diagonal flip (an x/y swap) first, then the horizontal and vertical flips
+        if (flags & TileFlagsFlipDiagonal)
+            std::swap(uv[1], uv[3]);
+
+        if (flags & TileFlagsFlipHorizontal)
+        {
+            std::swap(uv[0], uv[3]);
+            std::swap(uv[1], uv[2]);
+        }
+
+        if (flags & TileFlagsFlipVertical)
+        {
+            std::swap(uv[0], uv[1]);
+            std::swap(uv[3], uv[2]);
+        }
+    }
+
+    static TileLayerMeshSheet& GetMeshSheet(TileLayerMesh& mesh, const TileSheet* sheet, size_t rowCount)
+    {
+        for (auto& meshSheet : mesh.Sheets)
+        {
+            if (meshSheet.Sheet == sheet)
+                return meshSheet;
+        }
+
+        mesh.Sheets.emplace_back();
+        mesh.Sheets.back().Sheet = sheet;
+        mesh.Sheets.back().Rows.resize(rowCount);
+        return mesh.Sheets.back();
+    }
+
+    // returns the lookup entry of the tile in the cell, nullptr if the cell has no quad
+    static const TileLookupEntry* BuildQuadForCell(const TileMap& map, const TileLayer& layer, int x, int y, const TileSheet*& sheet, TileQuad& quad)
+    {
+        Rectangle destRect;
+        const TileInfo* tile = layer.GetTile(x, y, destRect);
+        if (tile == nullptr || tile->TileIndex == 0)
+            return nullptr;
+
+        const TileLookupEntry* lookup = GetTileLookup(map, tile->TileIndex);
+        if (lookup == nullptr)
+            return nullptr;
+
+        sheet = lookup->Sheet;
+        BuildTileQuad(*sheet, lookup->Source, destRect, tile->TileFlags, quad);
+        quad.X = x;
+        return lookup;
+    }
+
+    static uint64_t GetCellKey(int x, int y)
+    {
+        return (uint64_t(uint32_t(x)) << 32) | uint64_t(uint32_t(y));
+    }
+
+    static std::vector<TileQuad>::iterator FindQuad(std::vector<TileQuad>& row, int x)
+    {
+        return std::lower_bound(row.begin(), row.end(), x, [](const TileQuad& quad, int column) { return quad.X < column; });
+    }
+
+    void BuildTileLayerMesh(const TileMap& map, TileLayer& layer)
+    {
+        layer.Mesh = std::make_unique<TileLayerMesh>();
+
+        int width = int(layer.Bounds.x);
+        int height = int(layer.Bounds.y);
+
+        if (layer.Sparse)
+        {
+            // only visit the painted chunks, then put each row back in column order
+            for (auto& [key, chunk] : layer.Chunks)
+            {
+                int startX = int(uint32_t(key >> 32)) * layer.ChunkWidth;
+                int startY = int(uint32_t(key)) * layer.ChunkHeight;
+
+                for (int y = startY; y < std::min(startY + layer.ChunkHeight, height); y++)
+                {
+                    for (int x = startX; x < std::min(startX + layer.ChunkWidth, width); x++)
+                    {
+                        const TileSheet* sheet = nullptr;
+                        TileQuad quad;
+                        const TileLookupEntry* lookup = BuildQuadForCell(map, layer, x, y, sheet, quad);
+                        if (lookup == nullptr)
+                            continue;
+
+                        GetMeshSheet(*layer.Mesh, sheet, height).Rows[y].push_back(quad);
+                        if (lookup->Animation >= 0)
+                            layer.Mesh->AnimatedCells.insert(GetCellKey(x, y));
+                    }
+                }
+            }
+
+            for (auto& meshSheet : layer.Mesh->Sheets)
+            {
+                for (auto& row : meshSheet.Rows)
+                    std::sort(row.begin(), row.end(), [](const TileQuad& a, const TileQuad& b) { return a.X < b.X; });
+            }
+            return;
+        }
+
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                const TileSheet* sheet = nullptr;
+                TileQuad quad;
+                const TileLookupEntry* lookup = BuildQuadForCell(map, layer, x, y, sheet, quad);
+                if (lookup == nullptr)
+                    continue;
+
+                // cells are visited in column order, so each row stays sorted
+                GetMeshSheet(*layer.Mesh, sheet, height).Rows[y].push_back(quad);
+                if (lookup->Animation >= 0)
+                    layer.Mesh->AnimatedCells.insert(GetCellKey(x, y));
+            }
+        }
+    }
+
+    void BuildTileMapMeshes(TileMap& map)
+    {
+        for (auto& layer : map.Layers)
+        {
+            if (layer->Type == TileLayerType::Tile)
+                BuildTileLayerMesh(map, *static_cast<TileLayer*>(layer.get()));
+        }
+    }
+
+    void ReleaseTileLayerMesh(TileLayer& layer)
+    {
+        layer.Mesh.reset();
+    }
+
+    void UpdateTileLayerMeshCell(const TileMap& map, TileLayer& layer, int x, int y)
+    {
+        if (!layer.Mesh)
+            return;
+
+        const TileSheet* sheet = nullptr;
+        TileQuad quad;
+        const TileLookupEntry* lookup = BuildQuadForCell(map, layer, x, y, sheet, quad);
+        bool hasQuad = lookup != nullptr;
+
+        // keep the animated cell set in step with the tile
+        if (lookup != nullptr && lookup->Animation >= 0)
+            layer.Mesh->AnimatedCells.insert(GetCellKey(x, y));
+        else
+            layer.Mesh->AnimatedCells.erase(GetCellKey(x, y));
+
+        for (auto& meshSheet : layer.Mesh->Sheets)
+        {
+            auto& row = meshSheet.Rows[y];
+            auto itr = FindQuad(row, x);
+            bool found = itr != row.end() && itr->X == x;
+
+            if (hasQuad && meshSheet.Sheet == sheet)
+            {
+                // same sheet, only the vertices of this cell need to change
+                if (found)
+                    *itr = quad;
+                else
+                    row.insert(itr, quad);
+
+                hasQuad = false;
+            }
+            else if (found)
+            {
+                row.erase(itr);
+            }
+        }
+
+        // first tile from a sheet that was not in the mesh yet
+        if (hasQuad)
+            GetMeshSheet(*layer.Mesh, sheet, size_t(layer.Bounds.y)).Rows[y].push_back(quad);
+    }
+
+    void UpdateTileLayerMeshAnimations(const TileMap& map, TileLayer& layer)
+    {
+        if (!layer.Mesh)
+            return;
+
+        for (uint64_t cell : layer.Mesh->AnimatedCells)
+        {
+            int x = int(uint32_t(cell >> 32));
+            int y = int(uint32_t(cell));
+
+            const TileSheet* sheet = nullptr;
+            TileQuad quad;
+            const TileLookupEntry* lookup = BuildQuadForCell(map, layer, x, y, sheet, quad);
+            if (lookup == nullptr || lookup->Animation < 0 || !map.Animations[lookup->Animation].Changed)
+                continue;
+
+            // frames are always in the same sheet, so the quad stays where it is
+            for (auto& meshSheet : layer.Mesh->Sheets)
+            {
+                if (meshSheet.Sheet != sheet)
+                    continue;
+
+                auto& row = meshSheet.Rows[y];
+                auto itr = FindQuad(row, x);
+                if (itr != row.end() && itr->X == x)
+                    *itr = quad;
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,157 @@
+/**********************************************************************************************
+*
+*   RayTileMap
+*
+*   LICENSE: MIT
+*
+*   Copyright (c) 2024 Jeffery Myers
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "ray_tilemap.h"
+
+#include <algorithm>
+
+namespace RayTiled
+{
+    void ObjectLayer::GetCellRange(const Rectangle& rect, int& startX, int& startY, int& endX, int& endY) const
+    {
+        startX = GetCellCoordinate(rect.x);
+        startY = GetCellCoordinate(rect.y);
+        endX = GetCellCoordinate(rect.x + rect.width);
+        endY = GetCellCoordinate(rect.y + rect.height);
+    }
+
+    void ObjectLayer::InsertIntoGrid(Object* object)
+    {
+        int startX, startY, endX, endY;
+        GetCellRange(object->Bounds, startX, startY, endX, endY);
+
+        for (int y = startY; y <= endY; y++)
+        {
+            for (int x = startX; x <= endX; x++)
+                Grid.Cells[GetCellKey(x, y)].push_back(object);
+        }
+    }
+
+    void ObjectLayer::RemoveFromGrid(Object* object)
+    {
+        int startX, startY, endX, endY;
+        GetCellRange(object->Bounds, startX, startY, endX, endY);
+
+        for (int y = startY; y <= endY; y++)
+        {
+            for (int x = startX; x <= endX; x++)
+            {
+                auto itr = Grid.Cells.find(GetCellKey(x, y));
+                if (itr == Grid.Cells.end())
+                    continue;
+
+                auto& cell = itr->second;
+                auto objectItr = std::find(cell.begin(), cell.end(), object);
+                if (objectItr != cell.end())
+                    cell.erase(objectItr);
+
+                if (cell.empty())
+                    Grid.Cells.erase(itr);
+            }
+        }
+    }
+
+    ObjectLayer::Object* ObjectLayer::AddObject(std::unique_ptr<Object> object)
+    {
+        Object* objectPtr = object.get();
+        ObjectIndexes[objectPtr->Id] = Objets.size();
+        Objets.emplace_back(std::move(object));
+        InsertIntoGrid(objectPtr);
+        return objectPtr;
+    }
+
+    bool ObjectLayer::RemoveObject(int32_t id)
+    {
+        auto itr = ObjectIndexes.find(id);
+        if (itr == ObjectIndexes.end())
+            return false;
+
+        size_t index = itr->second;
+        ObjectIndexes.erase(itr);
+        RemoveFromGrid(Objets[index].get());
+
+        // fill the hole with the last object so nothing else has to move
+        if (index != Objets.size() - 1)
+        {
+            Objets[index] = std::move(Objets.back());
+            ObjectIndexes[Objets[index]->Id] = index;
+        }
+        Objets.pop_back();
+        return true;
+    }
+
+    bool ObjectLayer::MoveObject(int32_t id, Rectangle bounds)
+    {
+        Object* object = FindObject(id);
+        if (object == nullptr)
+            return false;
+
+        int oldStartX, oldStartY, oldEndX, oldEndY;
+        GetCellRange(object->Bounds, oldStartX, oldStartY, oldEndX, oldEndY);
+
+        int newStartX, newStartY, newEndX, newEndY;
+        GetCellRange(bounds, newStartX, newStartY, newEndX, newEndY);
+
+        // most moves stay inside the same cells, so the grid does not need to change
+        if (oldStartX == newStartX && oldStartY == newStartY && oldEndX == newEndX && oldEndY == newEndY)
+        {
+            object->Bounds = bounds;
+            return true;
+        }
+
+        RemoveFromGrid(object);
+        object->Bounds = bounds;
+        InsertIntoGrid(object);
+        return true;
+    }
+
+    ObjectLayer::Object* ObjectLayer::FindObject(int32_t id) const
+    {
+        auto itr = ObjectIndexes.find(id);
+        if (itr == ObjectIndexes.end())
+            return nullptr;
+
+        return Objets[itr->second].get();
+    }
+
+    void ObjectLayer::RebuildIndex(float cellSize)
+    {
+        Grid.Cells.clear();
+        Grid.CellSize = cellSize > 0 ? cellSize : 128;
+
+        ObjectIndexes.clear();
+        ObjectIndexes.reserve(Objets.size());
+
+        for (size_t i = 0; i < Objets.size(); i++)
+        {
+            ObjectIndexes[Objets[i]->Id] = i;
+            InsertIntoGrid(Objets[i].get());
+        }
+    }
+}
@@ -0,0 +1,761 @@
+/**********************************************************************************************
+*
+*   RayTileMap
+*
+*   LICENSE: MIT
+*
+*   Copyright (c) 2024 Jeffery Myers
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "ray_tilemap.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace RayTiled
+{
+    using ParallelJob = std::function<void(size_t start, size_t end)>;
+    void ParallelFor(size_t count, size_t grain, const ParallelJob& func);
+
+    static constexpr float DiagonalCost = 1.41421356f;
+
+    static const int NeighborOffsets[8][2] = { {1,0}, {-1,0}, {0,1}, {0,-1}, {1,1}, {1,-1}, {-1,1}, {-1,-1} };
+
+    struct PathOpenEntry
+    {
+        float Estimate = 0;     // the cost so far plus the heuristic
+        float Cost = 0;         // the cost so far, used to skip entries that were improved after they were pushed
+        int32_t Index = 0;
+
+        bool operator < (const PathOpenEntry& other) const { return Estimate > other.Estimate; }
+    };
+
+    // the memory used by one query, generations are used so nothing has to be cleared between searches
+    struct PathScratch
+    {
+        std::vector<float> CellCost;        // one cluster of cells
+        std::vector<int32_t> CellParent;
+        std::vector<uint32_t> CellStamp;
+        uint32_t CellGeneration = 0;
+
+        std::vector<float> NodeCost;        // every node, plus the start and goal
+        std::vector<int32_t> NodeParent;
+        std::vector<uint32_t> NodeStamp;
+        uint32_t NodeGeneration = 0;
+
+        std::vector<PathOpenEntry> Open;
+        std::vector<PathNode::Edge> StartEdges;
+        std::vector<PathNode::Edge> GoalEdges;
+        std::vector<int32_t> Route;
+        std::vector<int32_t> Cells;
+        std::vector<int32_t> ClusterNodes;
+    };
+
+    PathGrid::PathGrid() = default;
+    PathGrid::~PathGrid() = default;
+
+    // hands out search memory, queries on other threads get their own
+    struct PathScratchLease
+    {
+        const PathGrid& Grid;
+        std::unique_ptr<PathScratch> Scratch;
+
+        PathScratchLease(const PathGrid& grid) : Grid(grid)
+        {
+            std::lock_guard<std::mutex> guard(Grid.ScratchLock);
+            if (!Grid.Scratch.empty())
+            {
+                Scratch = std::move(Grid.Scratch.back());
+                Grid.Scratch.pop_back();
+            }
+            else
+            {
+                Scratch = std::make_unique<PathScratch>();
+            }
+        }
+
+        ~PathScratchLease()
+        {
+            std::lock_guard<std::mutex> guard(Grid.ScratchLock);
+            Grid.Scratch.push_back(std::move(Scratch));
+        }
+    };
+
+    // starts a new search over a stamped array, only clearing it when the generation wraps
+    static void BeginGeneration(std::vector<uint32_t>& stamps, uint32_t& generation, size_t size)
+    {
+        if (stamps.size() < size)
+            stamps.resize(size, 0);
+
+        generation++;
+        if (generation == 0)
+        {
+            std::fill(stamps.begin(), stamps.end(), 0);
+            generation = 1;
+        }
+    }
+
+    static float GetOctileDistance(int x1, int y1, int x2, int y2)
+    {
+        int dx = std::abs(x1 - x2);
+        int dy = std::abs(y1 - y2);
+        return float(std::max(dx, dy)) + (DiagonalCost - 1) * float(std::min(dx, dy));
+    }
+
+    struct PathClusterBounds
+    {
+        int X = 0;
+        int Y = 0;
+        int Width = 0;
+        int Height = 0;
+
+        bool Contains(int x, int y) const { return x >= X && y >= Y && x < X + Width && y < Y + Height; }
+        int GetIndex(int x, int y) const { return (y - Y) * Width + (x - X); }
+    };
+
+    static int GetCluster(const PathGrid& grid, int x, int y)
+    {
+        return (y / grid.ClusterSize) * grid.ClustersX + (x / grid.ClusterSize);
+    }
+
+    static PathClusterBounds GetClusterBounds(const PathGrid& grid, int cluster)
+    {
+        PathClusterBounds bounds;
+        bounds.X = (cluster % grid.ClustersX) * grid.ClusterSize;
+        bounds.Y = (cluster / grid.ClustersX) * grid.ClusterSize;
+        bounds.Width = std::min(grid.ClusterSize, grid.Width - bounds.X);
+        bounds.Height = std::min(grid.ClusterSize, grid.Height - bounds.Y);
+        return bounds;
+    }
+
+    static int GetVerticalBorderCount(const PathGrid& grid)
+    {
+        return (grid.ClustersX - 1) * grid.ClustersY;
+    }
+
+    // the borders around a cluster, returns how many it has
+    static int GetClusterBorders(const PathGrid& grid, int cluster, int borders[4])
+    {
+        int cx = cluster % grid.ClustersX;
+        int cy = cluster / grid.ClustersX;
+        int vertical = GetVerticalBorderCount(grid);
+
+        int count = 0;
+        if (cx > 0)
+            borders[count++] = cy * (grid.ClustersX - 1) + cx - 1;
+        if (cx < grid.ClustersX - 1)
+            borders[count++] = cy * (grid.ClustersX - 1) + cx;
+        if (cy > 0)
+            borders[count++] = vertical + (cy - 1) * grid.ClustersX + cx;
+        if (cy < grid.ClustersY - 1)
+            borders[count++] = vertical + cy * grid.ClustersX + cx;
+
+        return count;
+    }
+
+    // the cells along one side of a border, the matching cells on the other side are one step along the side offset
+    struct PathBorder
+    {
+        int ClusterA = 0;
+        int ClusterB = 0;
+        int X = 0;
+        int Y = 0;
+        int StepX = 0;
+        int StepY = 0;
+        int SideX = 0;
+        int SideY = 0;
+        int Length = 0;
+    };
+
+    static PathBorder GetBorder(const PathGrid& grid, int border)
+    {
+        PathBorder info;
+        int vertical = GetVerticalBorderCount(grid);
+        if (border < vertical)
+        {
+            int cx = border % (grid.ClustersX - 1);
+            int cy = border / (grid.ClustersX - 1);
+            info.ClusterA = cy * grid.ClustersX + cx;
+            info.ClusterB = info.ClusterA + 1;
+            info.X = (cx + 1) * grid.ClusterSize - 1;
+            info.Y = cy * grid.ClusterSize;
+            info.StepY = 1;
+            info.SideX = 1;
+            info.Length = std::min(grid.ClusterSize, grid.Height - info.Y);
+        }
+        else
+        {
+            border -= vertical;
+            int cx = border % grid.ClustersX;
+            int cy = border / grid.ClustersX;
+            info.ClusterA = cy * grid.ClustersX + cx;
+            info.ClusterB = info.ClusterA + grid.ClustersX;
+            info.X = cx * grid.ClusterSize;
+            info.Y = (cy + 1) * grid.ClusterSize - 1;
+            info.StepX = 1;
+            info.SideY = 1;
+            info.Length = std::min(grid.ClusterSize, grid.Width - info.X);
+        }
+        return info;
+    }
+
+    static int32_t AddPathNode(PathGrid& grid, int x, int y, int cluster)
+    {
+        int32_t id = 0;
+        if (!grid.FreeNodes.empty())
+        {
+            id = grid.FreeNodes.back();
+            grid.FreeNodes.pop_back();
+        }
+        else
+        {
+            id = int32_t(grid.Nodes.size());
+            grid.Nodes.emplace_back();
+        }
+
+        PathNode& node = grid.Nodes[id];
+        node.X = x;
+        node.Y = y;
+        node.Cluster = cluster;
+        node.Peer = -1;
+        node.Alive = true;
+        node.Edges.clear();
+        return id;
+    }
+
+    static void AddTransition(PathGrid& grid, int border, const PathBorder& info, int offset)
+    {
+        int ax = info.X + info.StepX * offset;
+        int ay = info.Y + info.StepY * offset;
+
+        int32_t a = AddPathNode(grid, ax, ay, info.ClusterA);
+        int32_t b = AddPathNode(grid, ax + info.SideX, ay + info.SideY, info.ClusterB);
+        grid.Nodes[a].Peer = b;
+        grid.Nodes[b].Peer = a;
+
+        grid.BorderNodes[border].push_back(a);
+        grid.BorderNodes[border].push_back(b);
+    }
+
+    // places entrances on every open run along a border, short runs get one in the middle and long runs one at each end
+    static void BuildBorder(PathGrid& grid, int border)
+    {
+        PathBorder info = GetBorder(grid, border);
+
+        int runStart = -1;
+        for (int i = 0; i <= info.Length; i++)
+        {
+            bool open = false;
+            if (i < info.Length)
+            {
+                int x = info.X + info.StepX * i;
+                int y = info.Y + info.StepY * i;
+                open = !grid.IsBlocked(x, y) && !grid.IsBlocked(x + info.SideX, y + info.SideY);
+            }
+
+            if (open)
+            {
+                if (runStart < 0)
+                    runStart = i;
+                continue;
+            }
+
+            if (runStart < 0)
+                continue;
+
+            int runLength = i - runStart;
+            if (runLength < 6)
+            {
+                AddTransition(grid, border, info, runStart + runLength / 2);
+            }
+            else
+            {
+                AddTransition(grid, border, info, runStart);
+                AddTransition(grid, border, info, i - 1);
+            }
+            runStart = -1;
+        }
+    }
+
+    static void ClearBorder(PathGrid& grid, int border)
+    {
+        for (int32_t id : grid.BorderNodes[border])
+        {
+            PathNode& node = grid.Nodes[id];
+            node.Alive = false;
+            node.Peer = -1;
+            node.Edges.clear();
+            grid.FreeNodes.push_back(id);
+        }
+        grid.BorderNodes[border].clear();
+    }
+
+    // searches the cells of one cluster. With a goal it is an A* search that stops at the goal,
+    // with a goal of -1 it is a Dijkstra search that reaches every cell it can
+    static float SearchCluster(const PathGrid& grid, PathScratch& scratch, const PathClusterBounds& bounds, int startX, int startY, int goalX, int goalY)
+    {
+        size_t cellCount = size_t(bounds.Width) * bounds.Height;
+        BeginGeneration(scratch.CellStamp, scratch.CellGeneration, cellCount);
+        if (scratch.CellCost.size() < cellCount)
+        {
+            scratch.CellCost.resize(cellCount);
+            scratch.CellParent.resize(cellCount);
+        }
+
+        bool hasGoal = goalX >= 0;
+        int32_t goalIndex = hasGoal ? bounds.GetIndex(goalX, goalY) : -1;
+
+        int32_t startIndex = bounds.GetIndex(startX, startY);
+        scratch.CellCost[startIndex] = 0;
+        scratch.CellParent[startIndex] = -1;
+        scratch.CellStamp[startIndex] = scratch.CellGeneration;
+
+        scratch.Open.clear();
+        scratch.Open.push_back({ hasGoal ? GetOctileDistance(startX, startY, goalX, goalY) : 0.0f, 0.0f, startIndex });
+
+        while (!scratch.Open.empty())
+        {
+            std::pop_heap(scratch.Open.begin(), scratch.Open.end());
+            PathOpenEntry entry = scratch.Open.back();
+            scratch.Open.pop_back();
+
+            if (entry.Cost > scratch.CellCost[entry.Index])
+                continue;
+
+            if (entry.Index == goalIndex)
+                return entry.Cost;
+
+            int x = bounds.X + entry.Index % bounds.Width;
+            int y = bounds.Y + entry.Index / bounds.Width;
+
+            for (int i = 0; i < 8; i++)
+            {
+                int dx = NeighborOffsets[i][0];
+                int dy = NeighborOffsets[i][1];
+                int nx = x + dx;
+                int ny = y + dy;
+                if (!bounds.Contains(nx, ny) || grid.IsBlocked(nx, ny))
+                    continue;
+
+                float step = 1;
+                if (dx != 0 && dy != 0)
+                {
+                    // no cutting corners
+                    if (grid.IsBlocked(x + dx, y) || grid.IsBlocked(x, y + dy))
+                        continue;
+                    step = DiagonalCost;
+                }
+
+                float cost = entry.Cost + step;
+                int32_t index = bounds.GetIndex(nx, ny);
+                if (scratch.CellStamp[index] == scratch.CellGeneration && scratch.CellCost[index] <= cost)
+                    continue;
+
+                scratch.CellStamp[index] = scratch.CellGeneration;
+                scratch.CellCost[index] = cost;
+                scratch.CellParent[index] = entry.Index;
+
+                float estimate = cost + (hasGoal ? GetOctileDistance(nx, ny, goalX, goalY) : 0.0f);
+                scratch.Open.push_back({ estimate, cost, index });
+                std::push_heap(scratch.Open.begin(), scratch.Open.end());
+            }
+        }
+
+        return -1;
+    }
+
+    // the cost to a cell found by the last cluster search, -1 if it was not reached
+    static float GetSearchCost(const PathScratch& scratch, const PathClusterBounds& bounds, int x, int y)
+    {
+        int32_t index = bounds.GetIndex(x, y);
+        if (scratch.CellStamp[index] != scratch.CellGeneration)
+            return -1;
+        return scratch.CellCost[index];
+    }
+
+    static void GetClusterNodes(const PathGrid& grid, int cluster, std::vector<int32_t>& nodes)
+    {
+        nodes.clear();
+
+        int borders[4];
+        int borderCount = GetClusterBorders(grid, cluster, borders);
+        for (int i = 0; i < borderCount; i++)
+        {
+            for (int32_t id : grid.BorderNodes[borders[i]])
+            {
+                if (grid.Nodes[id].Cluster == cluster)
+                    nodes.push_back(id);
+            }
+        }
+    }
+
+    // finds the cost between every pair of entrances in a cluster, only the nodes of this cluster are written
+    static void BuildClusterEdges(PathGrid& grid, PathScratch& scratch, int cluster)
+    {
+        PathClusterBounds bounds = GetClusterBounds(grid, cluster);
+        GetClusterNodes(grid, cluster, scratch.ClusterNodes);
+
+        for (int32_t id : scratch.ClusterNodes)
+        {
+            PathNode& node = grid.Nodes[id];
+            node.Edges.clear();
+
+            SearchCluster(grid, scratch, bounds, node.X, node.Y, -1, -1);
+            for (int32_t otherId : scratch.ClusterNodes)
+            {
+                if (otherId == id)
+                    continue;
+
+                const PathNode& other = grid.Nodes[otherId];
+                float cost = GetSearchCost(scratch, bounds, other.X, other.Y);
+                if (cost >= 0)
+                    node.Edges.push_back({ otherId, cost });
+            }
+        }
+    }
+
+    static void BuildClustersEdges(PathGrid& grid, const std::vector<int>& clusters)
+    {
+        ParallelFor(clusters.size(), 4, [&](size_t start, size_t end)
+            {
+                PathScratchLease lease(grid);
+                for (size_t i = start; i < end; i++)
+                    BuildClusterEdges(grid, *lease.Scratch, clusters[i]);
+            });
+    }
+
+    static void UpdateBlockedCells(const TileMap& map, PathGrid& grid, int x, int y, int width, int height)
+    {
+        // shrink each cell a little so things that only touch its edge do not block it
+        float insetX = grid.CellSize.x * 0.01f;
+        float insetY = grid.CellSize.y * 0.01f;
+
+        ParallelFor(size_t(height), 8, [&](size_t start, size_t end)
+            {
+                for (size_t row = start; row < end; row++)
+                {
+                    int cellY = y + int(row);
+                    for (int cellX = x; cellX < x + width; cellX++)
+                    {
+                        Rectangle rect = { cellX * grid.CellSize.x + insetX, cellY * grid.CellSize.y + insetY, grid.CellSize.x - insetX * 2, grid.CellSize.y - insetY * 2 };
+                        grid.Blocked[size_t(cellY) * grid.Width + cellX] = HasCollision(map, rect) ? 1 : 0;
+                    }
+                }
+            });
+    }
+
+    static const TileLayer* FindPathLayer(const TileMap& map)
+    {
+        const TileLayer* first = nullptr;
+        for (auto& layer : map.Layers)
+        {
+            if (layer->Type != TileLayerType::Tile)
+                continue;
+
+            const TileLayer* tileLayer = static_cast<const TileLayer*>(layer.get());
+            if (tileLayer->CheckForCollisions)
+                return tileLayer;
+
+            if (!first)
+                first = tileLayer;
+        }
+        return first;
+    }
+
+    bool BuildPathGrid(const TileMap& map, PathGrid& grid, int clusterSize)
+    {
+        const TileLayer* layer = FindPathLayer(map);
+        if (!layer || layer->Bounds.x < 1 || layer->Bounds.y < 1)
+            return false;
+
+        std::unique_lock<std::shared_mutex> lock(grid.Lock);
+
+        grid.Width = int(layer->Bounds.x);
+        grid.Height = int(layer->Bounds.y);
+        grid.CellSize = layer->TileSize;
+        grid.ClusterSize = std::max(clusterSize, 2);
+        grid.ClustersX = (grid.Width + grid.ClusterSize - 1) / grid.ClusterSize;
+        grid.ClustersY = (grid.Height + grid.ClusterSize - 1) / grid.ClusterSize;
+
+        grid.Blocked.assign(size_t(grid.Width) * grid.Height, 0);
+        UpdateBlockedCells(map, grid, 0, 0, grid.Width, grid.Height);
+
+        grid.Nodes.clear();
+        grid.FreeNodes.clear();
+        grid.BorderNodes.clear();
+        grid.BorderNodes.resize(size_t(GetVerticalBorderCount(grid)) + size_t(grid.ClustersX) * (grid.ClustersY - 1));
+
+        for (int border = 0; border < int(grid.BorderNodes.size()); border++)
+            BuildBorder(grid, border);
+
+        std::vector<int> clusters(size_t(grid.ClustersX) * grid.ClustersY);
+        for (int i = 0; i < int(clusters.size()); i++)
+            clusters[i] = i;
+
+        BuildClustersEdges(grid, clusters);
+        return true;
+    }
+
+    void UpdatePathGrid(const TileMap& map, PathGrid& grid, int x, int y, int width, int height)
+    {
+        std::unique_lock<std::shared_mutex> lock(grid.Lock);
+
+        int minX = std::max(x, 0);
+        int minY = std::max(y, 0);
+        int maxX = std::min(x + width, grid.Width);
+        int maxY = std::min(y + height, grid.Height);
+        if (minX >= maxX || minY >= maxY)
+            return;
+
+        UpdateBlockedCells(map, grid, minX, minY, maxX - minX, maxY - minY);
+
+        // a cell on the edge of a cluster changes the entrances of its neighbor too, so grow the area by one cell
+        int minClusterX = std::max(minX - 1, 0) / grid.ClusterSize;
+        int minClusterY = std::max(minY - 1, 0) / grid.ClusterSize;
+        int maxClusterX = std::min(maxX, grid.Width - 1) / grid.ClusterSize;
+        int maxClusterY = std::min(maxY, grid.Height - 1) / grid.ClusterSize;
+
+        std::vector<int> borders;
+        for (int cy = minClusterY; cy <= maxClusterY; cy++)
+        {
+            for (int cx = minClusterX; cx <= maxClusterX; cx++)
+            {
+                int clusterBorders[4];
+                int count = GetClusterBorders(grid, cy * grid.ClustersX + cx, clusterBorders);
+                borders.insert(borders.end(), clusterBorders, clusterBorders + count);
+            }
+        }
+        std::sort(borders.begin(), borders.end());
+        borders.erase(std::unique(borders.begin(), borders.end()), borders.end());
+
+        for (int border : borders)
+            ClearBorder(grid, border);
+
+        std::vector<int> clusters;
+        for (int border : borders)
+        {
+            BuildBorder(grid, border);
+
+            PathBorder info = GetBorder(grid, border);
+            clusters.push_back(info.ClusterA);
+            clusters.push_back(info.ClusterB);
+        }
+        for (int cy = minClusterY; cy <= maxClusterY; cy++)
+        {
+            for (int cx = minClusterX; cx <= maxClusterX; cx++)
+                clusters.push_back(cy * grid.ClustersX + cx);
+        }
+        std::sort(clusters.begin(), clusters.end());
+        clusters.erase(std::unique(clusters.begin(), clusters.end()), clusters.end());
+
+        BuildClustersEdges(grid, clusters);
+    }
+
+    static Vector2 GetCellCenter(const PathGrid& grid, int x, int y)
+    {
+        return Vector2{ (x + 0.5f) * grid.CellSize.x, (y + 0.5f) * grid.CellSize.y };
+    }
+
+    // adds the cells of the last cluster search from the start to a cell, without the start cell
+    static void AppendClusterPath(const PathGrid& grid, PathScratch& scratch, const PathClusterBounds& bounds, int x, int y, std::vector<Vector2>& path)
+    {
+        scratch.Cells.clear();
+        for (int32_t index = bounds.GetIndex(x, y); scratch.CellParent[index] >= 0; index = scratch.CellParent[index])
+            scratch.Cells.push_back(index);
+
+        for (auto itr = scratch.Cells.rbegin(); itr != scratch.Cells.rend(); ++itr)
+            path.push_back(GetCellCenter(grid, bounds.X + *itr % bounds.Width, bounds.Y + *itr / bounds.Width));
+    }
+
+    // connects a cell to the entrances of its cluster
+    static void ConnectToCluster(const PathGrid& grid, PathScratch& scratch, int x, int y, std::vector<PathNode::Edge>& edges)
+    {
+        edges.clear();
+
+        int cluster = GetCluster(grid, x, y);
+        PathClusterBounds bounds = GetClusterBounds(grid, cluster);
+        SearchCluster(grid, scratch, bounds, x, y, -1, -1);
+
+        GetClusterNodes(grid, cluster, scratch.ClusterNodes);
+        for (int32_t id : scratch.ClusterNodes)
+        {
+            float cost = GetSearchCost(scratch, bounds, grid.Nodes[id].X, grid.Nodes[id].Y);
+            if (cost >= 0)
+                edges.push_back({ id, cost });
+        }
+    }
+
+    // A* over the entrances, the start and goal are the two ids after the last node. Fills the route from the start to the goal
+    static bool SearchClusterGraph(const PathGrid& grid, PathScratch& scratch, int goalX, int goalY)
+    {
+        int32_t startId = int32_t(grid.Nodes.size());
+        int32_t goalId = startId + 1;
+        size_t nodeCount = grid.Nodes.size() + 2;
+
+        BeginGeneration(scratch.NodeStamp, scratch.NodeGeneration, nodeCount);
+        if (scratch.NodeCost.size() < nodeCount)
+        {
+            scratch.NodeCost.resize(nodeCount);
+            scratch.NodeParent.resize(nodeCount);
+        }
+
+        scratch.NodeCost[startId] = 0;
+        scratch.NodeParent[startId] = -1;
+        scratch.NodeStamp[startId] = scratch.NodeGeneration;
+
+        scratch.Open.clear();
+        scratch.Open.push_back({ 0.0f, 0.0f, startId });
+
+        auto visit = [&](int32_t from, int32_t to, float cost)
+            {
+                if (scratch.NodeStamp[to] == scratch.NodeGeneration && scratch.NodeCost[to] <= cost)
+                    return;
+
+                scratch.NodeStamp[to] = scratch.NodeGeneration;
+                scratch.NodeCost[to] = cost;
+                scratch.NodeParent[to] = from;
+
+                float estimate = cost;
+                if (to != goalId)
+                    estimate += GetOctileDistance(grid.Nodes[to].X, grid.Nodes[to].Y, goalX, goalY);
+
+                scratch.Open.push_back({ estimate, cost, to });
+                std::push_heap(scratch.Open.begin(), scratch.Open.end());
+            };
+
+        while (!scratch.Open.empty())
+        {
+            std::pop_heap(scratch.Open.begin(), scratch.Open.end());
+            PathOpenEntry entry = scratch.Open.back();
+            scratch.Open.pop_back();
+
+            if (entry.Cost > scratch.NodeCost[entry.Index])
+                continue;
+
+            if (entry.Index == goalId)
+            {
+                scratch.Route.clear();
+                for (int32_t id = goalId; id >= 0; id = scratch.NodeParent[id])
+                    scratch.Route.push_back(id);
+                std::reverse(scratch.Route.begin(), scratch.Route.end());
+                return true;
+            }
+
+            if (entry.Index == startId)
+            {
+                for (const auto& edge : scratch.StartEdges)
+                    visit(startId, edge.Node, edge.Cost);
+                continue;
+            }
+
+            const PathNode& node = grid.Nodes[entry.Index];
+            visit(entry.Index, node.Peer, entry.Cost + 1);
+
+            for (const auto& edge : node.Edges)
+                visit(entry.Index, edge.Node, entry.Cost + edge.Cost);
+
+            for (const auto& edge : scratch.GoalEdges)
+            {
+                if (edge.Node == entry.Index)
+                    visit(entry.Index, goalId, entry.Cost + edge.Cost);
+            }
+        }
+
+        return false;
+    }
+
+    bool FindPath(const PathGrid& grid, Vector2 start, Vector2 goal, std::vector<Vector2>& path)
+    {
+        path.clear();
+
+        std::shared_lock<std::shared_mutex> lock(grid.Lock);
+        if (grid.Width <= 0 || grid.CellSize.x <= 0 || grid.CellSize.y <= 0)
+            return false;
+
+        int startX = int(floorf(start.x / grid.CellSize.x));
+        int startY = int(floorf(start.y / grid.CellSize.y));
+        int goalX = int(floorf(goal.x / grid.CellSize.x));
+        int goalY = int(floorf(goal.y / grid.CellSize.y));
+        if (grid.IsBlocked(startX, startY) || grid.IsBlocked(goalX, goalY))
+            return false;
+
+        path.push_back(GetCellCenter(grid, startX, startY));
+        if (startX == goalX && startY == goalY)
+            return true;
+
+        PathScratchLease lease(grid);
+        PathScratch& scratch = *lease.Scratch;
+
+        // paths that stay inside one cluster do not need the cluster graph
+        int startCluster = GetCluster(grid, startX, startY);
+        if (startCluster == GetCluster(grid, goalX, goalY))
+        {
+            PathClusterBounds bounds = GetClusterBounds(grid, startCluster);
+            if (SearchCluster(grid, scratch, bounds, startX, startY, goalX, goalY) >= 0)
+            {
+                AppendClusterPath(grid, scratch, bounds, goalX, goalY, path);
+                return true;
+            }
+        }
+
+        ConnectToCluster(grid, scratch, startX, startY, scratch.StartEdges);
+        ConnectToCluster(grid, scratch, goalX, goalY, scratch.GoalEdges);
+        if (scratch.StartEdges.empty() || scratch.GoalEdges.empty() || !SearchClusterGraph(grid, scratch, goalX, goalY))
+        {
+            path.clear();
+            return false;
+        }
+
+        // refine each step of the route, steps between entrances of the same cluster are searched inside that cluster
+        int fromX = startX;
+        int fromY = startY;
+        for (size_t i = 1; i < scratch.Route.size(); i++)
+        {
+            int32_t id = scratch.Route[i];
+            bool isGoal = id == int32_t(grid.Nodes.size()) + 1;
+            int toX = isGoal ? goalX : grid.Nodes[id].X;
+            int toY = isGoal ? goalY : grid.Nodes[id].Y;
+
+            if (toX == fromX && toY == fromY)
+                continue;
+
+            int fromCluster = GetCluster(grid, fromX, fromY);
+            if (fromCluster != GetCluster(grid, toX, toY))
+            {
+                // crossing a border between two entrances
+                path.push_back(GetCellCenter(grid, toX, toY));
+            }
+            else
+            {
+                PathClusterBounds bounds = GetClusterBounds(grid, fromCluster);
+                SearchCluster(grid, scratch, bounds, fromX, fromY, toX, toY);
+                AppendClusterPath(grid, scratch, bounds, toX, toY, path);
+            }
+
+            fromX = toX;
+            fromY = toY;
+        }
+
+        return true;
+    }
+}
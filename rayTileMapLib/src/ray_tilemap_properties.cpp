@@ -0,0 +1,221 @@
+/**********************************************************************************************
+*
+*   RayTileMap
+*
+*   LICENSE: MIT
+*
+*   Copyright (c) 2024 Jeffery Myers
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "ray_tilemap.h"
+
+#include <cstring>
+#include <deque>
+#include <mutex>
+
+namespace RayTiled
+{
+    // property names are interned for the whole program, so keys from GetPropertyKey work with any map
+    struct PropertyKeyTable
+    {
+        std::mutex Lock;                                    // maps load on the loader thread
+        std::unordered_map<std::string, PropertyKey> Keys;
+        std::deque<std::string> Names;                      // indexed by key - 1, a deque so returned names never move
+    };
+
+    static PropertyKeyTable KeyTable;
+
+    PropertyKey GetPropertyKey(const std::string& name)
+    {
+        std::lock_guard<std::mutex> guard(KeyTable.Lock);
+        auto itr = KeyTable.Keys.find(name);
+        if (itr != KeyTable.Keys.end())
+            return itr->second;
+
+        KeyTable.Names.push_back(name);
+        PropertyKey key = PropertyKey(KeyTable.Names.size());
+        KeyTable.Keys.emplace(name, key);
+        return key;
+    }
+
+    const std::string& GetPropertyName(PropertyKey key)
+    {
+        static const std::string empty;
+
+        std::lock_guard<std::mutex> guard(KeyTable.Lock);
+        if (key == 0 || key > KeyTable.Names.size())
+            return empty;
+
+        return KeyTable.Names[key - 1];
+    }
+
+    static size_t GetPropertySlot(uint64_t owner, PropertyKey key, size_t mask)
+    {
+        uint64_t hash = (owner ^ (uint64_t(key) << 40) ^ key) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 32;
+        return size_t(hash) & mask;
+    }
+
+    const Property* PropertyStore::Find(uint64_t owner, PropertyKey key) const
+    {
+        if (Slots.empty())
+            return nullptr;
+
+        size_t mask = Slots.size() - 1;
+        for (size_t slot = GetPropertySlot(owner, key, mask); Slots[slot] != 0; slot = (slot + 1) & mask)
+        {
+            const Property& property = Properties[Slots[slot] - 1];
+            if (property.Owner == owner && property.Key == key)
+                return &property;
+        }
+
+        return nullptr;
+    }
+
+    Property& PropertyStore::Add(uint64_t owner, PropertyKey key)
+    {
+        const Property* existing = Find(owner, key);
+        if (existing != nullptr)
+        {
+            Property& property = Properties[existing - Properties.data()];
+            property = Property();
+            property.Owner = owner;
+            property.Key = key;
+            return property;
+        }
+
+        Property& property = Properties.emplace_back();
+        property.Owner = owner;
+        property.Key = key;
+
+        // keep the table at most half full so probes stay short
+        if (Properties.size() * 2 > Slots.size())
+        {
+            Rehash();
+        }
+        else
+        {
+            size_t mask = Slots.size() - 1;
+            size_t slot = GetPropertySlot(owner, key, mask);
+            while (Slots[slot] != 0)
+                slot = (slot + 1) & mask;
+
+            Slots[slot] = uint32_t(Properties.size());
+        }
+
+        return property;
+    }
+
+    void PropertyStore::SetText(Property& property, const char* text)
+    {
+        property.TextOffset = uint32_t(Text.size());
+        Text.insert(Text.end(), text, text + strlen(text) + 1);
+    }
+
+    void PropertyStore::Rehash()
+    {
+        size_t size = 16;
+        while (size < Properties.size() * 2)
+            size *= 2;
+
+        Slots.assign(size, 0);
+
+        size_t mask = size - 1;
+        for (size_t index = 0; index < Properties.size(); index++)
+        {
+            size_t slot = GetPropertySlot(Properties[index].Owner, Properties[index].Key, mask);
+            while (Slots[slot] != 0)
+                slot = (slot + 1) & mask;
+
+            Slots[slot] = uint32_t(index + 1);
+        }
+    }
+
+    void PropertyStore::Clear()
+    {
+        Properties.clear();
+        Text.clear();
+        Slots.clear();
+    }
+
+    int GetPropertyInt(const TileMap& map, uint64_t owner, PropertyKey key, int defaultValue)
+    {
+        const Property* property = map.Properties.Find(owner, key);
+        if (property == nullptr)
+            return defaultValue;
+
+        switch (property->Type)
+        {
+        case PropertyType::Int:
+        case PropertyType::Bool:
+        case PropertyType::Object:
+            return property->IntValue;
+        case PropertyType::Float:
+            return int(property->FloatValue);
+        default:
+            return defaultValue;
+        }
+    }
+
+    float GetPropertyFloat(const TileMap& map, uint64_t owner, PropertyKey key, float defaultValue)
+    {
+        const Property* property = map.Properties.Find(owner, key);
+        if (property == nullptr)
+            return defaultValue;
+
+        if (property->Type == PropertyType::Float)
+            return property->FloatValue;
+
+        if (property->Type == PropertyType::Int)
+            return float(property->IntValue);
+
+        return defaultValue;
+    }
+
+    bool GetPropertyBool(const TileMap& map, uint64_t owner, PropertyKey key, bool defaultValue)
+    {
+        const Property* property = map.Properties.Find(owner, key);
+        if (property == nullptr || (property->Type != PropertyType::Bool && property->Type != PropertyType::Int))
+            return defaultValue;
+
+        return property->IntValue != 0;
+    }
+
+    Color GetPropertyColor(const TileMap& map, uint64_t owner, PropertyKey key, Color defaultValue)
+    {
+        const Property* property = map.Properties.Find(owner, key);
+        if (property == nullptr || property->Type != PropertyType::Color)
+            return defaultValue;
+
+        return property->ColorValue;
+    }
+
+    const char* GetPropertyString(const TileMap& map, uint64_t owner, PropertyKey key, const char* defaultValue)
+    {
+        const Property* property = map.Properties.Find(owner, key);
+        if (property == nullptr || (property->Type != PropertyType::String && property->Type != PropertyType::File))
+            return defaultValue;
+
+        return map.Properties.GetText(*property);
+    }
+}
@@ -0,0 +1,543 @@
+/**********************************************************************************************
+*
+*   RayTileMap
+*
+*   LICENSE: MIT
+*
+*   Copyright (c) 2024 Jeffery Myers
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "ray_tilemap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+namespace RayTiled
+{
+    using ParallelJob = std::function<void(size_t start, size_t end)>;
+    void ParallelFor(size_t count, size_t grain, const ParallelJob& func);
+
+    static constexpr float NoHit = std::numeric_limits<float>::infinity();
+
+    // the normalized ray that all the shape tests work with
+    struct RayState
+    {
+        Vector2 Origin = { 0, 0 };
+        Vector2 Direction = { 0, 0 };
+        float MaxDistance = 0;
+        bool AnyHit = false;        // stop at the first hit instead of the closest one
+    };
+
+    static bool SetupRay(const TileRay& ray, RayState& state)
+    {
+        float length = Vector2Length(ray.Direction);
+        if (length <= 0 || ray.MaxDistance < 0)
+            return false;
+
+        state.Origin = ray.Origin;
+        state.Direction = Vector2Scale(ray.Direction, 1.0f / length);
+        state.MaxDistance = ray.MaxDistance;
+        return true;
+    }
+
+    static void SetHit(const RayState& ray, float distance, Vector2 normal, RaycastHit& hit)
+    {
+        hit.Hit = true;
+        hit.Distance = distance;
+        hit.Point = Vector2Add(ray.Origin, Vector2Scale(ray.Direction, distance));
+
+        // rays that start inside a shape have no surface to report
+        if (distance <= 0)
+            normal = Vector2Negate(ray.Direction);
+
+        hit.Normal = normal;
+    }
+
+    static bool IsSolidCell(const TileMap& map, const TileLayer& layer, int x, int y, uint16_t& tile, const TileLookupEntry*& lookup)
+    {
+        if (layer.Sparse)
+        {
+            const TileLayerChunk* chunk = layer.FindChunk(x / layer.ChunkWidth, y / layer.ChunkHeight);
+            if (chunk == nullptr)
+                return false;
+
+            int localX = x % layer.ChunkWidth;
+            int localY = y % layer.ChunkHeight;
+            if (!chunk->SolidRows.empty() && (chunk->SolidRows[localY] & (uint64_t(1) << localX)) == 0)
+                return false;
+
+            tile = chunk->TileData[size_t(localY) * layer.ChunkWidth + localX].TileIndex;
+            lookup = tile != 0 ? GetTileLookup(map, tile) : nullptr;
+            return lookup != nullptr;
+        }
+
+        if (!layer.CollisionMask.empty())
+        {
+            uint64_t word = layer.CollisionMask[size_t(y) * layer.CollisionMaskStride + x / 64];
+            if ((word & (uint64_t(1) << (x % 64))) == 0)
+                return false;
+        }
+
+        tile = layer.GetTileData()[size_t(y) * int(layer.Bounds.x) + x].TileIndex;
+        lookup = tile != 0 ? GetTileLookup(map, tile) : nullptr;
+        return lookup != nullptr;
+    }
+
+    // clips the ray to an axis of a box, keeping track of the face the ray enters through
+    static bool ClipAxis(float origin, float direction, float minValue, float maxValue, float& enter, float& exit, float& enterNormal, bool& enteredOnAxis)
+    {
+        if (direction == 0)
+            return origin >= minValue && origin <= maxValue;
+
+        float t1 = (minValue - origin) / direction;
+        float t2 = (maxValue - origin) / direction;
+        float normal = -1;
+
+        if (t1 > t2)
+        {
+            std::swap(t1, t2);
+            normal = 1;
+        }
+
+        if (t1 > enter)
+        {
+            enter = t1;
+            enterNormal = normal;
+            enteredOnAxis = true;
+        }
+
+        exit = std::min(exit, t2);
+        return enter <= exit;
+    }
+
+    // ray against an axis aligned box, returns the entry distance and face
+    static float RaycastBox(const RayState& ray, const Rectangle& box, float maxDistance, Vector2& normal, float* exitDistance = nullptr)
+    {
+        float enter = 0;
+        float exit = maxDistance;
+        float normalX = 0, normalY = 0;
+        bool onX = false, onY = false;
+
+        if (!ClipAxis(ray.Origin.x, ray.Direction.x, box.x, box.x + box.width, enter, exit, normalX, onX))
+            return NoHit;
+
+        if (!ClipAxis(ray.Origin.y, ray.Direction.y, box.y, box.y + box.height, enter, exit, normalY, onY))
+            return NoHit;
+
+        // the axis that was clipped last is the one the ray entered through
+        if (onY)
+            normal = { 0, normalY };
+        else if (onX)
+            normal = { normalX, 0 };
+        else
+            normal = { 0, 0 };
+
+        if (exitDistance)
+            *exitDistance = exit;
+
+        return enter;
+    }
+
+    static float RaycastEllipse(const RayState& ray, const Rectangle& bounds, float maxDistance, Vector2& normal)
+    {
+        float radiusX = bounds.width * 0.5f;
+        float radiusY = bounds.height * 0.5f;
+        if (radiusX <= 0 || radiusY <= 0)
+            return NoHit;
+
+        Vector2 center = { bounds.x + radiusX, bounds.y + radiusY };
+
+        // scale the ellipse into a unit circle and solve the quadratic there
+        Vector2 origin = { (ray.Origin.x - center.x) / radiusX, (ray.Origin.y - center.y) / radiusY };
+        Vector2 direction = { ray.Direction.x / radiusX, ray.Direction.y / radiusY };
+
+        float a = Vector2DotProduct(direction, direction);
+        float b = 2 * Vector2DotProduct(origin, direction);
+        float c = Vector2DotProduct(origin, origin) - 1;
+
+        if (c <= 0)
+        {
+            normal = { 0, 0 };
+            return 0;
+        }
+
+        float discriminant = b * b - 4 * a * c;
+        if (discriminant < 0)
+            return NoHit;
+
+        float t = (-b - std::sqrt(discriminant)) / (2 * a);
+        if (t < 0 || t > maxDistance)
+            return NoHit;
+
+        Vector2 point = Vector2Add(origin, Vector2Scale(direction, t));
+        normal = Vector2Normalize(Vector2{ point.x / radiusX, point.y / radiusY });
+        return t;
+    }
+
+    static float RaycastPolygon(const RayState& ray, const Vector2* points, size_t count, Vector2 offset, float maxDistance, Vector2& normal)
+    {
+        if (count < 3)
+            return NoHit;
+
+        float best = NoHit;
+        bool inside = false;
+
+        for (size_t i = 0, j = count - 1; i < count; j = i++)
+        {
+            Vector2 start = Vector2Add(points[j], offset);
+            Vector2 end = Vector2Add(points[i], offset);
+
+            // even-odd test for rays that start inside
+            if ((end.y > ray.Origin.y) != (start.y > ray.Origin.y)
+                && ray.Origin.x < (start.x - end.x) * (ray.Origin.y - end.y) / (start.y - end.y) + end.x)
+            {
+                inside = !inside;
+            }
+
+            Vector2 edge = Vector2Subtract(end, start);
+            float denominator = ray.Direction.x * edge.y - ray.Direction.y * edge.x;
+            if (denominator == 0)
+                continue;
+
+            Vector2 toStart = Vector2Subtract(start, ray.Origin);
+            float t = (toStart.x * edge.y - toStart.y * edge.x) / denominator;
+            float u = (toStart.x * ray.Direction.y - toStart.y * ray.Direction.x) / denominator;
+
+            if (t < 0 || t > maxDistance || u < 0 || u > 1 || t >= best)
+                continue;
+
+            best = t;
+            normal = Vector2Normalize(Vector2{ edge.y, -edge.x });
+            if (Vector2DotProduct(normal, ray.Direction) > 0)
+                normal = Vector2Negate(normal);
+        }
+
+        if (inside)
+        {
+            normal = { 0, 0 };
+            return 0;
+        }
+
+        return best;
+    }
+
+    static float RaycastPolygon(const RayState& ray, const ObjectLayer::PolygonObject& polygon, float maxDistance, Vector2& normal)
+    {
+        return RaycastPolygon(ray, polygon.Points.data(), polygon.Points.size(), Vector2{ polygon.Bounds.x, polygon.Bounds.y }, maxDistance, normal);
+    }
+
+    // ray against the collision shapes of the tile in a cell, the same shapes that GetCollisions tests
+    static float RaycastCellShapes(const TileLayer& layer, const RayState& ray, int x, int y, float maxDistance, Vector2& normal)
+    {
+        const TileShapeIndex& index = layer.CollisionShapes;
+
+        auto itr = index.CellShapes.find((uint64_t(uint32_t(x)) << 32) | uint64_t(uint32_t(y)));
+        if (itr == index.CellShapes.end())
+            return NoHit;
+
+        float best = NoHit;
+        for (uint32_t shapeIndex : itr->second)
+        {
+            const TileShapeInstance& shape = index.Shapes[shapeIndex];
+
+            Vector2 shapeNormal = { 0, 0 };
+            float distance = NoHit;
+
+            switch (shape.Type)
+            {
+            case TileShapeType::Rectangle:
+                distance = RaycastBox(ray, shape.Bounds, maxDistance, shapeNormal);
+                break;
+
+            case TileShapeType::Ellipse:
+                distance = RaycastEllipse(ray, shape.Bounds, maxDistance, shapeNormal);
+                break;
+
+            case TileShapeType::Polygon:
+                distance = RaycastPolygon(ray, index.Points.data() + shape.FirstPoint, shape.PointCount, Vector2{ 0, 0 }, maxDistance, shapeNormal);
+                break;
+            }
+
+            if (distance < best)
+            {
+                best = distance;
+                maxDistance = distance;
+                normal = shapeNormal;
+            }
+        }
+
+        return best;
+    }
+
+    // Amanatides-Woo traversal, visiting every cell the ray passes through in order
+    static bool RaycastTiles(const TileMap& map, const TileLayer& layer, const RayState& ray, float maxDistance, RaycastHit& hit)
+    {
+        int width = int(layer.Bounds.x);
+        int height = int(layer.Bounds.y);
+        float tileWidth = layer.TileSize.x;
+        float tileHeight = layer.TileSize.y;
+
+        if (width <= 0 || height <= 0 || tileWidth <= 0 || tileHeight <= 0 || (!layer.Sparse && layer.GetTileData() == nullptr))
+            return false;
+
+        // start where the ray enters the layer
+        Vector2 normal = { 0, 0 };
+        float exit = maxDistance;
+        float distance = RaycastBox(ray, Rectangle{ 0, 0, width * tileWidth, height * tileHeight }, maxDistance, normal, &exit);
+        if (distance == NoHit)
+            return false;
+
+        Vector2 start = Vector2Add(ray.Origin, Vector2Scale(ray.Direction, distance));
+        int x = std::clamp(int(std::floor(start.x / tileWidth)), 0, width - 1);
+        int y = std::clamp(int(std::floor(start.y / tileHeight)), 0, height - 1);
+
+        int stepX = ray.Direction.x > 0 ? 1 : (ray.Direction.x < 0 ? -1 : 0);
+        int stepY = ray.Direction.y > 0 ? 1 : (ray.Direction.y < 0 ? -1 : 0);
+
+        float deltaX = stepX != 0 ? tileWidth / std::fabs(ray.Direction.x) : NoHit;
+        float deltaY = stepY != 0 ? tileHeight / std::fabs(ray.Direction.y) : NoHit;
+
+        float nextX = NoHit;
+        if (stepX != 0)
+            nextX = ((x + (stepX > 0 ? 1 : 0)) * tileWidth - ray.Origin.x) / ray.Direction.x;
+
+        float nextY = NoHit;
+        if (stepY != 0)
+            nextY = ((y + (stepY > 0 ? 1 : 0)) * tileHeight - ray.Origin.y) / ray.Direction.y;
+
+        // tiles with collision shapes are hit where the ray meets a shape, which can be past the cell, so keep walking until the cells are further away
+        float shapeDistance = NoHit;
+        Vector2 shapeNormal = { 0, 0 };
+        uint16_t shapeTile = 0;
+        int shapeX = 0;
+        int shapeY = 0;
+
+        while (distance <= shapeDistance)
+        {
+            uint16_t tile = 0;
+            const TileLookupEntry* lookup = nullptr;
+            if (IsSolidCell(map, layer, x, y, tile, lookup))
+            {
+                if (lookup->CollisionShapes == nullptr)
+                {
+                    SetHit(ray, distance, normal, hit);
+                    hit.Type = TileLayerType::Tile;
+                    hit.ItemId = tile;
+                    hit.CellX = x;
+                    hit.CellY = y;
+                    hit.Layer = &layer;
+                    return true;
+                }
+
+                Vector2 cellNormal = { 0, 0 };
+                float cellDistance = RaycastCellShapes(layer, ray, x, y, std::min(shapeDistance, maxDistance), cellNormal);
+                if (cellDistance < shapeDistance)
+                {
+                    shapeDistance = cellDistance;
+                    shapeNormal = cellNormal;
+                    shapeTile = tile;
+                    shapeX = x;
+                    shapeY = y;
+
+                    if (ray.AnyHit)
+                        break;
+                }
+            }
+
+            if (nextX < nextY)
+            {
+                distance = nextX;
+                nextX += deltaX;
+                x += stepX;
+                normal = { float(-stepX), 0 };
+            }
+            else
+            {
+                distance = nextY;
+                nextY += deltaY;
+                y += stepY;
+                normal = { 0, float(-stepY) };
+            }
+
+            if (distance > exit || x < 0 || x >= width || y < 0 || y >= height)
+                break;
+        }
+
+        if (shapeDistance == NoHit)
+            return false;
+
+        SetHit(ray, shapeDistance, shapeNormal, hit);
+        hit.Type = TileLayerType::Tile;
+        hit.ItemId = shapeTile;
+        hit.CellX = shapeX;
+        hit.CellY = shapeY;
+        hit.Layer = &layer;
+        return true;
+    }
+
+    static bool RaycastObjects(const ObjectLayer& layer, const RayState& ray, float maxDistance, RaycastHit& hit)
+    {
+        Vector2 end = Vector2Add(ray.Origin, Vector2Scale(ray.Direction, maxDistance));
+        Rectangle area = { std::min(ray.Origin.x, end.x), std::min(ray.Origin.y, end.y), std::fabs(end.x - ray.Origin.x), std::fabs(end.y - ray.Origin.y) };
+
+        bool found = false;
+
+        layer.ForEachObjectInRect(area, [&](const ObjectLayer::Object& object)
+            {
+                Vector2 normal = { 0, 0 };
+                float distance = NoHit;
+
+                switch (object.Type)
+                {
+                case ObjectLayer::ObjectType::Generic:
+                    distance = RaycastBox(ray, object.Bounds, maxDistance, normal);
+                    break;
+
+                case ObjectLayer::ObjectType::Ellipse:
+                    distance = RaycastEllipse(ray, object.Bounds, maxDistance, normal);
+                    break;
+
+                case ObjectLayer::ObjectType::Polygon:
+                    distance = RaycastPolygon(ray, static_cast<const ObjectLayer::PolygonObject&>(object), maxDistance, normal);
+                    break;
+
+                default:
+                    break;
+                }
+
+                if (distance > maxDistance)
+                    return true;
+
+                maxDistance = distance;
+                found = true;
+
+                SetHit(ray, distance, normal, hit);
+                hit.Type = TileLayerType::Object;
+                hit.ItemId = object.Id;
+                hit.CellX = -1;
+                hit.CellY = -1;
+                hit.Layer = &layer;
+
+                return !ray.AnyHit;
+            });
+
+        return found;
+    }
+
+    static bool CastLayer(const TileMap& map, const LayerInfo& layer, const RayState& ray, RaycastHit& hit)
+    {
+        float maxDistance = hit.Hit ? std::min(hit.Distance, ray.MaxDistance) : ray.MaxDistance;
+
+        if (layer.Type == TileLayerType::Tile)
+        {
+            RaycastHit layerHit;
+            if (!RaycastTiles(map, static_cast<const TileLayer&>(layer), ray, maxDistance, layerHit))
+                return false;
+
+            if (hit.Hit && layerHit.Distance >= hit.Distance)
+                return false;
+
+            hit = layerHit;
+            return true;
+        }
+
+        if (layer.Type == TileLayerType::Object)
+            return RaycastObjects(static_cast<const ObjectLayer&>(layer), ray, maxDistance, hit);
+
+        return false;
+    }
+
+    static bool CastMap(const TileMap& map, const RayState& ray, RaycastHit& hit)
+    {
+        for (auto& layer : map.Layers)
+        {
+            if (!layer->CheckForCollisions)
+                continue;
+
+            if (CastLayer(map, *layer, ray, hit) && ray.AnyHit)
+                return true;
+        }
+
+        return hit.Hit;
+    }
+
+    bool RaycastLayer(const TileMap& map, const LayerInfo& layer, const TileRay& ray, RaycastHit& hit)
+    {
+        hit = RaycastHit();
+
+        RayState state;
+        if (!SetupRay(ray, state))
+            return false;
+
+        return CastLayer(map, layer, state, hit);
+    }
+
+    bool Raycast(const TileMap& map, const TileRay& ray, RaycastHit& hit)
+    {
+        hit = RaycastHit();
+
+        RayState state;
+        if (!SetupRay(ray, state))
+            return false;
+
+        return CastMap(map, state, hit);
+    }
+
+    bool LineOfSight(const TileMap& map, Vector2 from, Vector2 to)
+    {
+        TileRay ray;
+        ray.Origin = from;
+        ray.Direction = Vector2Subtract(to, from);
+        ray.MaxDistance = Vector2Length(ray.Direction);
+
+        RayState state;
+        if (!SetupRay(ray, state))
+            return true;
+
+        state.AnyHit = true;
+
+        RaycastHit hit;
+        return !CastMap(map, state, hit);
+    }
+
+    size_t RaycastBatch(const TileMap& map, const TileRay* rays, size_t count, RaycastHit* hits)
+    {
+        std::atomic<size_t> hitCount = 0;
+
+        ParallelFor(count, 64, [&](size_t start, size_t end)
+            {
+                size_t localHits = 0;
+                for (size_t i = start; i < end; i++)
+                {
+                    if (Raycast(map, rays[i], hits[i]))
+                        localHits++;
+                }
+
+                hitCount += localHits;
+            });
+
+        return hitCount;
+    }
+}
@@ -0,0 +1,196 @@
+/**********************************************************************************************
+*
+*   RayTileMap
+*
+*   LICENSE: MIT
+*
+*   Copyright (c) 2024 Jeffery Myers
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "ray_tilemap.h"
+
+#include <mutex>
+
+namespace RayTiled
+{
+    Texture2D LoadTextureFile(const TileMapLoadContext& context, const std::string& fullpath);
+
+    // one texture shared by every sheet that uses the same image file
+    struct CachedTexture
+    {
+        Texture2D Texture = { 0 };
+        int References = 0;
+        size_t Bytes = 0;
+        uint64_t LastUsed = 0;      // when the last reference was released, used to evict the oldest unreferenced texture first
+    };
+
+    // textures are shared by path, sheets hold a reference until the map is unloaded
+    struct TextureCache
+    {
+        std::mutex Lock;    // the loader thread checks what is resident
+        std::unordered_map<std::string, CachedTexture> Entries;
+        std::unordered_map<unsigned int, std::string> Paths;   // texture id to cache key, for releasing
+        size_t Budget = 0;
+        size_t TotalBytes = 0;
+        size_t UnreferencedBytes = 0;
+        uint64_t Clock = 0;
+    };
+
+    static TextureCache Cache;
+
+    static void EvictTexture(std::unordered_map<std::string, CachedTexture>::iterator itr)
+    {
+        Cache.TotalBytes -= itr->second.Bytes;
+        Cache.UnreferencedBytes -= itr->second.Bytes;
+        Cache.Paths.erase(itr->second.Texture.id);
+        UnloadTexture(itr->second.Texture);
+        Cache.Entries.erase(itr);
+    }
+
+    // unloads the oldest unreferenced textures until they fit in the budget
+    static void TrimTextureCache(size_t budget)
+    {
+        while (Cache.UnreferencedBytes > budget)
+        {
+            auto oldest = Cache.Entries.end();
+            for (auto itr = Cache.Entries.begin(); itr != Cache.Entries.end(); itr++)
+            {
+                if (itr->second.References == 0 && (oldest == Cache.Entries.end() || itr->second.LastUsed < oldest->second.LastUsed))
+                    oldest = itr;
+            }
+
+            if (oldest == Cache.Entries.end())
+                break;
+
+            EvictTexture(oldest);
+        }
+    }
+
+    static Texture2D AddReference(CachedTexture& entry)
+    {
+        if (entry.References == 0)
+            Cache.UnreferencedBytes -= entry.Bytes;
+
+        entry.References++;
+        return entry.Texture;
+    }
+
+    bool IsTextureCached(const std::string& fullpath)
+    {
+        std::lock_guard<std::mutex> guard(Cache.Lock);
+        return Cache.Entries.find(fullpath) != Cache.Entries.end();
+    }
+
+    bool AcquireCachedTexture(const std::string& fullpath, Texture2D& texture)
+    {
+        std::lock_guard<std::mutex> guard(Cache.Lock);
+        auto itr = Cache.Entries.find(fullpath);
+        if (itr == Cache.Entries.end())
+            return false;
+
+        texture = AddReference(itr->second);
+        return true;
+    }
+
+    // adds a texture loaded by the caller with one reference, if another load of the same file got there first that texture is used instead
+    Texture2D AddCachedTexture(const std::string& fullpath, Texture2D texture)
+    {
+        if (texture.id == 0)
+            return texture;
+
+        std::lock_guard<std::mutex> guard(Cache.Lock);
+        auto itr = Cache.Entries.find(fullpath);
+        if (itr != Cache.Entries.end())
+        {
+            UnloadTexture(texture);
+            return AddReference(itr->second);
+        }
+
+        CachedTexture& entry = Cache.Entries[fullpath];
+        entry.Texture = texture;
+        entry.References = 1;
+        entry.Bytes = size_t(GetPixelDataSize(texture.width, texture.height, texture.format));
+        Cache.Paths[texture.id] = fullpath;
+        Cache.TotalBytes += entry.Bytes;
+        return texture;
+    }
+
+    Texture2D AcquireTexture(const TileMapLoadContext& context, const std::string& fullpath)
+    {
+        Texture2D texture = { 0 };
+        if (AcquireCachedTexture(fullpath, texture))
+            return texture;
+
+        return AddCachedTexture(fullpath, LoadTextureFile(context, fullpath));
+    }
+
+    // drops a reference, when unload is false the texture stays resident even if it is over the budget
+    void ReleaseTexture(const Texture2D& texture, bool unload)
+    {
+        if (texture.id == 0)
+            return;
+
+        std::lock_guard<std::mutex> guard(Cache.Lock);
+        auto path = Cache.Paths.find(texture.id);
+        if (path == Cache.Paths.end())
+        {
+            // not from the cache, the game gave it to the map
+            if (unload)
+                UnloadTexture(texture);
+            return;
+        }
+
+        CachedTexture& entry = Cache.Entries[path->second];
+        if (entry.References == 0)
+            return;
+
+        entry.References--;
+        if (entry.References > 0)
+            return;
+
+        entry.LastUsed = ++Cache.Clock;
+        Cache.UnreferencedBytes += entry.Bytes;
+
+        if (unload)
+            TrimTextureCache(Cache.Budget);
+    }
+
+    void SetTileMapTextureBudget(size_t bytes)
+    {
+        std::lock_guard<std::mutex> guard(Cache.Lock);
+        Cache.Budget = bytes;
+        TrimTextureCache(Cache.Budget);
+    }
+
+    void PurgeTileMapTextures()
+    {
+        std::lock_guard<std::mutex> guard(Cache.Lock);
+        TrimTextureCache(0);
+    }
+
+    size_t GetTileMapTextureMemory()
+    {
+        std::lock_guard<std::mutex> guard(Cache.Lock);
+        return Cache.TotalBytes;
+    }
+}
@@ -28,42 +28,73 @@
 
 #include "ray_tilemap.h"
 #include "external/PUGIXML/pugixml.hpp"
-#include "external/sinfl.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
 
 namespace RayTiled
 {
-	pugi::xml_parse_result ParseXML(const std::string& fileName, pugi::xml_document& doc);
-	bool ReadTiledXML(pugi::xml_document& doc, TileMap& map);
-	void SetFolderPath(const std::string& path);
-	void ClearFolderPath();
-	Texture2D GetTexture(const std::string& fileName);
+	pugi::xml_parse_result ParseXML(const TileMapLoadContext& context, const std::string& fileName, pugi::xml_document& doc);
+	bool UsesFileTimes(const TileMapLoadContext& context);
+	bool ReadTiledXML(const TileMapLoadContext& context, pugi::xml_document& doc, TileMap& map);
+	std::string GetFolderPath(const std::string& filepath);
+	std::string GetLoadPath(const TileMapLoadContext& context, const std::string& fileName);
+	Texture2D GetTexture(const TileMapLoadContext& context, const std::string& fileName);
+	bool DecodeBase64(const char* text, uint8_t* output, size_t outputSize, size_t& written);
+	size_t GetBase64DecodedSize(const char* text);
+	bool InflateData(const uint8_t* data, size_t size, bool gzip, uint8_t* output, size_t outputSize, size_t& written);
+	bool ZstdDecompressData(const uint8_t* data, size_t size, uint8_t* output, size_t outputSize, size_t& written);
+	bool IsCookedTileMapFile(const std::string& filepath);
+	bool LoadCookedTileMap(const TileMapLoadContext& context, const std::string& filepath, TileMap& map);
 
 	bool LoadTileMap(const std::string& filepath, TileMap& map)
+	{
+		return LoadTileMap(filepath, map, TileMapLoadContext());
+	}
+
+	bool LoadTileMap(const std::string& filepath, TileMap& map, const TileMapLoadContext& context)
 	{
 		map.TileSheets.clear();
 		map.Layers.clear();
+		map.TileLookup.clear();
+		map.CookedData.reset();
 
-		pugi::xml_document doc;
-		auto result = ParseXML(filepath, doc);
+		// everything the map uses is relative to the map
+		TileMapLoadContext mapContext = context;
+		mapContext.BasePath = GetFolderPath(filepath);
 
-		SetFolderPath(GetDirectoryPath(filepath.c_str()));
+		if (IsCookedTileMapFile(filepath))
+			return LoadCookedTileMap(mapContext, filepath, map);
 
-		bool ret = result.status == pugi::xml_parse_status::status_ok && ReadTiledXML(doc, map);
-		ClearFolderPath();
-		return ret;
+		// the map file itself is relative to the working folder
+		TileMapLoadContext fileContext = context;
+		fileContext.BasePath.clear();
+
+		pugi::xml_document doc;
+		auto result = ParseXML(fileContext, filepath, doc);
+
+		return result.status == pugi::xml_parse_status::status_ok && ReadTiledXML(mapContext, doc, map);
 	}
 
 	bool LoadTileMapFromMemory(const char* fileData, TileMap& map)
+	{
+		return LoadTileMapFromMemory(fileData, map, TileMapLoadContext());
+	}
+
+	bool LoadTileMapFromMemory(const char* fileData, TileMap& map, const TileMapLoadContext& context)
 	{
 		map.TileSheets.clear();
 		map.Layers.clear();
+		map.TileLookup.clear();
+		map.CookedData.reset();
 
 		if (fileData == nullptr)
 			return false;
 
 		pugi::xml_document doc;
 		pugi::xml_parse_result result = doc.load_string(fileData);
-		return result.status == pugi::xml_parse_status::status_ok && ReadTiledXML(doc, map);
+		return result.status == pugi::xml_parse_status::status_ok && ReadTiledXML(context, doc, map);
 	}
 
 	const unsigned FLIPPED_HORIZONTALLY_FLAG = 0x80000000;
@@ -92,21 +123,208 @@ namespace RayTiled
 		return true;
 	}
 
-	bool ReadTileSetNode(pugi::xml_node root, int idOffset, TileMap& map)
+	std::vector<std::string> split(const char* str, char c = ' ')
+	{
+		std::vector<std::string> result;
+
+		do
+		{
+			const char* begin = str;
+
+			while (*str != c && *str)
+				str++;
+
+			result.push_back(std::string(begin, str));
+		} while (0 != *str++);
+
+		return result;
+	}
+
+	// parses Tiled's #AARRGGBB or #RRGGBB colors
+	static Color ReadPropertyColor(const char* text)
+	{
+		if (*text == '#')
+			text++;
+
+		size_t length = strlen(text);
+		if (length != 6 && length != 8)
+			return BLANK;
+
+		uint32_t value = uint32_t(strtoul(text, nullptr, 16));
+		if (length == 6)
+			value |= 0xFF000000;
+
+		return Color{ uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value), uint8_t(value >> 24) };
+	}
+
+	// reads the children of a properties node into the store, for one owner
+	// class properties are stored as a string with the class name, and each member that was set is stored as name.member
+	static void ReadProperties(pugi::xml_node properties, PropertyStore& store, uint64_t owner, const std::string& prefix = std::string())
+	{
+		for (auto prop : properties.children("property"))
+		{
+			std::string type = prop.attribute("type").as_string("string");
+			std::string name = prefix + prop.attribute("name").as_string();
+
+			if (type == "class")
+			{
+				Property& property = store.Add(owner, GetPropertyKey(name));
+				property.Type = PropertyType::String;
+				store.SetText(property, prop.attribute("propertytype").as_string());
+
+				// members left at their default value are not saved, so only the changed ones are found
+				ReadProperties(prop.child("properties"), store, owner, name + ".");
+				continue;
+			}
+
+			// multi line strings are saved as the node text instead of the value attribute
+			auto valueAttribute = prop.attribute("value");
+			const char* value = valueAttribute.empty() ? prop.child_value() : valueAttribute.as_string();
+
+			PropertyType propertyType = PropertyType::None;
+			if (type == "string")
+				propertyType = PropertyType::String;
+			else if (type == "int")
+				propertyType = PropertyType::Int;
+			else if (type == "float")
+				propertyType = PropertyType::Float;
+			else if (type == "bool")
+				propertyType = PropertyType::Bool;
+			else if (type == "color")
+				propertyType = PropertyType::Color;
+			else if (type == "file")
+				propertyType = PropertyType::File;
+			else if (type == "object")
+				propertyType = PropertyType::Object;
+
+			Property& property = store.Add(owner, GetPropertyKey(name));
+			property.Type = propertyType;
+
+			switch (propertyType)
+			{
+			case PropertyType::String:
+			case PropertyType::File:
+				store.SetText(property, value);
+				break;
+			case PropertyType::Int:
+			case PropertyType::Object:
+				property.IntValue = int32_t(strtol(value, nullptr, 10));
+				break;
+			case PropertyType::Float:
+				property.FloatValue = float(atof(value));
+				break;
+			case PropertyType::Bool:
+				property.IntValue = strcmp(value, "true") == 0 ? 1 : 0;
+				break;
+			case PropertyType::Color:
+				property.ColorValue = ReadPropertyColor(value);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	// rotated ellipses are stored as polygons with this many points
+	static constexpr int RotatedEllipsePoints = 16;
+
+	// reads the collision shapes that Tiled stores as an object group on a tileset tile
+	static void ReadTileCollisionShapes(pugi::xml_node objectGroup, std::vector<TileCollisionShape>& shapes)
+	{
+		for (auto object : objectGroup.children("object"))
+		{
+			TileCollisionShape shape;
+			shape.Bounds.x = object.attribute("x").as_float();
+			shape.Bounds.y = object.attribute("y").as_float();
+			shape.Bounds.width = object.attribute("width").as_float();
+			shape.Bounds.height = object.attribute("height").as_float();
+
+			// Tiled turns shapes clockwise around the object position
+			float rotation = object.attribute("rotation").as_float();
+
+			if (!object.child("point").empty() || !object.child("polyline").empty())
+			{
+				continue;
+			}
+			else if (!object.child("polygon").empty())
+			{
+				shape.Type = TileShapeType::Polygon;
+
+				for (auto point : split(object.child("polygon").attribute("points").as_string(), ' '))
+				{
+					auto coords = split(point.c_str(), ',');
+					if (coords.size() == 2)
+						shape.Points.push_back(Vector2{ (float)atof(coords[0].c_str()), (float)atof(coords[1].c_str()) });
+				}
+
+				if (shape.Points.size() < 3)
+					continue;
+			}
+			else if (!object.child("ellipse").empty())
+			{
+				shape.Type = TileShapeType::Ellipse;
+
+				// a turned ellipse is not axis aligned, so it becomes a polygon around the same outline
+				if (rotation != 0)
+				{
+					shape.Type = TileShapeType::Polygon;
+
+					Vector2 radius = { shape.Bounds.width * 0.5f, shape.Bounds.height * 0.5f };
+					for (int i = 0; i < RotatedEllipsePoints; i++)
+					{
+						float angle = 2 * PI * i / RotatedEllipsePoints;
+						shape.Points.push_back(Vector2{ radius.x + cosf(angle) * radius.x, radius.y + sinf(angle) * radius.y });
+					}
+				}
+			}
+			else if (rotation != 0)
+			{
+				// a turned rectangle is not axis aligned, so it becomes a polygon of its corners
+				shape.Type = TileShapeType::Polygon;
+				shape.Points = { Vector2{ 0, 0 }, Vector2{ shape.Bounds.width, 0 }, Vector2{ shape.Bounds.width, shape.Bounds.height }, Vector2{ 0, shape.Bounds.height } };
+			}
+
+			if (shape.Type == TileShapeType::Polygon)
+			{
+				if (rotation != 0)
+				{
+					for (auto& point : shape.Points)
+						point = Vector2Rotate(point, rotation * DEG2RAD);
+				}
+
+				// make the bounds cover the points and keep the points relative to the bounds, the same as polygon objects
+				Vector2 minPoint = shape.Points.front();
+				Vector2 maxPoint = shape.Points.front();
+				for (auto& point : shape.Points)
+				{
+					minPoint = Vector2Min(minPoint, point);
+					maxPoint = Vector2Max(maxPoint, point);
+				}
+
+				for (auto& point : shape.Points)
+					point = Vector2Subtract(point, minPoint);
+
+				shape.Bounds = { shape.Bounds.x + minPoint.x, shape.Bounds.y + minPoint.y, maxPoint.x - minPoint.x, maxPoint.y - minPoint.y };
+			}
+
+			shapes.push_back(std::move(shape));
+		}
+	}
+
+	// the parts of a tileset that don't depend on the map using it, tile properties are keyed by the index of the tile in the set
+	static void ParseTileSet(pugi::xml_node root, TileSheet& tilesheet, PropertyStore& tileProperties)
 	{
 		float tileWidth = root.attribute("tilewidth").as_float();
 		float tileHeight = root.attribute("tileheight").as_float();
 
 		int tileCount = root.attribute("tilecount").as_int();
 
-		int guid = root.attribute("firstgid").as_int();
-
 		int columCount = root.attribute("columns").as_int();
 		int spacing = root.attribute("spacing").as_int();
 		int margin = root.attribute("margin").as_int();
 		std::string source;
 
-		int width, height;
+		int width = 0, height = 0;
 
 		for (pugi::xml_node child : root.children())
 		{
@@ -114,6 +332,28 @@ namespace RayTiled
 			if (n == "tile")
 			{
 				int id = child.attribute("id").as_int();
+
+				auto properties = child.child("properties");
+				if (!properties.empty())
+					ReadProperties(properties, tileProperties, GetPropertyOwner(PropertyOwnerType::Tile, id));
+
+				auto objectGroup = child.child("objectgroup");
+				if (!objectGroup.empty())
+					ReadTileCollisionShapes(objectGroup, tilesheet.CollisionShapes[uint16_t(id)]);
+
+				auto animationNode = child.child("animation");
+				if (!animationNode.empty())
+				{
+					TileAnimation& animation = tilesheet.Animations[uint16_t(id)];
+					for (auto frameNode : animationNode.children("frame"))
+					{
+						TileAnimationFrame& frame = animation.Frames.emplace_back();
+						frame.TileIndex = uint16_t(frameNode.attribute("tileid").as_uint());
+						frame.Duration = frameNode.attribute("duration").as_float() / 1000.0f;
+						animation.Length += frame.Duration;
+					}
+				}
+
 				if (!ReadImageData(width, height, source, child.child("image")))
 					continue;
 			}
@@ -123,11 +363,7 @@ namespace RayTiled
 			}
 		}
 
-		map.TileSheets.try_emplace(guid);
-
-		auto& tilesheet = map.TileSheets[guid];
-		tilesheet.Texture = GetTexture(source);
-		tilesheet.StartingTileId = guid;
+		tilesheet.TexturePath = source;
 
 		for (int y = margin; y < height - margin; y += int(tileHeight) + spacing)
 		{
@@ -136,39 +372,107 @@ namespace RayTiled
 				tilesheet.Tiles.emplace_back(Rectangle{ float(x), float(y), tileWidth, tileHeight });
 			}
 		}
+	}
+
+	static void AddTileSheet(const TileMapLoadContext& context, const TileSheet& tileset, const PropertyStore& tileProperties, int idOffset, TileMap& map)
+	{
+		auto& tilesheet = map.TileSheets[uint16_t(idOffset)];
+		tilesheet = tileset;
+		tilesheet.Texture = GetTexture(context, tileset.TexturePath);
+		tilesheet.StartingTileId = uint16_t(idOffset);
+
+		// move the tile properties into the map, keyed by tile id
+		for (const Property& source : tileProperties.Properties)
+		{
+			int32_t localId = int32_t(uint32_t(source.Owner));
+			uint64_t owner = GetPropertyOwner(PropertyOwnerType::Tile, idOffset + localId);
+
+			Property& property = map.Properties.Add(owner, source.Key);
+			property = source;
+			property.Owner = owner;
+			if (source.Type == PropertyType::String || source.Type == PropertyType::File)
+				map.Properties.SetText(property, tileProperties.GetText(source));
+		}
+	}
 
+	bool ReadTileSetNode(const TileMapLoadContext& context, pugi::xml_node root, int idOffset, TileMap& map)
+	{
+		TileSheet tileset;
+		PropertyStore tileProperties;
+		ParseTileSet(root, tileset, tileProperties);
+		AddTileSheet(context, tileset, tileProperties, idOffset, map);
 		return true;
 	}
 
-	bool ReadTileSetFile(const std::string& tilesetFileName, int idOffset, TileMap& map)
+	// parsed external tilesets, so maps that share a tileset only parse it once
+	struct CachedTileSet
+	{
+		long ModTime = 0;               // the file time when it was parsed, a newer file is parsed again
+		TileSheet TileSet;              // the parsed tileset, without a texture or starting id
+		PropertyStore TileProperties;   // the tile properties, keyed by the index of the tile in the set
+	};
+
+	// entries are shared so a load can keep using one after releasing the lock, while another load replaces it
+	static std::mutex TileSetCacheLock;
+	static std::unordered_map<std::string, std::shared_ptr<const CachedTileSet>> TileSetCache;
+
+	void ClearTileSetCache()
 	{
+		std::lock_guard<std::mutex> guard(TileSetCacheLock);
+		TileSetCache.clear();
+	}
+
+	bool ReadTileSetFile(const TileMapLoadContext& context, const std::string& tilesetFileName, int idOffset, TileMap& map)
+	{
+		std::string fullpath = GetLoadPath(context, tilesetFileName);
+
+		// the cache is keyed by path and checked with the file time, neither means anything for files from a custom loader
+		bool useCache = context.UseTileSetCache && UsesFileTimes(context);
+		long modTime = useCache ? GetFileModTime(fullpath.c_str()) : 0;
+
+		if (useCache)
+		{
+			std::shared_ptr<const CachedTileSet> cached;
+			{
+				std::lock_guard<std::mutex> guard(TileSetCacheLock);
+				auto itr = TileSetCache.find(fullpath);
+				if (itr != TileSetCache.end() && itr->second->ModTime == modTime)
+					cached = itr->second;
+			}
+
+			// adding the sheet loads its texture, so it is done outside the lock
+			if (cached)
+			{
+				AddTileSheet(context, cached->TileSet, cached->TileProperties, idOffset, map);
+				return true;
+			}
+		}
+
 		pugi::xml_document doc;
 
-		pugi::xml_parse_result result = ParseXML(tilesetFileName, doc);
+		pugi::xml_parse_result result = ParseXML(context, tilesetFileName, doc);
 
 		if (result.status != pugi::xml_parse_status::status_ok)
 			return false;
 
 		pugi::xml_node root = doc.child("tileset");
 
-		return ReadTileSetNode(root, idOffset, map);
-	}
+		TileSheet tileset;
+		PropertyStore tileProperties;
+		ParseTileSet(root, tileset, tileProperties);
+		AddTileSheet(context, tileset, tileProperties, idOffset, map);
 
-	std::vector<std::string> split(const char* str, char c = ' ')
-	{
-		std::vector<std::string> result;
+		if (!useCache)
+			return true;
 
-		do
-		{
-			const char* begin = str;
-
-			while (*str != c && *str)
-				str++;
+		auto cached = std::make_shared<CachedTileSet>();
+		cached->ModTime = modTime;
+		cached->TileSet = std::move(tileset);
+		cached->TileProperties = std::move(tileProperties);
 
-			result.push_back(std::string(begin, str));
-		} while (0 != *str++);
-
-		return result;
+		std::lock_guard<std::mutex> guard(TileSetCacheLock);
+		TileSetCache[fullpath] = std::move(cached);
+		return true;
 	}
 
 	bool ReadObjectsLayer(pugi::xml_node& root, TileMap& map)
@@ -184,7 +488,11 @@ namespace RayTiled
 		for (pugi::xml_node child : root.children())
 		{
 			std::string n = child.name();
-			if (n == "object")
+			if (n == "properties")
+			{
+				ReadProperties(child, map.Properties, GetPropertyOwner(PropertyOwnerType::Layer, id));
+			}
+			else if (n == "object")
 			{
 				int id = child.attribute("id").as_int();
 
@@ -242,53 +550,287 @@ namespace RayTiled
 				object->Bounds.width = child.attribute("width").as_float();
 				object->Bounds.height = child.attribute("height").as_float();
 				object->Rotation = child.attribute("rotation").as_float();
+
+				// Tiled gives polygons no size, so make the bounds cover the points and keep the points relative to the bounds
+				if (object->Type == ObjectLayer::ObjectType::Polygon)
+				{
+					auto poly = static_cast<ObjectLayer::PolygonObject*>(object);
+					if (!poly->Points.empty())
+					{
+						Vector2 minPoint = poly->Points.front();
+						Vector2 maxPoint = poly->Points.front();
+						for (auto& point : poly->Points)
+						{
+							minPoint = Vector2Min(minPoint, point);
+							maxPoint = Vector2Max(maxPoint, point);
+						}
+
+						for (auto& point : poly->Points)
+							point = Vector2Subtract(point, minPoint);
+
+						object->Bounds = { object->Bounds.x + minPoint.x, object->Bounds.y + minPoint.y, maxPoint.x - minPoint.x, maxPoint.y - minPoint.y };
+					}
+				}
 				object->Visible = child.attribute("visible").empty() || child.attribute("visible").as_int() != 0;
 
 				object->TileID = child.attribute("gid").as_int();
 
 				auto properties = child.child("properties");
 				if (!properties.empty())
-				{
-					for (auto prop : properties.children())
-					{
-						/*
-						Property propertyRectord;
-						propertyRectord.Name = prop.attribute("name").as_string();
-						propertyRectord.Type = prop.attribute("type").as_string();
-						propertyRectord.Value = prop.attribute("value").as_string();
-
-						object->Properties.emplace_back(std::move(propertyRectord));
-						*/
-					}
-				}
+					ReadProperties(properties, map.Properties, GetPropertyOwner(PropertyOwnerType::Object, object->Id));
 
 			}
 		}
 
+		layer.RebuildIndex(layer.Grid.CellSize);
+
 		int index = int(map.Layers.size());
 		map.Layers.emplace_back(std::move(layerPtr));
 		return true;
 	}
 
-	void AddLayerTile(TileLayer* layer, uint32_t val)
+	// splits a Tiled gid into the tile id and the flip flags
+	static void DecodeTileGID(uint32_t gid, TileInfo& tile)
 	{
-		layer->TileData.emplace_back();
-		TileInfo& tile = layer->TileData.back();
-		if (val & FLIPPED_HORIZONTALLY_FLAG)
+		tile = TileInfo();
+
+		if (gid & FLIPPED_HORIZONTALLY_FLAG)
 			tile.TileFlags |= TileFlagsFlipHorizontal;
 
-		if (val & FLIPPED_VERTICALLY_FLAG)
+		if (gid & FLIPPED_VERTICALLY_FLAG)
 			tile.TileFlags |= TileFlagsFlipVertical;
 
-		if (val & FLIPPED_DIAGONALLY_FLAG)
+		if (gid & FLIPPED_DIAGONALLY_FLAG)
 			tile.TileFlags |= TileFlagsFlipDiagonal;
 
-		val &= ~(FLIPPED_HORIZONTALLY_FLAG | FLIPPED_VERTICALLY_FLAG | FLIPPED_DIAGONALLY_FLAG);
+		gid &= ~(FLIPPED_HORIZONTALLY_FLAG | FLIPPED_VERTICALLY_FLAG | FLIPPED_DIAGONALLY_FLAG);
+
+		tile.TileIndex = static_cast<uint16_t>(gid);
+	}
+
+	// parses CSV tile data in one pass straight from the XML buffer, into cells that are already allocated
+	// returns false if the text is not valid or does not have exactly one value per cell
+	static bool ReadCSVLayerData(const char* text, TileInfo* cells, size_t cellCount)
+	{
+		if (text == nullptr)
+			return false;
+
+		size_t cell = 0;
+
+		const char* pos = text;
+		while (true)
+		{
+			while (*pos == ',' || *pos == ' ' || *pos == '\n' || *pos == '\r' || *pos == '\t')
+				pos++;
+
+			if (*pos == '\0')
+				break;
+
+			if (*pos < '0' || *pos > '9' || cell >= cellCount)
+				return false;
 
-		tile.TileIndex = static_cast<uint16_t>(val);
+			uint64_t value = 0;
+			while (*pos >= '0' && *pos <= '9')
+			{
+				value = value * 10 + uint64_t(*pos - '0');
+				if (value > UINT32_MAX)
+					return false;
+				pos++;
+			}
+
+			DecodeTileGID(uint32_t(value), cells[cell++]);
+		}
+
+		return cell == cellCount;
 	}
 
-	bool ReadTiledXML(pugi::xml_document& doc, TileMap& map)
+	// the raw gids are decoded straight into the tile storage and then converted in place, so this needs to be the same size as a gid
+	static_assert(sizeof(TileInfo) == sizeof(uint32_t), "TileInfo must be the same size as a Tiled gid");
+
+	// decodes base64 tile data, with optional zlib, gzip or zstd compression, into cells that are already allocated
+	// returns false if the data is not valid or does not have exactly one gid per cell
+	static bool ReadBase64LayerData(const char* text, const std::string& compression, TileInfo* cells, size_t cellCount)
+	{
+		uint8_t* tileBytes = reinterpret_cast<uint8_t*>(cells);
+		size_t tileByteCount = cellCount * sizeof(TileInfo);
+		size_t written = 0;
+
+		if (compression.empty())
+		{
+			if (!DecodeBase64(text, tileBytes, tileByteCount, written))
+				return false;
+		}
+		else
+		{
+			std::vector<uint8_t> compressed(GetBase64DecodedSize(text));
+
+			size_t compressedSize = 0;
+			if (!DecodeBase64(text, compressed.data(), compressed.size(), compressedSize))
+				return false;
+
+			bool ok = false;
+			if (compression == "zlib" || compression == "gzip")
+				ok = InflateData(compressed.data(), compressedSize, compression == "gzip", tileBytes, tileByteCount, written);
+			else if (compression == "zstd")
+				ok = ZstdDecompressData(compressed.data(), compressedSize, tileBytes, tileByteCount, written);
+
+			if (!ok)
+				return false;
+		}
+
+		if (written != tileByteCount)
+			return false;
+
+		// gids are stored little endian
+		for (size_t index = 0; index < cellCount; index++)
+		{
+			const uint8_t* gidBytes = tileBytes + index * sizeof(uint32_t);
+			uint32_t gid = uint32_t(gidBytes[0]) | (uint32_t(gidBytes[1]) << 8) | (uint32_t(gidBytes[2]) << 16) | (uint32_t(gidBytes[3]) << 24);
+			DecodeTileGID(gid, cells[index]);
+		}
+
+		return true;
+	}
+
+	// reads the tiles from a data or chunk node in any of the Tiled encodings
+	static bool ReadLayerData(pugi::xml_node node, const std::string& encoding, const std::string& compression, TileInfo* cells, size_t cellCount)
+	{
+		if (encoding == "csv")
+			return ReadCSVLayerData(node.first_child().value(), cells, cellCount);
+
+		if (encoding == "base64")
+			return ReadBase64LayerData(node.first_child().value(), compression, cells, cellCount);
+
+		if (!encoding.empty())
+			return false; // unknown encoding
+
+		// the old XML format, one tile element per cell
+		size_t cell = 0;
+		for (auto tile : node.children("tile"))
+		{
+			if (cell >= cellCount)
+				return false;
+
+			DecodeTileGID(tile.attribute("gid").as_uint(), cells[cell++]);
+		}
+
+		return cell == cellCount;
+	}
+
+	// reads the chunks of an infinite map layer, keyed by their editor chunk coordinates
+	static bool ReadLayerChunks(pugi::xml_node data, const std::string& encoding, const std::string& compression, TileLayer& layer)
+	{
+		bool first = true;
+		for (auto chunkNode : data.children("chunk"))
+		{
+			int x = chunkNode.attribute("x").as_int();
+			int y = chunkNode.attribute("y").as_int();
+			int chunkWidth = chunkNode.attribute("width").as_int();
+			int chunkHeight = chunkNode.attribute("height").as_int();
+
+			if (first)
+			{
+				layer.ChunkWidth = chunkWidth;
+				layer.ChunkHeight = chunkHeight;
+				first = false;
+			}
+
+			// chunks are always the same size and on the chunk grid
+			if (chunkWidth <= 0 || chunkHeight <= 0 || chunkWidth != layer.ChunkWidth || chunkHeight != layer.ChunkHeight || x % chunkWidth != 0 || y % chunkHeight != 0)
+				return false;
+
+			uint64_t key = TileLayer::GetChunkKey(x / chunkWidth, y / chunkHeight);
+			TileLayerChunk& chunk = layer.Chunks[key];
+			chunk.TileData.resize(size_t(chunkWidth) * size_t(chunkHeight));
+
+			if (!ReadLayerData(chunkNode, encoding, compression, chunk.TileData.data(), chunk.TileData.size()))
+				return false;
+
+			if (std::none_of(chunk.TileData.begin(), chunk.TileData.end(), [](const TileInfo& tile) { return tile.TileIndex != 0; }))
+				layer.Chunks.erase(key);
+		}
+
+		return true;
+	}
+
+	// moves an infinite map so its top left chunk is at cell 0,0 and sizes the sparse layers to cover every chunk
+	static bool NormalizeInfiniteMap(TileMap& map)
+	{
+		int minX = INT32_MAX, minY = INT32_MAX;
+		int maxX = INT32_MIN, maxY = INT32_MIN;
+
+		for (auto& layer : map.Layers)
+		{
+			if (layer->Type != TileLayerType::Tile)
+				continue;
+
+			TileLayer& tileLayer = static_cast<TileLayer&>(*layer);
+			for (auto& [key, chunk] : tileLayer.Chunks)
+			{
+				int x = int(uint32_t(key >> 32)) * tileLayer.ChunkWidth;
+				int y = int(uint32_t(key)) * tileLayer.ChunkHeight;
+
+				minX = std::min(minX, x);
+				minY = std::min(minY, y);
+				maxX = std::max(maxX, x + tileLayer.ChunkWidth);
+				maxY = std::max(maxY, y + tileLayer.ChunkHeight);
+			}
+		}
+
+		// nothing painted
+		if (minX > maxX)
+			minX = minY = maxX = maxY = 0;
+
+		map.Origin = { float(minX), float(minY) };
+
+		Vector2 tileSize = { 0, 0 };
+		for (auto& layer : map.Layers)
+		{
+			if (layer->Type != TileLayerType::Tile)
+				continue;
+
+			TileLayer& tileLayer = static_cast<TileLayer&>(*layer);
+			tileSize = tileLayer.TileSize;
+
+			if (minX % tileLayer.ChunkWidth != 0 || minY % tileLayer.ChunkHeight != 0)
+				return false;
+
+			int offsetX = minX / tileLayer.ChunkWidth;
+			int offsetY = minY / tileLayer.ChunkHeight;
+
+			std::unordered_map<uint64_t, TileLayerChunk> chunks;
+			chunks.reserve(tileLayer.Chunks.size());
+			for (auto& [key, chunk] : tileLayer.Chunks)
+				chunks.try_emplace(TileLayer::GetChunkKey(int(uint32_t(key >> 32)) - offsetX, int(uint32_t(key)) - offsetY), std::move(chunk));
+
+			tileLayer.Chunks = std::move(chunks);
+			tileLayer.Bounds = { float(maxX - minX), float(maxY - minY) };
+		}
+
+		// isometric objects are placed in tile height units on both axes
+		if (map.Orientation == TileMapOrientation::Isometric)
+			tileSize.x = tileSize.y;
+
+		Vector2 objectOffset = { map.Origin.x * tileSize.x, map.Origin.y * tileSize.y };
+		for (auto& layer : map.Layers)
+		{
+			if (layer->Type != TileLayerType::Object)
+				continue;
+
+			ObjectLayer& objectLayer = static_cast<ObjectLayer&>(*layer);
+			for (auto& object : objectLayer.Objets)
+			{
+				object->Bounds.x -= objectOffset.x;
+				object->Bounds.y -= objectOffset.y;
+			}
+
+			objectLayer.RebuildIndex(objectLayer.Grid.CellSize);
+		}
+
+		return true;
+	}
+
+	bool ReadTiledXML(const TileMapLoadContext& context, pugi::xml_document& doc, TileMap& map)
 	{
 		auto root = doc.child("map");
 
@@ -331,6 +873,9 @@ namespace RayTiled
 		int tilewidth = root.attribute("tilewidth").as_int();
 		int tileheight = root.attribute("tileheight").as_int();
 
+		map.Infinite = root.attribute("infinite").as_int() != 0;
+		map.Origin = { 0, 0 };
+
 		for (auto child : root.children())
 		{
 			std::string childName = child.name();
@@ -343,30 +888,17 @@ namespace RayTiled
 				std::string tilesetFile = child.attribute("source").as_string();
 				if (tilesetFile.size() == 0)
 				{
-					if (!ReadTileSetNode(child, idOffset, map))
+					if (!ReadTileSetNode(context, child, idOffset, map))
 						return false;
 				}
-				else if (!ReadTileSetFile(tilesetFile, idOffset, map))
+				else if (!ReadTileSetFile(context, tilesetFile, idOffset, map))
 				{
 					return false;
 				}
 			}
 			else if (childName == "properties")
 			{
-				if (!child.empty())
-				{
-					for (auto prop : child.children())
-					{
-						/*
-						Property propertyRectord;
-						propertyRectord.Name = prop.attribute("name").as_string();
-						propertyRectord.Type = prop.attribute("type").as_string();
-						propertyRectord.Value = prop.attribute("value").as_string();
-
-						map.Properties.emplace_back(std::move(propertyRectord));
-						*/
-					}
-				}
+				ReadProperties(child, map.Properties, GetPropertyOwner(PropertyOwnerType::Map));
 			}
 			else if (childName == "objectgroup")
 			{
@@ -390,93 +922,36 @@ namespace RayTiled
 				layer->TileSize.x = float(tilewidth);
 				layer->TileSize.y = float(tileheight);
 
+				auto properties = child.child("properties");
+				if (!properties.empty())
+					ReadProperties(properties, map.Properties, GetPropertyOwner(PropertyOwnerType::Layer, layerID));
+
                 layer->Orientation = map.Orientation;
 
 				auto data = child.child("data");
 				std::string encoding = data.attribute("encoding").as_string();
-				std::string contents = data.first_child().value();
-				if (encoding == "csv")
-				{
-					std::vector<std::vector<int>> rawData;
-
-					size_t linePos = 0;
-					do
-					{
-						size_t nextLine = contents.find_first_of('\n', linePos);
-						if (nextLine == std::string::npos)
-							nextLine = contents.size();
-
-						std::string colText = contents.substr(linePos, nextLine - linePos);
-						linePos = nextLine + 1;
-
-						if (colText.size() == 0)
-							continue;
-						size_t charPos = 0;
-						do
-						{
-							size_t nextDelim = colText.find_first_of(',', charPos);
-							if (nextDelim == std::string::npos || nextDelim == colText.size() - 1)
-								nextDelim = colText.size();
-
-							std::string valStr = colText.substr(charPos, nextDelim - charPos);
-							uint32_t val = static_cast<uint32_t>(std::atoll(valStr.c_str()));
-							charPos = nextDelim + 1;
+				std::string compression = data.attribute("compression").as_string();
 
-							AddLayerTile(layer, val);
-						} while (charPos <= colText.size());
-					} while (linePos < contents.size() && linePos != std::string::npos);
-				}
-				else if (encoding == "base64")
+				if (map.Infinite)
 				{
-					std::string compression = data.attribute("compression").as_string();
-					int size = 0;
-
-					uint32_t header = *(uint32_t*)(contents.data());
-
-					uint8_t* data = DecodeDataBase64((const char*)contents.c_str() + 4, &size);
-
-					uint32_t* decompData = nullptr;
-					int decompSize = 0;
-
-					if (compression == "zlib")
-					{
-						decompData = (uint32_t*)MemAlloc(4 * width * height);
-						decompSize = width * height;
-						zsinflate(decompData, decompSize * 4, data, size);
-
-						MemFree(data);
-					}
-					else if (compression == "gzip")
-					{
-						// TODO, decompress this
-						MemFree(data);
-						continue;
-					}
-					else if (compression == "zstd")
-					{
-						// TODO, decompress this
-						continue;
-						MemFree(data);
-					}
-					else
-					{
-						decompData = (uint32_t*)data;
-						decompSize = size / 4;
-					}
+					layer->Sparse = true;
+					if (!ReadLayerChunks(data, encoding, compression, *layer))
+						return false;
+					continue;
+				}
 
-					if (decompData && decompSize)
-					{
-						for (int index = 0; index < decompSize; index++)
-						{
-							AddLayerTile(layer, decompData[index]);
-						}
+				layer->TileData.resize(size_t(width) * size_t(height));
 
-						MemFree(decompData);
-					}
-				}
+				if (!ReadLayerData(data, encoding, compression, layer->TileData.data(), layer->TileData.size()))
+					return false;
 			}
 		}
 
+		if (map.Infinite && !NormalizeInfiniteMap(map))
+			return false;
+
+		BuildTileLookup(map);
+
 		return map.TileSheets.size() > 0;
 	}
 
@@ -0,0 +1,605 @@
+/**********************************************************************************************
+*
+*   RayTileMap
+*
+*   LICENSE: MIT
+*
+*   Copyright (c) 2024 Jeffery Myers
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "ray_tilemap.h"
+#include "raymath.h"
+#include "rlgl.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace RayTiled
+{
+    std::string GetFolderPath(const std::string& filepath);
+    bool ReadTextFile(const TileMapLoadContext& context, const std::string& fullpath, std::string& text);
+
+    // just enough JSON for Tiled world files
+    struct JsonValue
+    {
+        enum class Kind
+        {
+            Null,
+            Bool,
+            Number,
+            String,
+            Array,
+            Object,
+        };
+
+        Kind Type = Kind::Null;
+        bool Bool = false;
+        double Number = 0;
+        std::string String;
+        std::vector<JsonValue> Items;
+        std::vector<std::pair<std::string, JsonValue>> Members;
+
+        const JsonValue* Find(const char* name) const
+        {
+            for (const auto& [key, value] : Members)
+            {
+                if (key == name)
+                    return &value;
+            }
+            return nullptr;
+        }
+
+        double GetNumber(const char* name, double defaultValue = 0) const
+        {
+            const JsonValue* value = Find(name);
+            if (value == nullptr || value->Type != Kind::Number)
+                return defaultValue;
+
+            return value->Number;
+        }
+    };
+
+    struct JsonReader
+    {
+        const char* Text = nullptr;
+        int Depth = 0;
+
+        void SkipSpace()
+        {
+            while (*Text == ' ' || *Text == '\t' || *Text == '\n' || *Text == '\r')
+                Text++;
+        }
+
+        bool Match(const char* word)
+        {
+            size_t size = strlen(word);
+            if (strncmp(Text, word, size) != 0)
+                return false;
+
+            Text += size;
+            return true;
+        }
+
+        static void AppendUTF8(std::string& text, unsigned int code)
+        {
+            if (code < 0x80)
+            {
+                text += char(code);
+            }
+            else if (code < 0x800)
+            {
+                text += char(0xC0 | (code >> 6));
+                text += char(0x80 | (code & 0x3F));
+            }
+            else
+            {
+                text += char(0xE0 | (code >> 12));
+                text += char(0x80 | ((code >> 6) & 0x3F));
+                text += char(0x80 | (code & 0x3F));
+            }
+        }
+
+        bool ReadString(std::string& text)
+        {
+            if (*Text != '"')
+                return false;
+
+            Text++;
+            while (*Text != '"')
+            {
+                if (*Text == 0)
+                    return false;
+
+                if (*Text != '\\')
+                {
+                    text += *Text++;
+                    continue;
+                }
+
+                Text++;
+                char escape = *Text++;
+                switch (escape)
+                {
+                case '"': text += '"'; break;
+                case '\\': text += '\\'; break;
+                case '/': text += '/'; break;
+                case 'b': text += '\b'; break;
+                case 'f': text += '\f'; break;
+                case 'n': text += '\n'; break;
+                case 'r': text += '\r'; break;
+                case 't': text += '\t'; break;
+                case 'u':
+                {
+                    char hex[5] = { 0 };
+                    for (int i = 0; i < 4; i++)
+                    {
+                        if (!isxdigit((unsigned char)Text[i]))
+                            return false;
+                        hex[i] = Text[i];
+                    }
+                    Text += 4;
+                    AppendUTF8(text, unsigned(strtoul(hex, nullptr, 16)));
+                    break;
+                }
+                default:
+                    return false;
+                }
+            }
+
+            Text++;
+            return true;
+        }
+
+        bool ReadValue(JsonValue& value)
+        {
+            // world files are shallow, anything this deep is broken
+            if (Depth > 64)
+                return false;
+
+            SkipSpace();
+            if (*Text == '{')
+            {
+                Text++;
+                Depth++;
+                value.Type = JsonValue::Kind::Object;
+                SkipSpace();
+                if (*Text == '}')
+                {
+                    Text++;
+                    Depth--;
+                    return true;
+                }
+
+                while (true)
+                {
+                    SkipSpace();
+                    auto& member = value.Members.emplace_back();
+                    if (!ReadString(member.first))
+                        return false;
+
+                    SkipSpace();
+                    if (*Text++ != ':')
+                        return false;
+
+                    if (!ReadValue(member.second))
+                        return false;
+
+                    SkipSpace();
+                    if (*Text == ',')
+                    {
+                        Text++;
+                        continue;
+                    }
+
+                    if (*Text++ != '}')
+                        return false;
+
+                    Depth--;
+                    return true;
+                }
+            }
+
+            if (*Text == '[')
+            {
+                Text++;
+                Depth++;
+                value.Type = JsonValue::Kind::Array;
+                SkipSpace();
+                if (*Text == ']')
+                {
+                    Text++;
+                    Depth--;
+                    return true;
+                }
+
+                while (true)
+                {
+                    if (!ReadValue(value.Items.emplace_back()))
+                        return false;
+
+                    SkipSpace();
+                    if (*Text == ',')
+                    {
+                        Text++;
+                        continue;
+                    }
+
+                    if (*Text++ != ']')
+                        return false;
+
+                    Depth--;
+                    return true;
+                }
+            }
+
+            if (*Text == '"')
+            {
+                value.Type = JsonValue::Kind::String;
+                return ReadString(value.String);
+            }
+
+            if (Match("true"))
+            {
+                value.Type = JsonValue::Kind::Bool;
+                value.Bool = true;
+                return true;
+            }
+
+            if (Match("false"))
+            {
+                value.Type = JsonValue::Kind::Bool;
+                return true;
+            }
+
+            if (Match("null"))
+                return true;
+
+            char* end = nullptr;
+            value.Number = strtod(Text, &end);
+            if (end == Text)
+                return false;
+
+            value.Type = JsonValue::Kind::Number;
+            Text = end;
+            return true;
+        }
+    };
+
+    bool LoadTileWorld(const std::string& filepath, TileWorld& world)
+    {
+        std::string text;
+        if (!ReadTextFile(world.LoadContext, filepath, text))
+            return false;
+
+        JsonValue root;
+        JsonReader reader;
+        reader.Text = text.c_str();
+        if (!reader.ReadValue(root) || root.Type != JsonValue::Kind::Object)
+            return false;
+
+        // pattern based worlds need a file listing, only the explicit map list is supported
+        const JsonValue* maps = root.Find("maps");
+        if (maps == nullptr || maps->Type != JsonValue::Kind::Array)
+            return false;
+
+        std::string folder = GetFolderPath(filepath);
+        for (const JsonValue& item : maps->Items)
+        {
+            const JsonValue* fileName = item.Find("fileName");
+            if (fileName == nullptr || fileName->Type != JsonValue::Kind::String)
+                return false;
+
+            Rectangle bounds = { float(item.GetNumber("x")), float(item.GetNumber("y")), float(item.GetNumber("width")), float(item.GetNumber("height")) };
+            AddWorldMap(world, folder.empty() ? fileName->String : folder + "/" + fileName->String, bounds);
+        }
+
+        return true;
+    }
+
+    WorldMap* AddWorldMap(TileWorld& world, const std::string& filepath, Rectangle bounds)
+    {
+        auto& map = world.Maps.emplace_back(std::make_unique<WorldMap>());
+        map->FilePath = filepath;
+        map->Bounds = bounds;
+        return map.get();
+    }
+
+    // maps without a size are treated as a point until they are loaded
+    static bool MapOverlaps(const WorldMap& map, Rectangle rect)
+    {
+        if (map.Bounds.width <= 0 || map.Bounds.height <= 0)
+            return CheckCollisionPointRec(Vector2{ map.Bounds.x, map.Bounds.y }, rect);
+
+        return CheckCollisionRecs(map.Bounds, rect);
+    }
+
+    static void SetMapSize(WorldMap& map)
+    {
+        if (map.Bounds.width > 0 && map.Bounds.height > 0)
+            return;
+
+        for (const auto& layer : map.Map.Layers)
+        {
+            if (layer->Type != TileLayerType::Tile)
+                continue;
+
+            const TileLayer& tileLayer = static_cast<const TileLayer&>(*layer);
+            map.Bounds.width = std::max(map.Bounds.width, tileLayer.Bounds.x * tileLayer.TileSize.x);
+            map.Bounds.height = std::max(map.Bounds.height, tileLayer.Bounds.y * tileLayer.TileSize.y);
+        }
+    }
+
+    static void UnloadWorldMap(TileWorld& world, WorldMap& map)
+    {
+        if (map.State == WorldMapState::Loading)
+        {
+            CancelTileMapLoad(map.Load);
+            map.Load.reset();
+            map.State = WorldMapState::Unloaded;
+            return;
+        }
+
+        if (map.State != WorldMapState::Loaded)
+            return;
+
+        if (world.OnMapUnloaded)
+            world.OnMapUnloaded(map);
+
+        UnloadTileMap(map.Map);
+        world.MemoryUsed -= map.MemoryUsage;
+        map.MemoryUsage = 0;
+        map.State = WorldMapState::Unloaded;
+    }
+
+    static void FinishWorldMapLoad(TileWorld& world, WorldMap& map)
+    {
+        switch (GetTileMapLoadState(map.Load))
+        {
+        case TileMapLoadState::Done:
+            TakeLoadedTileMap(map.Load, map.Map);
+            map.Load.reset();
+            map.State = WorldMapState::Loaded;
+            SetMapSize(map);
+
+            if (world.OnMapLoaded)
+                world.OnMapLoaded(map);
+
+            // measured after the callback so meshes and caches it builds are counted
+            map.MemoryUsage = GetTileMapMemoryUsage(map.Map);
+            world.MemoryUsed += map.MemoryUsage;
+            break;
+
+        case TileMapLoadState::Failed:
+            map.Load.reset();
+            map.State = WorldMapState::Failed;
+            break;
+
+        case TileMapLoadState::Cancelled:
+            map.Load.reset();
+            map.State = WorldMapState::Unloaded;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    void UpdateTileWorld(TileWorld& world, Rectangle view)
+    {
+        world.Frame++;
+        UpdateTileMapLoads(world.UploadBudget);
+
+        float radius = world.PrefetchRadius;
+        Rectangle prefetch = { view.x - radius, view.y - radius, view.width + radius * 2, view.height + radius * 2 };
+        Vector2 viewCenter = { view.x + view.width * 0.5f, view.y + view.height * 0.5f };
+
+        std::vector<std::pair<float, WorldMap*>> toLoad;
+        for (auto& mapPtr : world.Maps)
+        {
+            WorldMap& map = *mapPtr;
+            if (map.State == WorldMapState::Loading)
+                FinishWorldMapLoad(world, map);
+
+            if (MapOverlaps(map, view))
+                map.LastVisibleFrame = world.Frame;
+
+            bool nearView = MapOverlaps(map, prefetch);
+
+            // don't spend the loader on maps the view has moved away from
+            if (map.State == WorldMapState::Loading && !nearView)
+                UnloadWorldMap(world, map);
+
+            if (map.State == WorldMapState::Unloaded && nearView)
+            {
+                Vector2 mapCenter = { map.Bounds.x + map.Bounds.width * 0.5f, map.Bounds.y + map.Bounds.height * 0.5f };
+                toLoad.emplace_back(Vector2DistanceSqr(mapCenter, viewCenter), &map);
+            }
+        }
+
+        // the loader works in order, so start with the closest maps
+        std::sort(toLoad.begin(), toLoad.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (auto& [distance, map] : toLoad)
+        {
+            map->Load = LoadTileMapAsync(map->FilePath, world.LoadContext);
+            map->State = WorldMapState::Loading;
+        }
+
+        // maps near the view are never evicted, even if they alone are over the budget
+        while (world.MemoryUsed > world.MemoryBudget)
+        {
+            WorldMap* oldest = nullptr;
+            for (auto& map : world.Maps)
+            {
+                if (map->State != WorldMapState::Loaded || MapOverlaps(*map, prefetch))
+                    continue;
+
+                if (oldest == nullptr || map->LastVisibleFrame < oldest->LastVisibleFrame)
+                    oldest = map.get();
+            }
+
+            if (oldest == nullptr)
+                break;
+
+            UnloadWorldMap(world, *oldest);
+        }
+    }
+
+    Rectangle GetCameraView(const Camera2D& camera, Vector2 bounds)
+    {
+        if (bounds.x <= 0 || bounds.y <= 0)
+            bounds = Vector2{ float(GetScreenWidth()), float(GetScreenHeight()) };
+
+        Vector2 corners[4] =
+        {
+            GetScreenToWorld2D(Vector2{ 0, 0 }, camera),
+            GetScreenToWorld2D(Vector2{ bounds.x, 0 }, camera),
+            GetScreenToWorld2D(Vector2{ 0, bounds.y }, camera),
+            GetScreenToWorld2D(bounds, camera),
+        };
+
+        Vector2 min = corners[0];
+        Vector2 max = corners[0];
+        for (int i = 1; i < 4; i++)
+        {
+            min = Vector2Min(min, corners[i]);
+            max = Vector2Max(max, corners[i]);
+        }
+
+        return Rectangle{ min.x, min.y, max.x - min.x, max.y - min.y };
+    }
+
+    void DrawTileWorld(TileWorld& world, Camera2D* camera, Vector2 bounds)
+    {
+        DrawTileWorld(world, GetDefaultTileDrawContext(), camera, bounds);
+    }
+
+    void DrawTileWorld(TileWorld& world, TileDrawContext& context, Camera2D* camera, Vector2 bounds)
+    {
+        Rectangle view = { 0 };
+        if (camera != nullptr)
+            view = GetCameraView(*camera, bounds);
+
+        for (auto& map : world.Maps)
+        {
+            if (map->State != WorldMapState::Loaded || (camera != nullptr && !MapOverlaps(*map, view)))
+                continue;
+
+            // the map is drawn in its own space, the camera is moved the other way so culling still works
+            Vector2 offset = { map->Bounds.x, map->Bounds.y };
+            rlPushMatrix();
+            rlTranslatef(offset.x, offset.y, 0);
+
+            if (camera != nullptr)
+            {
+                Camera2D localCamera = *camera;
+                localCamera.target = Vector2Subtract(camera->target, offset);
+                DrawTileMap(map->Map, context, &localCamera, bounds);
+            }
+            else
+            {
+                DrawTileMap(map->Map, context, nullptr, bounds);
+            }
+
+            rlPopMatrix();
+        }
+    }
+
+    size_t GetWorldCollisions(const TileWorld& world, Rectangle rect, std::vector<CollisionRecord>& results)
+    {
+        results.clear();
+        for (const auto& map : world.Maps)
+        {
+            if (map->State != WorldMapState::Loaded || !MapOverlaps(*map, rect))
+                continue;
+
+            Vector2 offset = { map->Bounds.x, map->Bounds.y };
+            Rectangle localRect = { rect.x - offset.x, rect.y - offset.y, rect.width, rect.height };
+            GetCollisions(map->Map, localRect, [&](const CollisionRecord& record)
+                {
+                    CollisionRecord& worldRecord = results.emplace_back(record);
+                    worldRecord.Bounds.x += offset.x;
+                    worldRecord.Bounds.y += offset.y;
+                    return true;
+                });
+        }
+
+        return results.size();
+    }
+
+    bool HasWorldCollision(const TileWorld& world, Rectangle rect)
+    {
+        for (const auto& map : world.Maps)
+        {
+            if (map->State != WorldMapState::Loaded || !MapOverlaps(*map, rect))
+                continue;
+
+            Rectangle localRect = { rect.x - map->Bounds.x, rect.y - map->Bounds.y, rect.width, rect.height };
+            if (HasCollision(map->Map, localRect))
+                return true;
+        }
+
+        return false;
+    }
+
+    bool RaycastWorld(const TileWorld& world, const TileRay& ray, RaycastHit& hit)
+    {
+        hit = RaycastHit();
+
+        float length = Vector2Length(ray.Direction);
+        if (length <= 0 || ray.MaxDistance <= 0)
+            return false;
+
+        Vector2 end = Vector2Add(ray.Origin, Vector2Scale(ray.Direction, ray.MaxDistance / length));
+        Rectangle area = { std::min(ray.Origin.x, end.x), std::min(ray.Origin.y, end.y), std::fabs(end.x - ray.Origin.x), std::fabs(end.y - ray.Origin.y) };
+
+        for (const auto& map : world.Maps)
+        {
+            if (map->State != WorldMapState::Loaded || !CheckCollisionRecs(map->Bounds, area))
+                continue;
+
+            TileRay localRay = ray;
+            localRay.Origin = Vector2Subtract(ray.Origin, Vector2{ map->Bounds.x, map->Bounds.y });
+
+            RaycastHit mapHit;
+            if (!Raycast(map->Map, localRay, mapHit) || (hit.Hit && mapHit.Distance >= hit.Distance))
+                continue;
+
+            hit = mapHit;
+            hit.Point = Vector2Add(hit.Point, Vector2{ map->Bounds.x, map->Bounds.y });
+        }
+
+        return hit.Hit;
+    }
+
+    void UnloadTileWorld(TileWorld& world)
+    {
+        for (auto& map : world.Maps)
+            UnloadWorldMap(world, *map);
+
+        world.Maps.clear();
+        world.MemoryUsed = 0;
+    }
+}
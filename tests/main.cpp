@@ -0,0 +1,772 @@
+/**********************************************************************************************
+*
+*   RayTileMap Tests
+*
+*   LICENSE: MIT
+*
+*   Copyright (c) 2024 Jeffery Myers
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "raylib.h"
+#include "ray_tilemap.h"
+
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace RayTiled;
+
+// checks the invariants that the faster code paths must keep, so a change that breaks them fails instead of drawing or walking slightly wrong.
+// builds its own map in memory and needs no window or resources, returns the number of failed checks
+// usage: tests
+
+static int Failures = 0;
+
+#define CHECK(condition, ...) do { if (!(condition)) { Failures++; printf("FAILED %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (false)
+
+static constexpr int MapSize = 96;
+static constexpr int TileSize = 16;
+
+using CellSet = std::set<std::pair<int, int>>;
+
+// a map with a floor layer, a collision layer of random walls and an object layer, the same every run
+static std::string MakeTestMap(unsigned int seed)
+{
+	std::mt19937 rng(seed);
+
+	std::string walls;
+	for (int y = 0; y < MapSize; y++)
+	{
+		for (int x = 0; x < MapSize; x++)
+		{
+			if (x > 0 || y > 0)
+				walls += ",";
+
+			// a tile id in the high bits is a flip flag, some walls are flipped so the flags go through the round trip too
+			uint32_t gid = 0;
+			if (rng() % 4 == 0)
+				gid = 2 | ((rng() % 2) ? 0x80000000u : 0) | ((rng() % 2) ? 0x20000000u : 0);
+			walls += std::to_string(gid);
+		}
+	}
+
+	std::string floor;
+	for (int i = 0; i < MapSize * MapSize; i++)
+		floor += (i > 0) ? ",1" : "1";
+
+	std::string size = std::to_string(MapSize);
+	std::string tile = std::to_string(TileSize);
+
+	return
+		"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<map version=\"1.10\" orientation=\"orthogonal\" renderorder=\"right-down\" width=\"" + size + "\" height=\"" + size + "\" tilewidth=\"" + tile + "\" tileheight=\"" + tile + "\" infinite=\"0\">\n"
+		" <properties><property name=\"Title\" value=\"tests\"/><property name=\"Level\" type=\"int\" value=\"3\"/></properties>\n"
+		" <tileset firstgid=\"1\" name=\"tiles\" tilewidth=\"" + tile + "\" tileheight=\"" + tile + "\" tilecount=\"4\" columns=\"2\">\n"
+		"  <image source=\"tiles.png\" width=\"32\" height=\"32\"/>\n"
+		" </tileset>\n"
+		" <layer id=\"1\" name=\"Floor\" width=\"" + size + "\" height=\"" + size + "\"><data encoding=\"csv\">" + floor + "</data></layer>\n"
+		" <layer id=\"2\" name=\"Walls\" width=\"" + size + "\" height=\"" + size + "\"><data encoding=\"csv\">" + walls + "</data></layer>\n"
+		" <objectgroup id=\"3\" name=\"Things\">\n"
+		"  <object id=\"1\" name=\"Spawn\" type=\"Marker\" x=\"40\" y=\"56\"><point/></object>\n"
+		"  <object id=\"2\" name=\"Room\" x=\"100\" y=\"120\" width=\"64\" height=\"48\" rotation=\"30\"><properties><property name=\"Lit\" type=\"bool\" value=\"true\"/></properties></object>\n"
+		"  <object id=\"5\" name=\"Fence\" x=\"300\" y=\"200\"><polygon points=\"0,0 32,0 32,24 0,24\"/></object>\n"
+		"  <object id=\"7\" name=\"Sign\" x=\"10\" y=\"500\" width=\"80\" height=\"20\"><text pixelsize=\"12\">Hello</text></object>\n"
+		" </objectgroup>\n"
+		"</map>\n";
+}
+
+static TileLayer* FindTileLayer(TileMap& map, const char* name)
+{
+	for (auto& layer : map.Layers)
+	{
+		if (layer->Type == TileLayerType::Tile && layer->Name == name)
+			return static_cast<TileLayer*>(layer.get());
+	}
+	return nullptr;
+}
+
+static bool LoadTestMap(TileMap& map)
+{
+	// there is no window, so leave the textures empty
+	TileMapLoadContext context;
+	context.DeferTextures = true;
+
+	std::string data = MakeTestMap(1234);
+	return LoadTileMapFromMemory(data.c_str(), map, context);
+}
+
+// the cells inside a query rectangle that the records say were hit, merged records cover more than one cell
+static CellSet GetHitCells(const std::vector<CollisionRecord>& records, Rectangle query)
+{
+	int minX = int(floorf(query.x / TileSize));
+	int minY = int(floorf(query.y / TileSize));
+	int maxX = int(ceilf((query.x + query.width) / TileSize)) - 1;
+	int maxY = int(ceilf((query.y + query.height) / TileSize)) - 1;
+
+	CellSet cells;
+	for (const auto& record : records)
+	{
+		if (record.Type != TileLayerType::Tile || record.CellX < 0)
+			continue;
+
+		for (int y = record.CellY; y < record.CellY + std::max(record.CellHeight, 1); y++)
+		{
+			for (int x = record.CellX; x < record.CellX + std::max(record.CellWidth, 1); x++)
+			{
+				if (x >= minX && x <= maxX && y >= minY && y <= maxY)
+					cells.insert({ x, y });
+			}
+		}
+	}
+	return cells;
+}
+
+// merged collision rectangles must report exactly the cells that the per cell queries do, before and after tiles are edited
+static void TestMergedCollisions()
+{
+	TileMap map;
+	CHECK(LoadTestMap(map), "the test map did not load");
+
+	TileLayer* walls = FindTileLayer(map, "Walls");
+	if (!walls)
+		return;
+
+	SetLayerCollisions(map, *walls, true);
+
+	std::mt19937 rng(7);
+	std::vector<Rectangle> queries;
+	for (int i = 0; i < 1000; i++)
+	{
+		float extent = float(MapSize * TileSize);
+		queries.push_back(Rectangle{ float(rng() % int(extent + 64)) - 32, float(rng() % int(extent + 64)) - 32, float(rng() % 160), float(rng() % 160) });
+	}
+
+	std::vector<CollisionRecord> records;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		std::vector<CellSet> perCell;
+		for (const auto& query : queries)
+		{
+			GetCollisions(map, query, records);
+			perCell.push_back(GetHitCells(records, query));
+		}
+
+		EnableMergedCollisions(map, *walls, 32);
+
+		int mismatches = 0;
+		for (size_t i = 0; i < queries.size(); i++)
+		{
+			GetCollisions(map, queries[i], records);
+			if (GetHitCells(records, queries[i]) != perCell[i])
+				mismatches++;
+		}
+		CHECK(mismatches == 0, "%d merged queries did not match the per cell queries (pass %d)", mismatches, pass);
+
+		// edit with the merged rectangles on so they are updated in place, then compare again without them
+		for (int i = 0; i < 400; i++)
+			SetLayerTile(map, *walls, rng() % MapSize, rng() % MapSize, (rng() % 2) ? 2 : 0);
+
+		std::vector<CellSet> merged;
+		for (const auto& query : queries)
+		{
+			GetCollisions(map, query, records);
+			merged.push_back(GetHitCells(records, query));
+		}
+
+		ReleaseMergedCollisions(*walls);
+
+		mismatches = 0;
+		for (size_t i = 0; i < queries.size(); i++)
+		{
+			GetCollisions(map, queries[i], records);
+			if (GetHitCells(records, queries[i]) != merged[i])
+				mismatches++;
+		}
+		CHECK(mismatches == 0, "%d merged queries did not match the per cell queries after edits (pass %d)", mismatches, pass);
+	}
+
+	UnloadTileMap(map, false);
+}
+
+static bool SameRect(Rectangle a, Rectangle b)
+{
+	return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+
+static void CompareMaps(TileMap& original, TileMap& cooked)
+{
+	CHECK(original.Layers.size() == cooked.Layers.size(), "the cooked map has %d layers, not %d", int(cooked.Layers.size()), int(original.Layers.size()));
+	CHECK(original.TileSheets.size() == cooked.TileSheets.size(), "the cooked map has %d sheets, not %d", int(cooked.TileSheets.size()), int(original.TileSheets.size()));
+	CHECK(original.Orientation == cooked.Orientation, "the cooked map has a different orientation");
+
+	for (size_t i = 0; i < std::min(original.Layers.size(), cooked.Layers.size()); i++)
+	{
+		LayerInfo& a = *original.Layers[i];
+		LayerInfo& b = *cooked.Layers[i];
+
+		CHECK(a.Name == b.Name && a.LayerId == b.LayerId && a.Type == b.Type, "cooked layer %d is not %s", int(i), a.Name.c_str());
+		if (a.Type != b.Type)
+			continue;
+
+		if (a.Type == TileLayerType::Tile)
+		{
+			auto& tilesA = static_cast<TileLayer&>(a);
+			auto& tilesB = static_cast<TileLayer&>(b);
+
+			CHECK(tilesA.Bounds.x == tilesB.Bounds.x && tilesA.Bounds.y == tilesB.Bounds.y, "cooked layer %s has a different size", a.Name.c_str());
+
+			int differences = 0;
+			for (int y = 0; y < int(tilesA.Bounds.y); y++)
+			{
+				for (int x = 0; x < int(tilesA.Bounds.x); x++)
+				{
+					const TileInfo* tileA = tilesA.GetTileInfo(x, y);
+					const TileInfo* tileB = tilesB.GetTileInfo(x, y);
+					if (!tileA || !tileB || tileA->TileIndex != tileB->TileIndex || tileA->TileFlags != tileB->TileFlags)
+						differences++;
+				}
+			}
+			CHECK(differences == 0, "%d cells of cooked layer %s are different", differences, a.Name.c_str());
+		}
+		else if (a.Type == TileLayerType::Object)
+		{
+			auto& objectsA = static_cast<ObjectLayer&>(a);
+			auto& objectsB = static_cast<ObjectLayer&>(b);
+
+			CHECK(objectsA.Objets.size() == objectsB.Objets.size(), "cooked layer %s has %d objects, not %d", a.Name.c_str(), int(objectsB.Objets.size()), int(objectsA.Objets.size()));
+
+			for (const auto& object : objectsA.Objets)
+			{
+				ObjectLayer::Object* other = objectsB.FindObject(object->Id);
+				CHECK(other != nullptr, "cooked layer %s is missing object %d", a.Name.c_str(), object->Id);
+				if (!other)
+					continue;
+
+				CHECK(other->Type == object->Type && other->Name == object->Name && other->ClassName == object->ClassName, "cooked object %d is not %s", object->Id, object->Name.c_str());
+				CHECK(SameRect(other->Bounds, object->Bounds) && other->Rotation == object->Rotation, "cooked object %d moved", object->Id);
+
+				if (object->Type == ObjectLayer::ObjectType::Polygon && other->Type == object->Type)
+				{
+					auto& pointsA = static_cast<ObjectLayer::PolygonObject&>(*object).Points;
+					auto& pointsB = static_cast<ObjectLayer::PolygonObject&>(*other).Points;
+
+					bool same = pointsA.size() == pointsB.size();
+					for (size_t p = 0; same && p < pointsA.size(); p++)
+						same = pointsA[p].x == pointsB[p].x && pointsA[p].y == pointsB[p].y;
+					CHECK(same, "cooked polygon %d has different points", object->Id);
+				}
+				else if (object->Type == ObjectLayer::ObjectType::Text && other->Type == object->Type)
+				{
+					CHECK(static_cast<ObjectLayer::TextObject&>(*object).Text == static_cast<ObjectLayer::TextObject&>(*other).Text, "cooked text %d has different text", object->Id);
+				}
+			}
+		}
+	}
+
+	CHECK(original.Properties.Properties.size() == cooked.Properties.Properties.size(), "the cooked map has %d properties, not %d",
+		int(cooked.Properties.Properties.size()), int(original.Properties.Properties.size()));
+
+	for (const auto& property : original.Properties.Properties)
+	{
+		const Property* other = FindProperty(cooked, property.Owner, property.Key);
+		CHECK(other != nullptr, "the cooked map is missing property %s", GetPropertyName(property.Key).c_str());
+		if (!other)
+			continue;
+
+		CHECK(other->Type == property.Type && other->IntValue == property.IntValue && other->FloatValue == property.FloatValue
+			&& std::string(original.Properties.GetText(property)) == cooked.Properties.GetText(*other), "cooked property %s has a different value", GetPropertyName(property.Key).c_str());
+	}
+}
+
+// a cooked map must load back the same as the map it was saved from, including one that was edited after loading
+static void TestCookedRoundTrip()
+{
+	TileMap map;
+	CHECK(LoadTestMap(map), "the test map did not load");
+
+	TileLayer* walls = FindTileLayer(map, "Walls");
+	if (walls)
+	{
+		SetLayerTile(map, *walls, 3, 4, 2, TileFlagsFlipDiagonal);
+		SetLayerTile(map, *walls, 5, 6, 0);
+	}
+
+	std::string path = (std::filesystem::temp_directory_path() / "raytiled_tests.rtm").string();
+	CHECK(SaveCookedTileMap(map, path), "unable to write %s", path.c_str());
+
+	TileMapLoadContext context;
+	context.DeferTextures = true;
+
+	TileMap cooked;
+	bool loaded = LoadTileMap(path, cooked, context);
+	CHECK(loaded, "unable to load %s", path.c_str());
+
+	if (loaded)
+	{
+		CompareMaps(map, cooked);
+
+		// saving the cooked map again must give the same map, the tile data now comes from the mapped file
+		std::string againPath = path + ".again";
+		CHECK(SaveCookedTileMap(cooked, againPath), "unable to write %s", againPath.c_str());
+
+		TileMap again;
+		CHECK(LoadTileMap(againPath, again, context), "unable to load %s", againPath.c_str());
+		CompareMaps(map, again);
+
+		UnloadTileMap(again, false);
+		std::filesystem::remove(againPath);
+	}
+
+	UnloadTileMap(cooked, false);
+	UnloadTileMap(map, false);
+	std::filesystem::remove(path);
+}
+
+static constexpr int EncodedLayerSize = 16;
+
+// the same layer saved by Tiled's encoders, zlib stored (level 0), fixed and dynamic huffman blocks, gzip and zstd, all base64.
+// the tiles are made by NextEncodedTile, so the csv layer is built here and every other layer must load the same
+static const char* Base64Layer =
+	"BAAAIAEAAAAAAAAAAgAAAAAAAAAAAAAABAAAAAAAAAAAAAAAAQAAgAIAAAAEAADgBAAAQAQAAEAAAAAAAwAAwAQAAGAAAAAABAAA"
+	"AAMAAEAEAAAAAAAAAAIAACABAAAABAAAYAEAAAAAAAAAAwAAAAQAAOABAABAAgAA4AAAAAAEAADAAwAAIAQAACAAAAAABAAAAAQA"
+	"ACACAAAAAwAAIAIAAIAEAABAAwAAgAAAAAAAAAAAAAAAAAIAAAACAABgAwAAgAMAAAACAAAAAgAAgAAAAAADAABgAAAAAAEAAEAD"
+	"AACgAQAAAAAAAAAEAAAgBAAAAAQAAAADAACABAAAAAAAAAAAAAAAAgAAQAIAAIACAABABAAAgAEAAEADAAAAAQAAIAQAAAADAAAA"
+	"AAAAAAMAAIACAAAAAgAAQAIAAAAAAAAAAAAAAAEAAAACAAAAAgAAAAIAAAAAAAAAAQAAAAEAAIACAAAABAAAAAEAAAABAAAgAwAA"
+	"AAMAAMAEAADAAgAAwAEAAGACAAAgAgAAgAMAAAAEAADgAwAAIAEAAIABAAAAAgAAAAMAAAABAAAAAAAAAAEAAIADAABAAwAAAAIA"
+	"AEACAACAAwAAAAMAAAADAAAAAgAAIAAAAAAEAACAAgAAwAQAAAACAAAABAAAAAMAAMACAAAAAQAAwAQAAAADAAAAAgAAAAMAAKAC"
+	"AACAAAAAAAMAAAAEAAAAAgAAAAQAAIAEAAAABAAAwAAAAAABAADAAwAAIAMAAAAEAAAABAAAAAEAAKAEAAAABAAAgAEAAAAEAACg"
+	"AAAAAAQAAEAAAAAAAQAAAAQAAAAEAABABAAAoAMAAAAEAADAAwAAgAQAAIADAAAABAAAgAEAAIACAAAABAAAgAAAAAAAAAAAAAAA"
+	"AAAAAAADAAAAAwAAgAAAAAADAAAAAQAAgAMAAAAAAAAABAAAQAMAAAADAACgAwAAQAQAAAADAAAgBAAAAAQAAAABAABgBAAAQAQA"
+	"AEAEAACgAAAAAAMAAAAAAAAAAwAAAAMAAAABAACgAgAAQAIAAAACAACAAAAAAAAAAAABAAAAAwAAQAEAACACAAAAAwAAAAQAAAAB"
+	"AADABAAAQAEAAAAEAACAAAAAAAQAAIAEAABAAAAAAAAAAAADAABABAAAAAIAAKAAAAAABAAAgAEAAIAAAAAAAAAAAAMAAIAEAAAg"
+	"AwAAgAQAACAEAAAAAgAAQAQAACAEAAAAAAAAAAAAAAADAACAAwAAAAQAAAACAACAAAAAAAEAAAAAAAAAAAAAAAEAAEABAABgAAAA"
+	"AAIAAAAEAAAAAQAAAAEAAAAAAAAABAAAIAQAAIACAAAgAgAAwAIAACADAAAgAgAAAA==";
+
+static const char* StoredZlibLayer =
+	"eAEBAAT/+wQAACABAAAAAAAAAAIAAAAAAAAAAAAAAAQAAAAAAAAAAAAAAAEAAIACAAAABAAA4AQAAEAEAABAAAAAAAMAAMAEAABg"
+	"AAAAAAQAAAADAABABAAAAAAAAAACAAAgAQAAAAQAAGABAAAAAAAAAAMAAAAEAADgAQAAQAIAAOAAAAAABAAAwAMAACAEAAAgAAAA"
+	"AAQAAAAEAAAgAgAAAAMAACACAACABAAAQAMAAIAAAAAAAAAAAAAAAAACAAAAAgAAYAMAAIADAAAAAgAAAAIAAIAAAAAAAwAAYAAA"
+	"AAABAABAAwAAoAEAAAAAAAAABAAAIAQAAAAEAAAAAwAAgAQAAAAAAAAAAAAAAAIAAEACAACAAgAAQAQAAIABAABAAwAAAAEAACAE"
+	"AAAAAwAAAAAAAAADAACAAgAAAAIAAEACAAAAAAAAAAAAAAABAAAAAgAAAAIAAAACAAAAAAAAAAEAAAABAACAAgAAAAQAAAABAAAA"
+	"AQAAIAMAAAADAADABAAAwAIAAMABAABgAgAAIAIAAIADAAAABAAA4AMAACABAACAAQAAAAIAAAADAAAAAQAAAAAAAAABAACAAwAA"
+	"QAMAAAACAABAAgAAgAMAAAADAAAAAwAAAAIAACAAAAAABAAAgAIAAMAEAAAAAgAAAAQAAAADAADAAgAAAAEAAMAEAAAAAwAAAAIA"
+	"AAADAACgAgAAgAAAAAADAAAABAAAAAIAAAAEAACABAAAAAQAAMAAAAAAAQAAwAMAACADAAAABAAAAAQAAAABAACgBAAAAAQAAIAB"
+	"AAAABAAAoAAAAAAEAABAAAAAAAEAAAAEAAAABAAAQAQAAKADAAAABAAAwAMAAIAEAACAAwAAAAQAAIABAACAAgAAAAQAAIAAAAAA"
+	"AAAAAAAAAAAAAAAAAwAAAAMAAIAAAAAAAwAAAAEAAIADAAAAAAAAAAQAAEADAAAAAwAAoAMAAEAEAAAAAwAAIAQAAAAEAAAAAQAA"
+	"YAQAAEAEAABABAAAoAAAAAADAAAAAAAAAAMAAAADAAAAAQAAoAIAAEACAAAAAgAAgAAAAAAAAAAAAQAAAAMAAEABAAAgAgAAAAMA"
+	"AAAEAAAAAQAAwAQAAEABAAAABAAAgAAAAAAEAACABAAAQAAAAAAAAAAAAwAAQAQAAAACAACgAAAAAAQAAIABAACAAAAAAAAAAAAD"
+	"AACABAAAIAMAAIAEAAAgBAAAAAIAAEAEAAAgBAAAAAAAAAAAAAAAAwAAgAMAAAAEAAAAAgAAgAAAAAABAAAAAAAAAAAAAAABAABA"
+	"AQAAYAAAAAACAAAABAAAAAEAAAABAAAAAAAAAAQAACAEAACAAgAAIAIAAMACAAAgAwAAIAIAAACuEDIv";
+
+static const char* FixedZlibLayer =
+	"eAFjYWBQYGSAACYGBGBBYgPlG5ggYg+A2AGEQeLMDAwHgOwEmHpmiBzMLLC5IHmY+cxQM4B8B6D8A6i+A0BxBSCtADMHxGaCqAfR"
+	"DSD7gOwGJCeB3QrECSBxZgS/AWpPAtTdIH0LGBF+UmBBuLWBBdU8kJtA/gT5oQGqF2SGAlQ9zA8NTAj1yGEEcwM8HBlRww7GV2BG"
+	"hN0BoNwBoFgCE9SvsDBihoRfA8xcqFvg8cEMdR/M3VAzGaBisLAE2Q2yh4EJ4W+QnSAzDrAg1IPoBUjhx4CkpwEaZgegdoPjixkR"
+	"VyCxBVB2AzTOF0Dtd4CFA1QeFLYLmBHxDjIb5ucGpLBCiWsGhN/g7oOGASxeHaDyC2BpkBkprkHhC0u3MLcxo5oL9gMsTpmQ7GeE"
+	"pmtGRJqEmQkKPwdGJPdCw8oByc0O0HCEhQfYj0jyIPUKMBqq1gHGRlaHFCcNDEhpAZbOGaFpHi2tIaf7BmgaA8W/AjRvMQAArhAy"
+	"Lw==";
+
+static const char* DynamicZlibLayer =
+	"eNpdU4GxxSAIQ+0gjuIoHYVRHMVR3ijf2KTQ3ztPBQwh0MusF3u+avFd6bz9Xh/bb6+BBXszW/t8K749PmEdXPiF34ix72P7f3y3"
+	"tr3vvQsH5/rEY3fk22dPlA7XvW7YW9ydeW7yxrtZoqZ+BVe/vnjghDpRg/MtMDrjVYPXiM8aicOrY/lqp3tvod3avrVtd2Wt0qg9"
+	"+rlwyeXtRyM/8Sam0SYtkRt5rEbdyAmMdUU89pn0s/TGqdli7tOvFr2CbfLs7Plk/iEd6Ie2s0Xfga2aPWn16bVFbS8/aqC+Dvqn"
+	"ZrClXkNfza24tS/uqUE9rSl/4VyXmElhQr9REl9qNRLnQR2lx6kx+RHftTN26JzjUk/c0ixozgtn/t+s5bl3zhj63/lv2R+uEDIv";
+
+static const char* GzipLayer =
+	"H4sIAAAAAAACA11TgbHFIAhD7SCO4igdhVEcxVHeKN/YpNDfO08FDCHQy6wXe75q8V3pvP1eH9tvr4EFezNb+3wrvj0+YR1c+IXf"
+	"iLHvY/t/fLe2ve+9Cwfn+sRjd+TbZ0+UDte9bthb3J15bvLGu1mipn4FV7++eOCEOlGD8y0wOuNVg9eIzxqJw6tj+Wqne2+h3dq+"
+	"tW13Za3SqD36uXDJ5e1HIz/xJqbRJi2RG3msRt3ICYx1RTz2mfSz9Map2WLu068WvYJt8uzs+WT+IR3oh7azRd+BrZo9afXptUVt"
+	"Lz9qoL4O+qdmsKVeQ1/Nrbi1L+6pQT2tKX/hXJeYSWFCv1ESX2o1EudBHaXHqTH5Ed+1M3bonONST9zSLGjOC2f+36zluXfOGPrf"
+	"+W/ZH+CktAwABAAA";
+
+static const char* ZstdLayer =
+	"KLUv/WQAAxUJAAbdJg/gaQ3QoUOHDp0woJNSyhQfACIAIwDgItuX6Z6yvf4Ttg+Y/nbX7cNGrr/ttrKdxNPSf8AWz3/6uoGn2G4S"
+	"05kwMOO658P1osQVplNx3SYmcJ3AdnuwBW/7sb0Ne82T7SaOupHnROhGJkGvuuu8Th/xgIvCQyZS4DwNwURE+vDcf1584B/Tf8X2"
+	"OTt33TS+LQRX3fbrRWGixnbzOqiRPCkwEAotmi3F2gFAhBApg3sQxpAAuxxfyWd438f2Ol06rmd9+b1j6yHNc3zi/uINKV3ajjVL"
+	"FqfO9B8D3+iuQ5Tj9QB9i3iXL9Ld3j/SY9xRttZmZ280NDci9+rp15vVzsvkqJPb91nFx/iHdVMn5sbnx5Kp+pJ3PdWIfOIUK1wa"
+	"2kGI2g==";
+
+static uint32_t NextEncodedTile(uint32_t& state)
+{
+	state = state * 1103515245u + 12345u;
+	uint32_t value = state >> 16;
+
+	uint32_t gid = (value % 5 == 0) ? 0 : 1 + (value >> 3) % 4;
+	if (gid != 0 && (value >> 5) % 3 == 0)
+		gid |= 0x80000000u;
+	if (gid != 0 && (value >> 7) % 4 == 0)
+		gid |= 0x40000000u;
+	if (gid != 0 && (value >> 9) % 5 == 0)
+		gid |= 0x20000000u;
+	return gid;
+}
+
+static std::string MakeEncodingMap(const char* gzipData)
+{
+	uint32_t state = 12345;
+	std::string csv;
+	for (int i = 0; i < EncodedLayerSize * EncodedLayerSize; i++)
+	{
+		if (i > 0)
+			csv += ",";
+		csv += std::to_string(NextEncodedTile(state));
+	}
+
+	struct EncodedLayer
+	{
+		const char* Name;
+		const char* Compression;
+		const char* Data;
+	};
+
+	const EncodedLayer layers[] =
+	{
+		{ "Base64", "", Base64Layer },
+		{ "StoredZlib", "zlib", StoredZlibLayer },
+		{ "FixedZlib", "zlib", FixedZlibLayer },
+		{ "DynamicZlib", "zlib", DynamicZlibLayer },
+		{ "Gzip", "gzip", gzipData },
+		{ "Zstd", "zstd", ZstdLayer },
+	};
+
+	std::string size = std::to_string(EncodedLayerSize);
+
+	std::string map =
+		"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<map version=\"1.10\" orientation=\"orthogonal\" renderorder=\"right-down\" width=\"" + size + "\" height=\"" + size + "\" tilewidth=\"16\" tileheight=\"16\" infinite=\"0\">\n"
+		" <tileset firstgid=\"1\" name=\"tiles\" tilewidth=\"16\" tileheight=\"16\" tilecount=\"4\" columns=\"2\">\n"
+		"  <image source=\"tiles.png\" width=\"32\" height=\"32\"/>\n"
+		" </tileset>\n"
+		" <layer id=\"1\" name=\"Csv\" width=\"" + size + "\" height=\"" + size + "\"><data encoding=\"csv\">" + csv + "</data></layer>\n";
+
+	int id = 2;
+	for (const auto& layer : layers)
+	{
+		map += " <layer id=\"" + std::to_string(id++) + "\" name=\"" + layer.Name + "\" width=\"" + size + "\" height=\"" + size + "\"><data encoding=\"base64\"";
+		if (layer.Compression[0] != 0)
+			map += std::string(" compression=\"") + layer.Compression + "\"";
+		map += ">" + std::string(layer.Data) + "</data></layer>\n";
+	}
+
+	return map + "</map>\n";
+}
+
+// every encoding and compression Tiled can save must decode to the same tiles as the csv layer, and damaged data must not load
+static void TestLayerEncodings()
+{
+	TileMapLoadContext context;
+	context.DeferTextures = true;
+
+	TileMap map;
+	bool loaded = LoadTileMapFromMemory(MakeEncodingMap(GzipLayer).c_str(), map, context);
+	CHECK(loaded, "the encoding test map did not load");
+
+	TileLayer* csv = FindTileLayer(map, "Csv");
+	if (loaded && csv)
+	{
+		CHECK(map.Layers.size() == 7, "the encoding test map has %d layers, not 7", int(map.Layers.size()));
+
+		for (auto& layer : map.Layers)
+		{
+			if (layer->Type != TileLayerType::Tile || layer.get() == csv)
+				continue;
+
+			auto& tiles = static_cast<TileLayer&>(*layer);
+
+			int differences = 0;
+			for (int y = 0; y < EncodedLayerSize; y++)
+			{
+				for (int x = 0; x < EncodedLayerSize; x++)
+				{
+					const TileInfo* expected = csv->GetTileInfo(x, y);
+					const TileInfo* tile = tiles.GetTileInfo(x, y);
+					if (!expected || !tile || tile->TileIndex != expected->TileIndex || tile->TileFlags != expected->TileFlags)
+						differences++;
+				}
+			}
+			CHECK(differences == 0, "%d cells of the %s layer do not match the csv layer", differences, layer->Name.c_str());
+		}
+	}
+
+	UnloadTileMap(map, false);
+
+	// the eighth character from the end only holds bits of the gzip crc, so changing it must fail the trailer check
+	std::string damaged = GzipLayer;
+	damaged[damaged.size() - 8] = damaged[damaged.size() - 8] == 'A' ? 'B' : 'A';
+
+	TileMap damagedMap;
+	CHECK(!LoadTileMapFromMemory(MakeEncodingMap(damaged.c_str()).c_str(), damagedMap, context), "a gzip layer with a damaged crc loaded");
+	UnloadTileMap(damagedMap, false);
+}
+
+static Vector2 GetCellCenter(const PathGrid& grid, int x, int y)
+{
+	return Vector2{ (x + 0.5f) * grid.CellSize.x, (y + 0.5f) * grid.CellSize.y };
+}
+
+static bool CanStep(const PathGrid& grid, int x, int y, int dx, int dy)
+{
+	if (grid.IsBlocked(x + dx, y + dy))
+		return false;
+
+	// diagonal moves may not cut the corner of a blocked cell
+	return dx == 0 || dy == 0 || (!grid.IsBlocked(x + dx, y) && !grid.IsBlocked(x, y + dy));
+}
+
+// the cells that can be walked to from a cell, with the same moves as FindPath
+static std::vector<int> FloodFill(const PathGrid& grid, int startX, int startY)
+{
+	std::vector<int> regions(size_t(grid.Width) * grid.Height, 0);
+	std::vector<std::pair<int, int>> open = { { startX, startY } };
+	regions[size_t(startY) * grid.Width + startX] = 1;
+
+	while (!open.empty())
+	{
+		auto [x, y] = open.back();
+		open.pop_back();
+
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dx = -1; dx <= 1; dx++)
+			{
+				if ((dx == 0 && dy == 0) || !CanStep(grid, x, y, dx, dy))
+					continue;
+
+				int& region = regions[size_t(y + dy) * grid.Width + x + dx];
+				if (region == 0)
+				{
+					region = 1;
+					open.push_back({ x + dx, y + dy });
+				}
+			}
+		}
+	}
+	return regions;
+}
+
+static void GetRandomOpenCell(const PathGrid& grid, std::mt19937& rng, int& x, int& y)
+{
+	do
+	{
+		x = rng() % grid.Width;
+		y = rng() % grid.Height;
+	} while (grid.IsBlocked(x, y));
+}
+
+// every path must go from the start cell to the goal cell through open cells one legal step at a time, and a path must be found whenever the goal can be reached
+static void CheckPaths(const PathGrid& grid, std::mt19937& rng, const char* stage)
+{
+	std::vector<Vector2> path;
+	int invalid = 0;
+	int missed = 0;
+	int unexpected = 0;
+
+	for (int i = 0; i < 200; i++)
+	{
+		int startX, startY, goalX, goalY;
+		GetRandomOpenCell(grid, rng, startX, startY);
+		GetRandomOpenCell(grid, rng, goalX, goalY);
+
+		bool reachable = FloodFill(grid, startX, startY)[size_t(goalY) * grid.Width + goalX] != 0;
+		bool found = FindPath(grid, GetCellCenter(grid, startX, startY), GetCellCenter(grid, goalX, goalY), path);
+
+		if (reachable && !found)
+			missed++;
+		if (!reachable && found)
+			unexpected++;
+		if (!found)
+			continue;
+
+		bool valid = !path.empty();
+		for (size_t p = 0; valid && p < path.size(); p++)
+		{
+			int x = int(floorf(path[p].x / grid.CellSize.x));
+			int y = int(floorf(path[p].y / grid.CellSize.y));
+
+			if (p == 0)
+			{
+				valid = x == startX && y == startY;
+				continue;
+			}
+
+			int lastX = int(floorf(path[p - 1].x / grid.CellSize.x));
+			int lastY = int(floorf(path[p - 1].y / grid.CellSize.y));
+			int dx = x - lastX;
+			int dy = y - lastY;
+
+			valid = abs(dx) <= 1 && abs(dy) <= 1 && (dx != 0 || dy != 0) && CanStep(grid, lastX, lastY, dx, dy);
+		}
+
+		if (valid)
+		{
+			Vector2 last = path.back();
+			valid = int(floorf(last.x / grid.CellSize.x)) == goalX && int(floorf(last.y / grid.CellSize.y)) == goalY;
+		}
+
+		if (!valid)
+			invalid++;
+	}
+
+	CHECK(invalid == 0, "%d paths were not valid %s", invalid, stage);
+	CHECK(missed == 0, "%d paths were not found to reachable goals %s", missed, stage);
+	CHECK(unexpected == 0, "%d paths were found to unreachable goals %s", unexpected, stage);
+}
+
+// an invalidated flow field must have the same costs as one built from scratch, and every direction must lead down the cheapest step
+static void CheckFlowField(const PathGrid& grid, const FlowField& field, const FlowField& fresh)
+{
+	static constexpr float DiagonalCost = 1.41421356f;
+
+	int costErrors = 0;
+	int directionErrors = 0;
+
+	for (int y = 0; y < field.Height; y++)
+	{
+		for (int x = 0; x < field.Width; x++)
+		{
+			size_t cell = size_t(y) * field.Width + x;
+			float cost = field.Integration[cell];
+			float freshCost = fresh.Integration[cell];
+
+			if (std::isinf(cost) != std::isinf(freshCost) || (!std::isinf(cost) && fabsf(cost - freshCost) > 0.01f))
+				costErrors++;
+
+			Vector2 direction = GetFlowDirection(field, GetCellCenter(grid, x, y));
+			int dx = (direction.x > 0.1f) ? 1 : ((direction.x < -0.1f) ? -1 : 0);
+			int dy = (direction.y > 0.1f) ? 1 : ((direction.y < -0.1f) ? -1 : 0);
+
+			bool moves = dx != 0 || dy != 0;
+			bool shouldMove = !std::isinf(cost) && cost > 0;
+
+			if (moves != shouldMove)
+			{
+				directionErrors++;
+				continue;
+			}
+
+			if (!moves)
+				continue;
+
+			float step = (dx != 0 && dy != 0) ? DiagonalCost : 1.0f;
+			if (!CanStep(grid, x, y, dx, dy) || fabsf(field.Integration[size_t(y + dy) * field.Width + x + dx] + step - cost) > 0.01f)
+				directionErrors++;
+		}
+	}
+
+	CHECK(costErrors == 0, "%d cells of the invalidated flow field have a different cost than a new field", costErrors);
+	CHECK(directionErrors == 0, "%d cells of the invalidated flow field point the wrong way", directionErrors);
+}
+
+// paths and flow fields must stay valid as walls are added and removed and the grid is updated in place
+static void TestPathsAndFlowFields()
+{
+	TileMap map;
+	CHECK(LoadTestMap(map), "the test map did not load");
+
+	TileLayer* walls = FindTileLayer(map, "Walls");
+	if (!walls)
+		return;
+
+	SetLayerCollisions(map, *walls, true);
+
+	PathGrid grid;
+	CHECK(BuildPathGrid(map, grid, 16), "the path grid was not built");
+	if (grid.Width != MapSize || grid.Height != MapSize)
+		return;
+
+	std::mt19937 rng(99);
+	CheckPaths(grid, rng, "on the loaded map");
+
+	int goalX, goalY;
+	GetRandomOpenCell(grid, rng, goalX, goalY);
+	Vector2 goals[2] = { GetCellCenter(grid, goalX, goalY), GetCellCenter(grid, MapSize - 1 - goalX, MapSize - 1 - goalY) };
+
+	FlowField field;
+	CHECK(BuildFlowField(grid, field, goals, 2, 16), "the flow field was not built");
+
+	for (int i = 0; i < 60; i++)
+	{
+		// a few single cells and a few blocks, never over the goals so the field keeps them
+		int width = (i % 4 == 0) ? 1 + rng() % 6 : 1;
+		int height = (i % 4 == 0) ? 1 + rng() % 6 : 1;
+		int x = rng() % (MapSize - width);
+		int y = rng() % (MapSize - height);
+		uint16_t tile = (rng() % 2) ? 2 : 0;
+
+		for (int cellY = y; cellY < y + height; cellY++)
+		{
+			for (int cellX = x; cellX < x + width; cellX++)
+			{
+				Vector2 center = GetCellCenter(grid, cellX, cellY);
+				bool isGoal = false;
+				for (const auto& goal : goals)
+					isGoal |= goal.x == center.x && goal.y == center.y;
+
+				if (!isGoal)
+					SetLayerTile(map, *walls, cellX, cellY, tile);
+			}
+		}
+
+		UpdatePathGrid(map, grid, x, y, width, height);
+		InvalidateFlowField(grid, field, x, y, width, height);
+
+		if (i % 10 == 9)
+		{
+			FlowField fresh;
+			BuildFlowField(grid, fresh, goals, 2, 16);
+			CheckFlowField(grid, field, fresh);
+			CheckPaths(grid, rng, "after edits");
+		}
+	}
+
+	// the grid updated in place must match one built from the edited map
+	PathGrid rebuilt;
+	BuildPathGrid(map, rebuilt, 16);
+	CHECK(rebuilt.Blocked == grid.Blocked, "the updated path grid does not match a new grid");
+
+	UnloadTileMap(map, false);
+}
+
+int main()
+{
+	SetTraceLogLevel(LOG_WARNING);
+
+	TestMergedCollisions();
+	TestCookedRoundTrip();
+	TestLayerEncodings();
+	TestPathsAndFlowFields();
+
+	if (Failures > 0)
+	{
+		printf("%d checks failed\n", Failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}